@@ -0,0 +1,30 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#define AFFINITY_MAX_CPUS 1024
+#define AFFINITY_MAX_NODES 64
+
+// How processor threads are placed on host CPUs. With AFFINITY_PIN each
+// processor is bound to one NUMA node, taken round-robin, and allocates from
+// it; each of its core threads gets its own CPU of that node.
+typedef enum {
+  AFFINITY_NONE,
+  AFFINITY_PIN,
+} affinity_policy;
+
+extern affinity_policy thread_affinity;
+
+// Binds the calling process to its processor's node. Must run before the
+// processor touches its state so that it is allocated node-local, and before
+// any thread is created so they all inherit the node's CPU set.
+int affinity_bind_processor(uint8_t proc_id);
+
+// Sets `attr` to start core thread `core_id` on its own CPU.
+int affinity_core_thread_attr(pthread_attr_t *attr, uint8_t core_id);
+
+void affinity_log_placement(void);
+
+#endif
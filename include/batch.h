@@ -0,0 +1,61 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "fault.h"
+#include "sys_config.h"
+
+#include "scheduler/sched_core.h"
+#include "scheduler/sched_policy.h"
+
+#include <stdint.h>
+
+#define BATCH_DEFAULT_METRICS_PATH "target/batch_metrics.csv"
+
+// How a run ended, in increasing severity. A run gets the most severe
+// status any processor reports.
+typedef enum {
+  BATCH_RUN_OK,
+  BATCH_RUN_MISS,
+  BATCH_RUN_ERROR,
+  BATCH_RUN_STOPPED,
+} batch_run_status;
+
+// One manifest line: an allocation file and the features and policy it runs
+// with.
+typedef struct {
+  char *path;
+  uint32_t features;
+  const sched_policy *policy;
+} batch_entry;
+
+typedef struct {
+  batch_entry *entries;
+  uint32_t count;
+} batch_manifest;
+
+typedef struct {
+  batch_run_status status;
+  uint32_t ticks;
+  core_stats stats;
+  fault_stats faults;
+} batch_proc_result;
+
+// Lives in the segment shared by the processors. Results alternate between
+// two slots so processor 0 can read one run's while the others fill in the
+// next one's.
+typedef struct {
+  batch_proc_result result[2][NUM_PROC];
+} batch_shared;
+
+// Reads the manifest and starts the metrics file with its header. Runs in
+// the parent, before the processors are forked.
+int batch_prepare(const char *manifest_path, const char *metrics_path,
+                  batch_manifest *manifest);
+
+// Runs every manifest entry on processor `proc_id`, reusing its threads,
+// sockets and log across runs, then exits the process. Processor 0 appends
+// one metrics line per run.
+void batch_run(uint8_t proc_id, const batch_manifest *manifest,
+               batch_shared *shared, const char *metrics_path);
+
+#endif
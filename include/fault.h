@@ -0,0 +1,157 @@
+#ifndef FAULT_H
+#define FAULT_H
+
+#include "ipc.h"
+#include "processor.h"
+#include "sys_config.h"
+#include "task_management.h"
+
+#include "lib/rng.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef NUM_FAULTS
+#define NUM_FAULTS 0
+#endif
+
+// Injected faults. A crash stops a core for `duration` ticks, for good when
+// it is 0, dropping every job it holds. A corruption spoils the result of the
+// next job the core completes, so no completion is sent for it. A drop
+// discards the packets a processor receives for `duration` ticks, and a
+// delay holds them back until the window ends. The first two are drawn per
+// core, the others per processor.
+typedef enum {
+  FAULT_CRASH,
+  FAULT_CORRUPT,
+  FAULT_DROP,
+  FAULT_DELAY,
+  FAULT_KIND_COUNT,
+} fault_kind;
+
+// Distribution of the ticks between two faults of a kind, with mean
+// `interval`: always `interval`, uniform in [1, 2 * interval], or
+// exponential.
+typedef enum {
+  FAULT_DIST_NONE,
+  FAULT_DIST_FIXED,
+  FAULT_DIST_UNIFORM,
+  FAULT_DIST_EXP,
+} fault_dist;
+
+typedef struct {
+  uint32_t dist;
+  uint32_t interval;
+  uint32_t duration;
+} fault_spec;
+
+// What the processor does with the packets it receives this tick.
+typedef enum {
+  FAULT_IPC_DELIVER,
+  FAULT_IPC_DROP,
+  FAULT_IPC_HOLD,
+} fault_ipc_action;
+
+typedef enum {
+  FAULT_CORE_UP,
+  FAULT_CORE_CRASHED,
+  FAULT_CORE_DOWN,
+} fault_core_status;
+
+// A core's fault schedule. Only the core's own thread touches it.
+typedef struct {
+  rng crash_rng;
+  rng corrupt_rng;
+  uint32_t next_crash;
+  uint32_t next_corrupt;
+  uint32_t up_at;
+  uint32_t down_since;
+  uint32_t next_change;
+  bool down;
+  bool corrupt_armed;
+  uint64_t crashes;
+  uint64_t corruptions;
+  uint64_t down_ticks;
+} fault_core;
+
+// Lost primaries are tracked until a completion of the same job arrives or
+// their deadline passes, plus FAULT_GRACE_TICKS for the completion to travel.
+#define FAULT_LEDGER_SIZE 1024
+#define FAULT_RECENT_COMPLETIONS 256
+#define FAULT_GRACE_TICKS 2
+
+// A replica save is a lost primary whose job still completed by its
+// deadline; an unmasked fault is one whose job did not.
+typedef struct {
+  uint64_t injected[FAULT_KIND_COUNT];
+  uint64_t down_ticks;
+  uint64_t lost_jobs;
+  uint64_t replica_saves;
+  uint64_t unmasked;
+  uint64_t packets_dropped;
+  uint64_t packets_delayed;
+} fault_stats;
+
+extern fault_spec fault_specs[FAULT_KIND_COUNT];
+
+extern fault_core fault_cores[NUM_CORES_PER_PROC];
+
+// Parses a comma-separated list of kind:dist:interval[:duration], e.g.
+// "crash:exp:50000:200,corrupt:fixed:5000".
+int faults_parse(const char *spec);
+
+// Seeds every schedule from sim_seed and clears the counters. Runs before
+// each simulation, once the allocation is loaded.
+void fault_init(void);
+
+void fault_cleanup(void);
+
+void fault_read_stats(fault_stats *out);
+
+fault_core_status fault_core_advance(uint8_t core_id);
+
+// Where the core stands at this tick. Cheap until its next fault is due.
+static inline fault_core_status fault_core_tick(uint8_t core_id) {
+  fault_core *fc = &fault_cores[core_id];
+  if (proc_state.system_time < fc->next_change) {
+    return fc->down ? FAULT_CORE_DOWN : FAULT_CORE_UP;
+  }
+  return fault_core_advance(core_id);
+}
+
+// Whether the job the core just completed has a corrupted result.
+static inline bool fault_corrupts_completion(uint8_t core_id) {
+  fault_core *fc = &fault_cores[core_id];
+  if (!fc->corrupt_armed) {
+    return false;
+  }
+  fc->corrupt_armed = false;
+  fc->corruptions++;
+  return true;
+}
+
+// A copy of the job released at `arrival` was lost to a fault. Lost
+// primaries go into the ledger.
+void fault_job_lost(const task_struct *task, uint32_t arrival,
+                    bool is_replica);
+
+// Timer thread: starts and ends the processor's IPC faults, and puts the
+// primaries of the processors NUM_FAULTS leaves out into the ledger as they
+// are released.
+void fault_timer_tick(void);
+
+fault_ipc_action fault_ipc_now(void);
+
+void fault_count_packet(fault_ipc_action action);
+
+// A completion of one of this processor's own jobs.
+void fault_job_completed(const completion_message *msg);
+
+// Timer thread: settles ledger entries against this tick's completions from
+// the other processors, and gives up on those past their grace period.
+void fault_observe_completions(void);
+
+// Earliest tick at which a fault starts or ends, for event mode.
+uint32_t fault_next_tick(void);
+
+#endif
@@ -3,16 +3,60 @@
 
 #include "sys_config.h"
 
+#include "lib/ring_buffer.h"
+
+#include <netinet/in.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define MESSAGE_QUEUE_SIZE 64
 
+#define IPC_MAX_PACKET_SIZE                                                    \
+  (sizeof(ipc_header) + sizeof(criticality_change_message) +                   \
+   MESSAGE_QUEUE_SIZE * sizeof(completion_message))
+#define IPC_SHM_INBOX_SIZE 256
+
+#define IPC_WIRE_VERSION 2
+// Sent packets kept for retransmission, and the receive window in which a
+// missing packet can still be requested. Both fit one NACK bitmap.
+#define IPC_HISTORY_SIZE 64
+#define IPC_NACK_RETRY_TICKS 4
+
+#define IPC_FLAG_RETRANSMIT 0x01
+
+// How packets reach the other processors: through per-processor inboxes in
+// the segment shared by all forked processors, or over loopback UDP
+// multicast. The batched UDP transport sends one packet per tick holding
+// both the completions and any criticality change, and drains the socket
+// with recvmmsg. A replay sends nothing and receives what was recorded.
+typedef enum {
+  IPC_TRANSPORT_SHM,
+  IPC_TRANSPORT_UDP,
+  IPC_TRANSPORT_UDP_BATCH,
+  IPC_TRANSPORT_REPLAY,
+} ipc_transport_kind;
+
 typedef enum {
   PACKET_TYPE_COMPLETION = 0x01,
   PACKET_TYPE_CRITICALITY_CHANGE = 0x02,
+  PACKET_TYPE_TICK = 0x03,
+  PACKET_TYPE_NACK = 0x04,
 } packet_type;
 
+// Starts every packet. Each processor numbers the packets it sends, NACKs
+// excepted, so receivers can tell which ones they missed. Packets left over
+// from an earlier run of a batch carry an older run number and are dropped.
+typedef struct {
+  uint8_t version;
+  uint8_t type;
+  uint8_t sender;
+  uint8_t flags;
+  uint32_t seq;
+  uint32_t tick;
+  uint32_t run;
+} ipc_header;
+
 typedef struct {
   uint32_t completed_task_id;
   uint32_t job_arrival_time;
@@ -23,10 +67,99 @@ typedef struct {
   criticality_level new_level;
 } criticality_change_message;
 
+// Asks `target` to resend packet base_seq - k for every bit k set in
+// `missing`.
+typedef struct {
+  uint64_t missing;
+  uint32_t base_seq;
+  uint8_t target;
+} nack_message;
+
+// What has been received from one sender. Bit k of `missing` is set while
+// packet next_seq - 1 - k is still outstanding.
+typedef struct {
+  uint32_t next_seq;
+  uint64_t missing;
+} ipc_seq_window;
+
+typedef enum {
+  IPC_SEQ_DUPLICATE,
+  IPC_SEQ_NEW,
+  IPC_SEQ_RECOVERED,
+} ipc_seq_result;
+
+typedef struct {
+  uint64_t packets_sent;
+  uint64_t packets_received;
+  uint64_t syscalls;
+  uint64_t lost;
+  uint64_t recovered;
+  uint64_t unrecovered;
+  uint64_t duplicates;
+  uint64_t nacks_sent;
+  uint64_t retransmitted;
+  uint64_t expired;
+} ipc_counters;
+
+typedef struct {
+  uint16_t len;
+  char data[IPC_MAX_PACKET_SIZE];
+} ipc_shm_slot;
+
+// Packets addressed to one processor. Every processor enqueues into it and
+// only its owner's timer thread dequeues.
+typedef struct {
+  ring_buffer ring;
+  _Atomic uint64_t seq[IPC_SHM_INBOX_SIZE];
+  ipc_shm_slot slots[IPC_SHM_INBOX_SIZE];
+  _Atomic uint64_t dropped;
+} ipc_shm_inbox;
+
+typedef struct {
+  ipc_shm_inbox inbox[NUM_PROC];
+} ipc_shm_segment;
+
+// Where every processor listens when each runs as its own process, possibly
+// on different hosts. Indexed by processor id.
+typedef struct {
+  struct sockaddr_in addr[NUM_PROC];
+} ipc_peer_list;
+
+extern ipc_transport_kind ipc_transport;
+extern ipc_shm_segment *ipc_shm;
+extern ipc_peer_list *ipc_peers;
+
+// Parses "host:port,host:port,..." with exactly NUM_PROC entries.
+int ipc_parse_peers(const char *spec, ipc_peer_list *out);
+
+// Records packet `seq` in the window. The packets skipped over are marked
+// missing and added to *lost; missing packets that fall out of the window
+// are added to *unrecovered. Sequence numbers compare modulo 2^32.
+ipc_seq_result ipc_window_accept(ipc_seq_window *w, uint32_t seq,
+                                 uint64_t *lost, uint64_t *unrecovered);
+
+// The NACK asking `target` for every packet missing from `w`.
+nack_message ipc_window_nack(const ipc_seq_window *w, uint8_t target);
+
+// Lists the packets `nack` asks for, newest first, and returns how many.
+uint32_t ipc_nack_seqs(const nack_message *nack,
+                       uint32_t seqs[IPC_HISTORY_SIZE]);
+
+// Must run before the processors are forked so the inbox rings point into
+// the same mapping in every process.
+void ipc_shm_segment_init(ipc_shm_segment *seg);
+
 void ipc_thread_init(void);
+
+// Starts run number `run` afresh: drops whatever is still queued or in
+// flight, and restarts packet numbering. Only called between runs, with the
+// processor's threads parked.
+void ipc_reset(uint32_t run);
+
 void ipc_broadcast_criticality_change(criticality_level new_level);
-void ipc_send_completion_messages(void);
-void ipc_receive_completion_messages(void);
+size_t ipc_send_completion_messages(void);
+size_t ipc_receive_completion_messages(void);
+void ipc_read_counters(ipc_counters *out);
 void ipc_cleanup(void);
 
 #endif
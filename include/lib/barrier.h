@@ -3,19 +3,33 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 
 #define BARRIER_SERIAL_THREAD 1
 
+// barrier_init flags. Without BARRIER_SPIN the barrier sleeps on a mutex and
+// condition variable. With it, the barrier is sense-reversing: the last thread
+// to arrive advances the generation word, which waiters spin on before falling
+// back to a futex wait once their adaptive spin budget runs out.
+#define BARRIER_PROCESS_SHARED 0x1
+#define BARRIER_SPIN 0x2
+
 typedef struct {
   uint64_t count;
   uint64_t target;
   uint64_t cycle;
   pthread_mutex_t mut;
   pthread_cond_t cond;
+
+  int flags;
+  _Atomic uint32_t arrived;
+  _Atomic uint32_t generation;
+  _Atomic uint32_t sleepers;
+  _Atomic uint32_t spin_limit;
 } barrier;
 
-int barrier_init(barrier *barrier, unsigned n, int pshared);
+int barrier_init(barrier *barrier, unsigned n, int flags);
 int barrier_destroy(barrier *barrier);
 int barrier_wait(barrier *barrier);
 
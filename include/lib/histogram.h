@@ -0,0 +1,43 @@
+#ifndef LIB_HISTOGRAM_H
+#define LIB_HISTOGRAM_H
+
+#include <stdint.h>
+
+// Log-linear histogram in the style of HdrHistogram: values below
+// 2 * HISTOGRAM_SUB_BUCKETS are counted exactly, larger ones in
+// HISTOGRAM_SUB_BUCKETS buckets per power of two, so a bucket's width is at
+// most 1/HISTOGRAM_SUB_BUCKETS of its values. Values beyond the last bucket
+// land in it. Recording is a few integer operations and never allocates;
+// a histogram has a single writer.
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS                                                      \
+  (2 * HISTOGRAM_SUB_BUCKETS +                                                 \
+   (HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+  uint64_t counts[HISTOGRAM_BUCKETS];
+  uint64_t total;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+} histogram;
+
+void histogram_init(histogram *h);
+
+void histogram_record(histogram *h, uint64_t value);
+
+// Adds every value recorded in `src` to `dst`.
+void histogram_merge(histogram *dst, const histogram *src);
+
+uint32_t histogram_bucket(uint64_t value);
+
+// Smallest value counted in `bucket`.
+uint64_t histogram_bucket_value(uint32_t bucket);
+
+// Value at or below which `percentile` percent of the values lie, to the
+// bucket's precision; the exact extremes at 0 and 100. 0 when empty.
+uint64_t histogram_percentile(const histogram *h, double percentile);
+
+#endif
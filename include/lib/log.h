@@ -1,17 +1,12 @@
 #ifndef LIB_LOG_H
 #define LIB_LOG_H
 
-#include "lib/platform_sem.h"
-#include "lib/ring_buffer.h"
-
 #include "processor.h"
 
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
-extern ring_buffer log_queue;
-
 typedef enum {
   LOG_LEVEL_DEBUG,
   LOG_LEVEL_INFO,
@@ -20,6 +15,19 @@ typedef enum {
   LOG_LEVEL_FATAL
 } log_level;
 
+// What a thread does when its log ring is full: drop the entry, briefly
+// wait for the logger to free space and then drop, wait until it does, or
+// move the entry to a heap-allocated overflow list.
+typedef enum {
+  LOG_OVERFLOW_DROP,
+  LOG_OVERFLOW_RETRY,
+  LOG_OVERFLOW_BLOCK,
+  LOG_OVERFLOW_SPILL,
+} log_overflow_policy;
+
+// Times a producer under LOG_OVERFLOW_RETRY re-checks a full ring.
+#define LOG_RETRY_LIMIT 64
+
 typedef struct {
   uint8_t proc_id;
   uint8_t core_id;
@@ -28,20 +36,120 @@ typedef struct {
 
 extern log_level current_log_level;
 
-extern platform_sem_t log_sem;
-
-extern _Atomic int log_wakeup_pending;
+extern log_overflow_policy log_overflow;
 
 extern __thread log_thread_context log_thread_ctx;
 
 void log_system_init(uint8_t proc_id);
 void log_system_shutdown(void);
 
+// Copies a formatted line into the calling thread's log ring.
+void log_text(log_level level, const char *msg, int len);
+
+// A trace record has room for LOG_TRACE_MAX_ARGS arguments. Both modes check
+// every call site against it, so a LOG that only fits in text mode does not
+// break trace builds. Calls with up to a dozen arguments are counted as one
+// too many.
+#define LOG_TRACE_MAX_ARGS 5
+
+// The LOG arguments, format string included, are counted as one list so that
+// calls without arguments need no empty __VA_ARGS__.
+#define LOG_TRACE_NARGS(...)                                                   \
+  LOG_TRACE_NARGS_(__VA_ARGS__, 6, 6, 6, 6, 6, 6, 6, 5, 4, 3, 2, 1, 0, ~)
+#define LOG_TRACE_NARGS_(fmt, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11,   \
+                         _12, n, ...)                                          \
+  n
+
+#define LOG_CHECK_NARGS(...)                                                   \
+  _Static_assert(LOG_TRACE_NARGS(__VA_ARGS__) <= LOG_TRACE_MAX_ARGS,           \
+                 "LOG takes at most 5 arguments in trace mode")
+
+#ifdef ENABLE_BINARY_TRACE
+
+// Binary trace mode: LOG writes a fixed-size record holding the call site,
+// tick, thread context and raw arguments into the per-thread log ring, and
+// the logger thread formats it. String arguments are copied into continuation
+// records that follow the header record.
+
+typedef struct {
+  const char *file;
+  const char *fmt;
+  int line;
+} log_site;
+
+typedef struct {
+  union {
+    uint64_t u;
+    double d;
+    const char *s;
+  };
+  bool is_str;
+} log_trace_arg;
+
+static inline log_trace_arg log_trace_arg_u(uint64_t v) {
+  return (log_trace_arg){.u = v, .is_str = false};
+}
+
+static inline log_trace_arg log_trace_arg_d(double v) {
+  return (log_trace_arg){.d = v, .is_str = false};
+}
+
+static inline log_trace_arg log_trace_arg_s(const char *v) {
+  return (log_trace_arg){.s = v, .is_str = true};
+}
+
+#define LOG_TRACE_ARG(x)                                                       \
+  _Generic((x),                                                                \
+      float: log_trace_arg_d,                                                  \
+      double: log_trace_arg_d,                                                 \
+      char *: log_trace_arg_s,                                                 \
+      const char *: log_trace_arg_s,                                           \
+      default: log_trace_arg_u)(x)
+
+#define LOG_TRACE_FMT(...) LOG_TRACE_FMT_(__VA_ARGS__, ~)
+#define LOG_TRACE_FMT_(fmt, ...) fmt
+
+#define LOG_TRACE_CAT(a, b) LOG_TRACE_CAT_(a, b)
+#define LOG_TRACE_CAT_(a, b) a##b
+
+#define LOG_TRACE_PACK(...)                                                    \
+  LOG_TRACE_CAT(LOG_TRACE_PACK_, LOG_TRACE_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_TRACE_PACK_0(f)
+#define LOG_TRACE_PACK_1(f, a) , LOG_TRACE_ARG(a)
+#define LOG_TRACE_PACK_2(f, a, b) LOG_TRACE_PACK_1(f, a), LOG_TRACE_ARG(b)
+#define LOG_TRACE_PACK_3(f, a, b, c)                                           \
+  LOG_TRACE_PACK_2(f, a, b), LOG_TRACE_ARG(c)
+#define LOG_TRACE_PACK_4(f, a, b, c, d)                                        \
+  LOG_TRACE_PACK_3(f, a, b, c), LOG_TRACE_ARG(d)
+#define LOG_TRACE_PACK_5(f, a, b, c, d, e)                                     \
+  LOG_TRACE_PACK_4(f, a, b, c, d), LOG_TRACE_ARG(e)
+#define LOG_TRACE_PACK_6(f, ...)
+
+void log_trace(log_level level, const log_site *site,
+               const log_trace_arg *args, uint8_t nargs);
+
+#define LOG(level, ...)                                                        \
+  do {                                                                         \
+    LOG_CHECK_NARGS(__VA_ARGS__);                                              \
+    if (level >= current_log_level) {                                          \
+      static const log_site __log_site = {__FILE__,                            \
+                                          LOG_TRACE_FMT(__VA_ARGS__),          \
+                                          __LINE__};                           \
+      const log_trace_arg __log_args[] = {{.u = 0}                             \
+                                          LOG_TRACE_PACK(__VA_ARGS__)};        \
+      log_trace(level, &__log_site, __log_args + 1,                            \
+                LOG_TRACE_NARGS(__VA_ARGS__));                                 \
+    }                                                                          \
+  } while (0)
+
+#else
+
 #define FILENAME                                                               \
   (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
 
 #define LOG(level, fmt, ...)                                                   \
   do {                                                                         \
+    LOG_CHECK_NARGS(fmt, ##__VA_ARGS__);                                       \
     if (level >= current_log_level) {                                          \
       char msg_buf[MAX_LOG_MSG_SIZE];                                          \
       const char *level_str;                                                   \
@@ -65,23 +173,23 @@ void log_system_shutdown(void);
         level_str = "UNKNOWN";                                                 \
         break;                                                                 \
       }                                                                        \
+      int msg_len;                                                             \
       if (log_thread_ctx.is_set) {                                             \
-        snprintf(msg_buf, sizeof(msg_buf),                                     \
-                 "[%u] [P%u: C%u] [%s] [%s:%d] " fmt "\n",                     \
-                 proc_state.system_time, log_thread_ctx.proc_id,               \
-                 log_thread_ctx.core_id, level_str, FILENAME, __LINE__,        \
-                 ##__VA_ARGS__);                                               \
+        msg_len = snprintf(msg_buf, sizeof(msg_buf),                           \
+                           "[%u] [P%u: C%u] [%s] [%s:%d] " fmt "\n",           \
+                           proc_state.system_time, log_thread_ctx.proc_id,     \
+                           log_thread_ctx.core_id, level_str, FILENAME,        \
+                           __LINE__, ##__VA_ARGS__);                           \
       } else {                                                                 \
-        snprintf(msg_buf, sizeof(msg_buf),                                     \
-                 "[%u] [SYS] [%s] [%s:%d] " fmt "\n", proc_state.system_time,  \
-                 level_str, FILENAME, __LINE__, ##__VA_ARGS__);                \
-      }                                                                        \
-      if (ring_buffer_try_enqueue(&log_queue, msg_buf) == 0) {                 \
-        if (atomic_exchange(&log_wakeup_pending, 1) == 0) {                    \
-          platform_sem_post(&log_sem);                                         \
-        }                                                                      \
+        msg_len = snprintf(msg_buf, sizeof(msg_buf),                           \
+                           "[%u] [SYS] [%s] [%s:%d] " fmt "\n",                \
+                           proc_state.system_time, level_str, FILENAME,        \
+                           __LINE__, ##__VA_ARGS__);                           \
       }                                                                        \
+      log_text(level, msg_buf, msg_len);                                       \
     }                                                                          \
   } while (0)
 
 #endif
+
+#endif
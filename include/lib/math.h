@@ -34,8 +34,4 @@ static int cmp_uint32(const void *a, const void *b) {
   return (x > y) - (x < y);
 }
 
-static inline float rand_between(float min, float max) {
-  return min + (float)rand() / (float)RAND_MAX * (max - min);
-}
-
 #endif
@@ -9,13 +9,16 @@
 
 #define CACHE_LINE_SIZE_BYTES 64
 
+// The fields set by ring_buffer_init, which every access reads, sit apart
+// from head and tail, so polling an empty ring does not touch the line
+// producers write.
 typedef struct {
-  _Atomic uint64_t head __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
-  _Atomic uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
   _Atomic uint64_t *seq;
   uint64_t buf_size;
   uint64_t buf_elem_size;
   void *buffer;
+  _Atomic uint64_t head __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+  _Atomic uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
 } ring_buffer;
 
 static inline int ring_buffer_init(ring_buffer *rb, uint64_t size, void *buffer,
@@ -0,0 +1,59 @@
+#ifndef LIB_RNG_H
+#define LIB_RNG_H
+
+#include <stdint.h>
+
+// xoshiro256** generator, seeded through splitmix64. Its state lives with the
+// caller, so threads never share one.
+typedef struct {
+  uint64_t s[4];
+} rng;
+
+static inline uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Folds `value` into the hash `h`, for deriving a seed from several keys.
+static inline uint64_t rng_mix(uint64_t h, uint64_t value) {
+  uint64_t state = h ^ value;
+  return splitmix64(&state);
+}
+
+static inline void rng_init(rng *r, uint64_t seed) {
+  for (int i = 0; i < 4; i++) {
+    r->s[i] = splitmix64(&seed);
+  }
+}
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next(rng *r) {
+  uint64_t *s = r->s;
+  uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rng_rotl(s[3], 45);
+
+  return result;
+}
+
+// Uniform in [0, 1), from the top 24 bits.
+static inline float rng_float(rng *r) {
+  return (float)(rng_next(r) >> 40) * (1.0f / 16777216.0f);
+}
+
+static inline float rng_between(rng *r, float min, float max) {
+  return min + rng_float(r) * (max - min);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef LIB_SEQLOCK_H
+#define LIB_SEQLOCK_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sequence lock for data with a single writer and readers that must never
+// block it. The writer makes the sequence odd while it updates the data;
+// a reader retries when the sequence was odd or changed across its read. The
+// protected fields are themselves atomics, stored with memory_order_release
+// and loaded with memory_order_acquire: a read that races an update is then
+// retried rather than undefined, without the fences sanitizers cannot see.
+typedef struct {
+  _Atomic uint32_t seq;
+} seqlock;
+
+static inline void seqlock_init(seqlock *sl) { atomic_init(&sl->seq, 0); }
+
+static inline void seqlock_write_begin(seqlock *sl) {
+  uint32_t seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+  atomic_store_explicit(&sl->seq, seq + 1, memory_order_relaxed);
+}
+
+static inline void seqlock_write_end(seqlock *sl) {
+  uint32_t seq = atomic_load_explicit(&sl->seq, memory_order_relaxed);
+  atomic_store_explicit(&sl->seq, seq + 1, memory_order_release);
+}
+
+static inline uint32_t seqlock_read_begin(const seqlock *sl) {
+  uint32_t seq;
+  while ((seq = atomic_load_explicit(&sl->seq, memory_order_acquire)) & 1)
+    ;
+  return seq;
+}
+
+// True when the data read since seqlock_read_begin returned `start` may be
+// torn and has to be read again.
+static inline bool seqlock_read_retry(const seqlock *sl, uint32_t start) {
+  return atomic_load_explicit(&sl->seq, memory_order_relaxed) != start;
+}
+
+#endif
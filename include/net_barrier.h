@@ -0,0 +1,18 @@
+#ifndef NET_BARRIER_H
+#define NET_BARRIER_H
+
+#include "ipc.h"
+
+#include <stdint.h>
+
+#define NET_BARRIER_CONNECT_TIMEOUT_MS 30000
+
+// Tick barrier for distributed runs, replacing proc_barrier. Processor 0
+// coordinates: the others connect to it over TCP at its peer address and,
+// each round, send a proposed next tick and wait to be released with the
+// minimum of all proposals.
+int net_barrier_init(uint8_t proc_id, const ipc_peer_list *peers);
+int net_barrier_wait(uint32_t proposal, uint32_t *agreed);
+void net_barrier_destroy(void);
+
+#endif
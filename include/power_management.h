@@ -30,6 +30,8 @@ extern const dvfs_level dvfs_levels[NUM_DVFS_LEVELS];
 
 void power_management_init(void);
 float power_get_current_scaling_factor(uint8_t core_id);
+// Dynamic power (V^2 * f) at the core's DVFS level, relative to the top level.
+float power_get_relative_power(uint8_t core_id);
 uint8_t calc_required_dvfs_level(uint8_t core_id);
 void power_set_dvfs_level(uint8_t core_id, uint8_t level_idx);
 uint8_t power_get_current_dvfs_level(uint8_t core_id);
@@ -9,6 +9,7 @@
 
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -18,6 +19,15 @@
 
 extern _Atomic int core_fatal_shutdown_requested;
 
+typedef enum { SIM_MODE_TICK, SIM_MODE_EVENT } sim_mode;
+
+// Tick each processor can advance to in event-driven mode. Slots alternate
+// between iterations so a processor never overwrites a proposal another one
+// has yet to read.
+typedef struct {
+  _Atomic uint32_t next_tick[2][NUM_PROC];
+} event_sync_state;
+
 typedef struct {
   _Atomic criticality_level system_criticality_level;
   _Atomic uint32_t system_time;
@@ -34,13 +44,37 @@ typedef struct {
 } processor_state;
 
 extern barrier *proc_barrier;
+extern event_sync_state *proc_event_sync;
+
+// Shared by forked processors: the iteration in which one of them hit a
+// fatal error, UINT32_MAX while none has. All of them stop one iteration
+// later, so none is left waiting at proc_barrier.
+extern _Atomic uint32_t *proc_abort_iteration;
+
+extern sim_mode simulation_mode;
+
+// Seed for the job execution times. A job's ACET depends only on the seed,
+// its processor, core, task and arrival, so a seed replays a run's ACETs.
+extern uint64_t sim_seed;
 
 extern processor_state proc_state;
 
 void processor_init(uint8_t proc_id);
 
+// Runs one simulation, then cleans up and exits the process.
 void processor_run(void);
 
+// For running several simulations in one process: the timer and core threads
+// are started once and each processor_simulate runs them through one
+// simulation, from the state set up by processor_reset.
+int processor_start(void);
+int processor_reset(uint32_t run);
+void processor_simulate(void);
+void processor_stop(void);
+
+// Set once the processor has been asked to stop, e.g. by SIGUSR1.
+bool processor_stop_requested(void);
+
 void processor_cleanup(void);
 
 #endif
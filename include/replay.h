@@ -0,0 +1,101 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "fault.h"
+#include "ipc.h"
+#include "sys_config.h"
+#include "task_management.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Record and replay of the inputs that make a run differ from the next one:
+// every generated ACET, every mode change a core picks up from the other
+// cores, every packet delivery, and the ticks skipped in event mode. A
+// recording holds one file per processor; replaying it feeds these back in
+// place of the generator and the live IPC, so each processor reruns on its
+// own with no barrier or transport between processors.
+typedef enum { REPLAY_OFF, REPLAY_RECORD, REPLAY_PLAY } replay_kind;
+
+#define REPLAY_MAGIC "EEFTRPL"
+#define REPLAY_VERSION 2
+
+// Records are appended per thread and written out in chunks, so records of
+// one thread stay in order in the file.
+#define REPLAY_CHUNK_RECORDS 4096
+#define REPLAY_TIMER_THREAD NUM_CORES_PER_PROC
+
+typedef enum {
+  REPLAY_RECORD_ACET = 1,
+  REPLAY_RECORD_MODE_OBSERVED,
+  REPLAY_RECORD_MODE_TRIGGERED,
+  REPLAY_RECORD_COMPLETION,
+  REPLAY_RECORD_CRITICALITY,
+  REPLAY_RECORD_SKIP,
+  REPLAY_RECORD_END,
+} replay_record_type;
+
+// ACET: tick is the arrival, a the task and b the ACET's bits. Completion:
+// a is the task, b the job's arrival and lag how many ticks after completing
+// the job it arrived, up to 255. Skip: a is the tick skipped to.
+typedef struct {
+  uint8_t type;
+  uint8_t thread;
+  uint8_t level;
+  uint8_t lag;
+  uint32_t tick;
+  uint32_t a;
+  uint32_t b;
+} replay_record;
+
+// The run settings that change what gets recorded, restored on replay.
+typedef struct {
+  char magic[8];
+  uint16_t version;
+  uint8_t proc_id;
+  uint8_t sim_mode;
+  uint32_t features;
+  uint64_t seed;
+  char policy[16];
+  fault_spec faults[FAULT_KIND_COUNT];
+} replay_header;
+
+extern replay_kind replay_mode;
+
+// Directory holding replay_p<id>.bin for every processor.
+extern const char *replay_dir;
+
+// Creates the processor's recording, or loads it and restores the run
+// settings it was recorded with.
+int replay_open(uint8_t proc_id);
+
+// Ends the recording at the current tick. On replay, reports a divergence
+// from the recording, if any.
+void replay_close(void);
+
+void replay_record_acet(uint8_t core_id, const job_struct *job, float acet);
+void replay_record_mode_change(uint8_t core_id, criticality_level level,
+                               bool triggered);
+void replay_record_completion(const completion_message *msg);
+void replay_record_criticality(criticality_level level);
+void replay_record_skip(uint32_t from, uint32_t to);
+
+// The recorded ACET of `job`. False once the core's replay has diverged.
+bool replay_acet(uint8_t core_id, const job_struct *job, float *acet);
+
+// The mode change the core picked up from the other cores at this tick.
+bool replay_mode_change(uint8_t core_id, criticality_level *level);
+
+// Checks a mode change the core's own job triggered against the recording.
+void replay_check_trigger(uint8_t core_id, criticality_level level);
+
+// The next delivery recorded at `tick`, as either a completion or a raised
+// criticality level.
+bool replay_delivery(uint32_t tick, replay_record *rec);
+
+// The tick the recording skipped to from `now`, `now` if it did not skip.
+uint32_t replay_skip_target(uint32_t now);
+
+bool replay_finished(uint32_t now);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef SCHEDULER_SCHED_CALENDAR_H
+#define SCHEDULER_SCHED_CALENDAR_H
+
+#include "sys_config.h"
+#include "task_management.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RELEASE_CALENDAR_NONE UINT32_MAX
+
+// Per-core calendar of upcoming arrivals: one entry per task in the core's
+// task index keyed by its next release tick, plus the pending jobs queue.
+// Only the owning core thread touches it.
+int release_calendar_init(uint8_t core_id);
+
+// Returns the task index of the next release due at `now`, or
+// RELEASE_CALENDAR_NONE once all of them have been taken. Releases missed
+// while the core was not ticking are dropped.
+uint32_t release_calendar_pop_due(uint8_t core_id, uint32_t now);
+
+// Moves the release of `task_id` at `tick` one period later, once its
+// arrival has been delegated to another core.
+bool release_calendar_skip(uint8_t core_id, uint32_t task_id, uint32_t tick);
+
+uint32_t release_calendar_next(uint8_t core_id, criticality_level min_crit);
+
+#endif
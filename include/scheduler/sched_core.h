@@ -2,50 +2,121 @@
 #define SCHEDULER_SCHED_CORE_H
 
 #include "lib/list.h"
+#include "lib/ring_buffer.h"
+#include "lib/seqlock.h"
 #include "power_management.h"
 #include "scheduler/sched_migration.h"
+#include "scheduler/sched_policy.h"
 #include "task_management.h"
 #include <stdbool.h>
 #include <stdint.h>
 
+// Tasks allocated to a core, laid out column-wise so the per-tick scans only
+// touch the fields they need. The columns share one allocation sized by the
+// core's share of the loaded allocation.
+typedef struct {
+  const task_struct **task;
+  uint32_t *period;
+  uint32_t *tuned_deadlines[MAX_CRITICALITY_LEVELS];
+  bool *is_replica;
+  uint32_t count;
+} core_task_index;
+
+// What happened on a core during the current run. Only the core's own thread
+// updates it, apart from the low power ticks event mode skips. Energy counts
+// busy ticks weighted by the dynamic power of the core's DVFS level, so a tick
+// at the top level is 1.
+typedef struct {
+  uint64_t jobs_released;
+  uint64_t jobs_completed;
+  uint64_t deadline_misses;
+  uint64_t mode_changes;
+  uint64_t preemptions;
+  uint64_t migrations;
+  uint64_t idle_ticks;
+  uint64_t low_power_ticks;
+  uint64_t replica_ticks;
+  double energy;
+  double replica_energy;
+} core_stats;
+
+// The optional steps of a tick, picked once by scheduler_init from
+// sim_features. Disabled features get stubs, so the tick itself never tests
+// the feature mask.
+typedef struct {
+  void (*remove_completed)(uint8_t core_id);
+  void (*migrate)(uint8_t core_id);
+  bool (*procrastinate)(uint8_t core_id);
+  void (*scale_frequency)(uint8_t core_id);
+  void (*enter_low_power)(uint8_t core_id);
+} tick_hooks;
+
+// Laid out by who touches what, so that cores migrating jobs to and from each
+// other do not keep stealing each other's cache lines: first what only the
+// core's own thread reads and writes, then the run queues that other cores
+// take rq_lock to change, then the rings other cores fill, each starting on a
+// cache line of its own.
 typedef struct {
-  struct list_head ready_queue;
-  struct list_head replica_queue;
-  struct list_head discard_list;
-  struct list_head pending_jobs_queue;
-
-  struct list_head delegated_job_queue;
-
-  migration_request migration_buf[MAX_MIGRATION_REQUESTS];
-  _Atomic uint64_t migration_seq[MAX_MIGRATION_REQUESTS];
-  ring_buffer migration_request_queue;
-
-  delegation_ack delegation_ack_buf[MAX_FUTURE_DELEGATIONS];
-  _Atomic uint64_t delegation_ack_seq[MAX_FUTURE_DELEGATIONS];
-  ring_buffer delegation_ack_queue;
-
-  pthread_mutex_t rq_lock;
-
   job_struct *running_job;
+  const sched_policy *policy;
+  tick_hooks hooks;
+
+  dpm_control_block dpm_control_block;
 
   uint32_t next_migration_eligible_tick;
 
   uint32_t cached_slack_horizon;
 
-  dpm_control_block dpm_control_block;
-
   bool is_idle;
 
   uint8_t current_dvfs_level;
 
+  uint8_t local_criticality_level;
+
+  bool decision_point;
+
   uint8_t proc_id;
   uint8_t core_id;
 
-  uint8_t local_criticality_level;
+  core_stats stats;
 
-  bool decision_point;
+  core_task_index task_index;
+
+  struct list_head pending_jobs_queue;
+
+  struct list_head delegated_job_queue;
 
-} core_state;
+  pthread_mutex_t rq_lock __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+
+  job_queue ready_queue;
+  job_queue replica_queue;
+  job_queue discard_list;
+
+  // Jobs in the ready and replica queues, for completion lookups.
+  job_index queued_jobs;
+
+  ring_buffer migration_request_queue;
+  migration_request migration_buf[MAX_MIGRATION_REQUESTS]
+      __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+  _Atomic uint64_t migration_seq[MAX_MIGRATION_REQUESTS];
+
+  ring_buffer delegation_ack_queue;
+  delegation_ack delegation_ack_buf[MAX_FUTURE_DELEGATIONS]
+      __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+  _Atomic uint64_t delegation_ack_seq[MAX_FUTURE_DELEGATIONS];
+} __attribute__((aligned(CACHE_LINE_SIZE_BYTES))) core_state;
+
+// What a core publishes at the end of its tick for the others' migration
+// decisions, on a cache line of its own. Only the core itself writes it, and
+// readers copy it through the seqlock without ever blocking the core.
+typedef struct {
+  seqlock seq;
+  _Atomic float util;
+  _Atomic float slack;
+  _Atomic uint32_t next_arrival;
+  _Atomic bool is_idle;
+  _Atomic uint8_t dvfs_level;
+} __attribute__((aligned(CACHE_LINE_SIZE_BYTES))) core_summary;
 
 typedef struct {
   float util;
@@ -53,18 +124,29 @@ typedef struct {
   uint32_t next_arrival;
   bool is_idle;
   uint8_t dvfs_level;
-} core_summary;
+} core_summary_snapshot;
 
-void scheduler_init(void);
+int scheduler_init(void);
+
+// Releases what scheduler_init set up, leaving every core as before it ran.
+void scheduler_cleanup(void);
+
+// Sums the stats of every core of this processor.
+void scheduler_read_stats(core_stats *total);
+
+// Accounts for ticks event mode skipped while every core was in low power.
+// Called by the timer thread while the cores wait for the next tick.
+void scheduler_skip_ticks(uint32_t ticks);
 
 void scheduler_tick(uint8_t core_id);
 
+// Copies every core's summary, each one as its core last published it.
+void core_summaries_snapshot(core_summary_snapshot snap[NUM_CORES_PER_PROC]);
+
 extern core_state core_states[NUM_CORES_PER_PROC];
 
 extern core_summary core_summaries[NUM_CORES_PER_PROC];
 
-extern pthread_mutex_t core_summary_locks[NUM_CORES_PER_PROC];
-
 #define LOCK_RQ(core_id) pthread_mutex_lock(&core_states[core_id].rq_lock)
 
 #define UNLOCK_RQ(core_id) pthread_mutex_unlock(&core_states[core_id].rq_lock)
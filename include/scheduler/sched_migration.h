@@ -44,5 +44,7 @@ void update_delegations(uint8_t core_id);
 
 void attempt_migration_push(uint8_t core_id);
 void process_migration_requests(uint8_t core_id);
+// Turns down every request queued for a core that cannot take jobs.
+void reject_migration_requests(uint8_t core_id);
 
 #endif
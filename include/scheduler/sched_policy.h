@@ -0,0 +1,61 @@
+#ifndef SCHEDULER_SCHED_POLICY_H
+#define SCHEDULER_SCHED_POLICY_H
+
+#include "sim_features.h"
+#include "sys_config.h"
+#include "task_management.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// How a core orders and picks its jobs. scheduler_init gives every core the
+// policy in scheduler_policy, and the core's ready and replica queues order
+// jobs by its job_key.
+typedef struct {
+  const char *name;
+
+  // Deadline a job at `level` is ordered by. The slack and admission
+  // analysis keep to the tuned deadlines whatever the policy.
+  uint32_t (*virtual_deadline)(const job_struct *job, criticality_level level);
+
+  // Queue order, lowest first. Computed when a job is queued.
+  job_key_fn job_key;
+
+  // Which of the two queue heads runs next; either may be NULL, not both.
+  job_struct *(*select)(job_struct *ready, job_struct *replica);
+
+  // Whether `candidate` takes the core from `running`.
+  bool (*preempts)(const job_struct *candidate, const job_struct *running);
+
+  // Whether a queued job stays queued after a mode change to `level`. Jobs
+  // that do not are moved to the discard list.
+  bool (*keeps_after_mode_change)(const job_struct *job,
+                                  criticality_level level);
+
+  // Features whose analysis does not hold under the policy, which
+  // scheduler_init refuses to run with.
+  uint32_t unsupported_features;
+} sched_policy;
+
+// EDF with the allocator's tuned virtual deadlines.
+extern const sched_policy sched_policy_edf_vd;
+
+// Adaptive mixed-criticality fixed priority, deadline monotonic. DVFS,
+// procrastination and migration size their decisions with EDF demand-bound
+// slack, which says nothing about fixed priority, so it runs without them.
+extern const sched_policy sched_policy_fp_amc;
+
+// EDF-VD, least laxity first among equal virtual deadlines.
+extern const sched_policy sched_policy_edf_llf;
+
+// Policy the next scheduler_init uses, EDF-VD unless -s says otherwise.
+extern const sched_policy *scheduler_policy;
+
+// Looks a policy up by name: "edf-vd", "fp-amc" or "edf-llf".
+const sched_policy *sched_policy_find(const char *name);
+
+// The features of `features` that `policy` cannot run with, 0 if none.
+uint32_t sched_policy_unsupported(const sched_policy *policy,
+                                  uint32_t features);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef SCHEDULER_SCHED_SLACK_H
+#define SCHEDULER_SCHED_SLACK_H
+
+#include "sys_config.h"
+#include "task_management.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Per-tick memoised demand-bound slack. The first query of a tick at a
+// criticality level collects and sorts that level's D deadlines, O(D log D),
+// and each DVFS level's prefix sums and minima cost O(D) on first use. Later
+// queries in the same tick are a binary search, O(log D). The timelines are
+// not updated in place: a new tick or an invalidation rebuilds them.
+//
+// Anything that adds a job to or removes a job from a core's running slot,
+// ready/replica queues or pending queue must invalidate that core's engine.
+// Preemption only moves a job between the running slot and a queue, so it
+// leaves the demand as is.
+void slack_engine_init(uint8_t core_id);
+void slack_engine_invalidate(uint8_t core_id);
+
+bool slack_engine_query(uint8_t core_id, criticality_level crit_lvl,
+                        uint32_t tstart, float scaling_factor,
+                        const job_struct *extra_job, float *slack);
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SCHEDULER_SCHED_UTIL_H
 #define SCHEDULER_SCHED_UTIL_H
 
+#include "task_alloc.h"
 #include "task_management.h"
 #include <stdlib.h>
 
@@ -8,19 +9,18 @@
 #define SLACK_CALC_HORIZON_TICKS_CAP 5000
 #define MAX_DEADLINES (MAX_TASKS * 64)
 
-extern const task_struct *task_lookup[MAX_TASKS + 1];
-
 static inline const task_struct *find_task_by_id(uint32_t task_id) {
-  if (task_id > MAX_TASKS)
+  if (task_id >= task_lookup_size)
     return NULL;
   return task_lookup[task_id];
 }
 
-float generate_acet(job_struct *job);
+float generate_acet(const job_struct *job, uint8_t core_id);
 
 uint32_t find_next_effective_arrival_time(uint8_t core_id);
 
 uint32_t calculate_allocated_horizon(uint8_t core_id);
+uint32_t calculate_horizon(uint8_t core_id);
 
 float find_slack(uint8_t core_id, criticality_level crit_lvl, uint32_t tstart,
                  float scaling_factor, const job_struct *extra_job);
@@ -28,6 +28,13 @@ float find_slack_locked(uint8_t core_id, criticality_level crit_lvl,
                         uint32_t tstart, float scaling_factor,
                         const job_struct *extra_job);
 
+// The slack computed from scratch, as find_slack does when the slack engine
+// cannot answer. Expects a valid level and scaling factor and tstart no
+// earlier than the current tick.
+float find_slack_full_locked(uint8_t core_id, criticality_level crit_lvl,
+                             uint32_t tstart, float scaling_factor,
+                             const job_struct *extra_job);
+
 bool is_admissible(uint8_t core_id, job_struct *candidate_job,
                    float extra_margin);
 bool is_admissible_locked(uint8_t core_id, job_struct *candidate_job,
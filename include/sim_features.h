@@ -0,0 +1,30 @@
+#ifndef SIM_FEATURES_H
+#define SIM_FEATURES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Scheduler features, as a bit mask. They are chosen at startup with -f, and
+// a batch manifest can name other ones for each run.
+typedef enum {
+  FEATURE_DVFS = 1 << 0,
+  FEATURE_DPM = 1 << 1,
+  FEATURE_ECC = 1 << 2,
+  FEATURE_PROCRASTINATION = 1 << 3,
+  FEATURE_MIGRATION = 1 << 4,
+} sim_feature;
+
+#define FEATURE_COUNT 5
+#define FEATURE_ALL ((1u << FEATURE_COUNT) - 1)
+
+// Features the scheduler runs with, all of them unless -f says otherwise.
+// Read by scheduler_init, so changes take effect on the next run.
+extern uint32_t sim_features;
+
+// Parses "all", "none" or a comma-separated list such as "dvfs,dpm".
+int features_parse(const char *spec, uint32_t *mask);
+
+// Writes the mask as a list parse accepts back, "none" when empty.
+void features_format(uint32_t mask, char *buf, size_t len);
+
+#endif
@@ -6,6 +6,29 @@
 
 #include <stdint.h>
 
+#define TASK_ALLOC_DEFAULT_PATH "config/task_alloc.bin"
+
+// Binary allocation file written by tools/task_allocator.py. Every field is a
+// little-endian uint32: the header below, then num_tasks task records
+// {id, period, deadline, wcet[max_crit_levels], crit_level, num_replicas},
+// then num_allocs allocation records
+// {task_id, task_type, proc_id, core_id, tuned_deadlines[max_crit_levels]}.
+#define TASK_ALLOC_MAGIC "EEFTALOC"
+#define TASK_ALLOC_VERSION 1
+
+// Task ids index task_lookup directly, so they are kept small.
+#define TASK_ALLOC_MAX_TASK_ID 0xFFFFF
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_proc;
+  uint32_t num_cores_per_proc;
+  uint32_t max_crit_levels;
+  uint32_t num_tasks;
+  uint32_t num_allocs;
+} task_alloc_header;
+
 typedef enum { Primary, Replica } TaskType;
 
 typedef struct {
@@ -16,10 +39,23 @@ typedef struct {
   uint32_t tuned_deadlines[MAX_CRITICALITY_LEVELS];
 } task_alloc_map;
 
-extern const task_struct system_tasks[];
-extern const uint32_t SYSTEM_TASKS_SIZE;
+extern const task_struct *system_tasks;
+extern uint32_t system_tasks_size;
+
+extern const task_alloc_map *allocation_map;
+extern uint32_t allocation_map_size;
+
+// Indexed by task id, NULL where no task has that id.
+extern const task_struct **task_lookup;
+extern uint32_t task_lookup_size;
+
+// Maps and validates an allocation file and builds the tables above from it.
+// The platform it was allocated for must match this build. A single run loads
+// it before forking the processors, so they all share the tables; a batch
+// loads each run's allocation in every processor.
+int task_alloc_load(const char *path);
 
-extern const task_alloc_map allocation_map[];
-extern const uint32_t ALLOCATION_MAP_SIZE;
+// Frees the tables of the loaded allocation, if any.
+void task_alloc_unload(void);
 
 #endif
@@ -10,6 +10,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#define JOBS_PER_CORE 50
+
+// Every job of a processor may end up in the same queue.
+#define JOB_QUEUE_CAPACITY (JOBS_PER_CORE * NUM_CORES_PER_PROC)
+
+// Twice the number of jobs it can hold, keeping probe sequences short.
+#define JOB_INDEX_SLOTS (JOB_QUEUE_CAPACITY * 2)
+
 typedef struct {
   uint32_t id;
 
@@ -29,6 +37,9 @@ typedef enum {
   JOB_STATE_REMOVED,
 } job_state;
 
+struct job_queue;
+struct job_index;
+
 typedef struct job {
   void *next_free;
   const task_struct *parent_task;
@@ -47,6 +58,11 @@ typedef struct job {
 
   struct list_head link;
 
+  struct job_queue *queue;
+  uint32_t queue_pos;
+  uint64_t queue_key;
+  uint64_t queue_seq;
+
   uint32_t next_migration_eligible_tick;
 
   _Atomic int refcount;
@@ -54,6 +70,42 @@ typedef struct job {
   _Atomic bool is_being_offered;
 } job_struct;
 
+typedef struct {
+  job_struct *job;
+  uint32_t task_id;
+  uint32_t arrival_time;
+} job_index_entry;
+
+// Open-addressing hash of queued jobs keyed on (task id, arrival time), with
+// linear probing and backward-shift deletion. A key may map to several jobs.
+typedef struct job_index {
+  job_index_entry slots[JOB_INDEX_SLOTS];
+  uint32_t size;
+} job_index;
+
+// Orders a job_queue, lowest key first. Called once per push; the key is
+// kept in the job while it is queued.
+typedef uint64_t (*job_key_fn)(const job_struct *job);
+
+// 4-ary min-heap keyed on the queue's key function, virtual deadline unless
+// set otherwise, first-in first-out among equal keys. Queued jobs record their
+// queue and slot, so they can be removed by handle. Iteration order is the
+// heap order, not the key order. Queues attached to a job_index keep it in
+// sync on every push and removal.
+typedef struct job_queue {
+  job_struct *slots[JOB_QUEUE_CAPACITY];
+  uint32_t size;
+  uint64_t next_seq;
+  job_index *index;
+  job_key_fn key;
+} job_queue;
+
+#define job_queue_for_each(pos, q)                                             \
+  for (uint32_t __jq_i = 0;                                                    \
+       __jq_i < (q)->size && ((pos) = (q)->slots[__jq_i], true); __jq_i++)
+
+static inline bool job_queue_empty(const job_queue *q) { return q->size == 0; }
+
 void __release_job_to_pool(job_struct *job, uint8_t core_id);
 
 static inline job_struct *get_job_ref(job_struct *job) {
@@ -85,7 +137,27 @@ job_struct *peek_next_job(struct list_head *queue_head);
 job_struct *pop_next_job(struct list_head *queue_head);
 void remove_job_with_parent_task_id(struct list_head *queue_head,
                                     uint32_t task_id, uint8_t core_id);
-void log_job_queue(log_level level, const char *name,
-                   struct list_head *queue_head);
+void log_job_list(log_level level, const char *name,
+                  struct list_head *queue_head);
+
+void job_index_init(job_index *idx);
+void job_index_insert(job_index *idx, job_struct *job);
+void job_index_remove(job_index *idx, const job_struct *job);
+uint32_t job_index_find(const job_index *idx, uint32_t task_id,
+                        uint32_t arrival_time, job_struct **matches,
+                        uint32_t max_matches);
+
+void job_queue_init(job_queue *q);
+void job_queue_attach_index(job_queue *q, job_index *idx);
+// Only while the queue is empty.
+void job_queue_set_key(job_queue *q, job_key_fn key);
+void job_queue_push(job_queue *q, job_struct *job);
+job_struct *job_queue_peek(const job_queue *q);
+job_struct *job_queue_pop(job_queue *q);
+void job_queue_remove(job_queue *q, job_struct *job);
+// Copies the queued jobs into `out` in key order and returns their count.
+uint32_t job_queue_sorted(const job_queue *q,
+                          job_struct *out[JOB_QUEUE_CAPACITY]);
+void log_job_queue(log_level level, const char *name, const job_queue *q);
 
 #endif
@@ -0,0 +1,53 @@
+#ifndef TEST_SCHED_H
+#define TEST_SCHED_H
+
+#include "processor.h"
+#include "task_alloc.h"
+
+#include "scheduler/sched_core.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#define TEST_SCHED_MAX_TASK_ID 64
+
+// Installs an in-memory allocation in place of a loaded file and brings the
+// scheduler of processor 0 up on it at tick `now`. Task ids must be below
+// TEST_SCHED_MAX_TASK_ID.
+static inline int test_sched_load(const task_struct *tasks, uint32_t num_tasks,
+                                  const task_alloc_map *allocs,
+                                  uint32_t num_allocs, uint32_t now) {
+  static const task_struct *lookup[TEST_SCHED_MAX_TASK_ID];
+
+  memset(lookup, 0, sizeof(lookup));
+  for (uint32_t i = 0; i < num_tasks; i++) {
+    if (tasks[i].id >= TEST_SCHED_MAX_TASK_ID) {
+      return -1;
+    }
+    lookup[tasks[i].id] = &tasks[i];
+  }
+
+  system_tasks = tasks;
+  system_tasks_size = num_tasks;
+  allocation_map = allocs;
+  allocation_map_size = num_allocs;
+  task_lookup = lookup;
+  task_lookup_size = TEST_SCHED_MAX_TASK_ID;
+
+  proc_state.processor_id = 0;
+  atomic_store(&proc_state.system_time, now);
+  return scheduler_init();
+}
+
+static inline void test_sched_unload(void) {
+  scheduler_cleanup();
+  system_tasks = NULL;
+  system_tasks_size = 0;
+  allocation_map = NULL;
+  allocation_map_size = 0;
+  task_lookup = NULL;
+  task_lookup_size = 0;
+  atomic_store(&proc_state.system_time, 0);
+}
+
+#endif
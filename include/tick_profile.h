@@ -0,0 +1,81 @@
+#ifndef TICK_PROFILE_H
+#define TICK_PROFILE_H
+
+#include "sys_config.h"
+
+#include <stdint.h>
+
+// Time spent in each phase of a tick, per core thread and for the timer
+// thread, kept in histograms of nanoseconds and written to
+// target/profile/tick_profile_p<id>.{csv,json} when the processor shuts down.
+// Built only with ENABLE_TICK_PROFILE; otherwise the macros below vanish.
+
+typedef enum {
+  TICK_PHASE_ECC,
+  TICK_PHASE_MODE_CHANGE,
+  TICK_PHASE_RUNNING_JOB,
+  TICK_PHASE_ARRIVALS,
+  TICK_PHASE_RECLAIM,
+  TICK_PHASE_MIGRATION,
+  TICK_PHASE_SELECT,
+  TICK_PHASE_PROCRASTINATION,
+  TICK_PHASE_DVFS,
+  TICK_PHASE_DPM,
+  TICK_PHASE_SUMMARY,
+  TICK_PHASE_LOG,
+  TICK_PHASE_TICK,
+  TICK_PHASE_CORE_BARRIER,
+  TICK_PHASE_TIME_SYNC,
+  TICK_PHASE_IPC_RECEIVE,
+  TICK_PHASE_DISCARD_RELEASE,
+  TICK_PHASE_IPC_SEND,
+  TICK_PHASE_PEER_SYNC,
+  TICK_PHASE_PROC_BARRIER,
+  TICK_PHASE_COUNT,
+} tick_phase;
+
+// Row of the timer thread, after those of the cores.
+#define TICK_PROFILE_TIMER NUM_CORES_PER_PROC
+
+#ifdef ENABLE_TICK_PROFILE
+
+#include <time.h>
+
+static inline uint64_t tick_profile_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+// Only the thread owning `thread` records into its row.
+void tick_profile_record(uint8_t thread, tick_phase phase, uint64_t ns);
+
+void tick_profile_init(void);
+
+int tick_profile_dump(uint8_t proc_id);
+
+// Starts a clock; each lap records the time since the previous one.
+#define TICK_PROFILE_BEGIN(clock) uint64_t clock = tick_profile_now()
+
+#define TICK_PROFILE_LAP(thread, phase, clock)                                 \
+  do {                                                                         \
+    uint64_t __tp_now = tick_profile_now();                                    \
+    tick_profile_record((thread), (phase), __tp_now - (clock));                \
+    (clock) = __tp_now;                                                        \
+  } while (0)
+
+#else
+
+#define TICK_PROFILE_BEGIN(clock)
+#define TICK_PROFILE_LAP(thread, phase, clock) ((void)0)
+
+static inline void tick_profile_init(void) {}
+
+static inline int tick_profile_dump(uint8_t proc_id) {
+  (void)proc_id;
+  return 0;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,195 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "affinity.h"
+#include "sys_config.h"
+
+#include "lib/log.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+affinity_policy thread_affinity __attribute__((weak)) = AFFINITY_NONE;
+
+typedef struct {
+  bool bound;
+  bool oversubscribed;
+  int node;
+  int num_nodes;
+  int num_node_cpus;
+  int core_cpu[NUM_CORES_PER_PROC];
+} affinity_placement;
+
+static affinity_placement placement;
+
+#ifdef __linux__
+
+static cpu_set_t node_cpus[AFFINITY_MAX_NODES];
+static int node_ids[AFFINITY_MAX_NODES];
+
+// Parses a sysfs CPU list such as "0-3,8-11".
+static void parse_cpulist(const char *list, cpu_set_t *set) {
+  CPU_ZERO(set);
+
+  const char *p = list;
+  while (*p != '\0' && *p != '\n') {
+    char *end;
+    long first = strtol(p, &end, 10);
+    long last = first;
+    if (end == p) {
+      return;
+    }
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+    }
+    for (long cpu = first; cpu <= last && cpu < AFFINITY_MAX_CPUS; cpu++) {
+      CPU_SET((int)cpu, set);
+    }
+    p = (*end == ',') ? end + 1 : end;
+  }
+}
+
+// Nodes that have at least one CPU this process may run on. Without NUMA
+// information all allowed CPUs form one node.
+static int discover_nodes(const cpu_set_t *allowed) {
+  int num_nodes = 0;
+
+  for (int n = 0; n < AFFINITY_MAX_NODES; n++) {
+    char path[64];
+    char list[4096];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+      continue;
+    }
+    bool ok = fgets(list, sizeof(list), f) != NULL;
+    fclose(f);
+    if (!ok) {
+      continue;
+    }
+
+    parse_cpulist(list, &node_cpus[num_nodes]);
+    CPU_AND(&node_cpus[num_nodes], &node_cpus[num_nodes], allowed);
+    if (CPU_COUNT(&node_cpus[num_nodes]) > 0) {
+      node_ids[num_nodes++] = n;
+    }
+  }
+
+  if (num_nodes == 0) {
+    node_cpus[0] = *allowed;
+    node_ids[0] = 0;
+    num_nodes = 1;
+  }
+
+  return num_nodes;
+}
+
+int affinity_bind_processor(uint8_t proc_id) {
+  if (thread_affinity == AFFINITY_NONE) {
+    return 0;
+  }
+
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    return -1;
+  }
+
+  int num_nodes = discover_nodes(&allowed);
+  int idx = proc_id % num_nodes;
+  int slot = proc_id / num_nodes;
+  const cpu_set_t *set = &node_cpus[idx];
+
+  int cpus[AFFINITY_MAX_CPUS];
+  int num_cpus = 0;
+  for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++) {
+    if (CPU_ISSET(cpu, set)) {
+      cpus[num_cpus++] = cpu;
+    }
+  }
+
+  // Processors sharing a node take consecutive runs of its CPUs; when the
+  // node runs out, core threads start sharing CPUs.
+  for (int i = 0; i < NUM_CORES_PER_PROC; i++) {
+    placement.core_cpu[i] = cpus[(slot * NUM_CORES_PER_PROC + i) % num_cpus];
+  }
+  placement.oversubscribed = (slot + 1) * NUM_CORES_PER_PROC > num_cpus;
+  placement.node = node_ids[idx];
+  placement.num_nodes = num_nodes;
+  placement.num_node_cpus = num_cpus;
+
+  if (sched_setaffinity(0, sizeof(*set), set) != 0) {
+    return -1;
+  }
+
+  // Prefer, rather than bind, so that a full node spills over instead of
+  // failing allocations.
+  unsigned long nodemask[AFFINITY_MAX_NODES / (8 * sizeof(unsigned long))] = {
+      0};
+  nodemask[placement.node / (8 * sizeof(unsigned long))] |=
+      1UL << (placement.node % (8 * sizeof(unsigned long)));
+  if (num_nodes > 1 &&
+      syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodemask,
+              AFFINITY_MAX_NODES + 1) != 0) {
+    return -1;
+  }
+
+  placement.bound = true;
+  return 0;
+}
+
+int affinity_core_thread_attr(pthread_attr_t *attr, uint8_t core_id) {
+  if (!placement.bound) {
+    return 0;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(placement.core_cpu[core_id], &set);
+  return pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
+
+#else
+
+int affinity_bind_processor(uint8_t proc_id) {
+  (void)proc_id;
+  return thread_affinity == AFFINITY_NONE ? 0 : -1;
+}
+
+int affinity_core_thread_attr(pthread_attr_t *attr, uint8_t core_id) {
+  (void)attr;
+  (void)core_id;
+  return 0;
+}
+
+#endif
+
+void affinity_log_placement(void) {
+  if (thread_affinity == AFFINITY_NONE) {
+    return;
+  }
+  if (!placement.bound) {
+    LOG(LOG_LEVEL_WARN, "Could not pin threads, running unpinned");
+    return;
+  }
+
+  LOG(LOG_LEVEL_INFO, "Bound to NUMA node %d of %d (%d CPUs)", placement.node,
+      placement.num_nodes, placement.num_node_cpus);
+  for (int i = 0; i < NUM_CORES_PER_PROC; i++) {
+    LOG(LOG_LEVEL_INFO, "Core %d pinned to CPU %d", i, placement.core_cpu[i]);
+  }
+  if (placement.oversubscribed) {
+    LOG(LOG_LEVEL_WARN, "Node %d has too few CPUs, core threads share CPUs",
+        placement.node);
+  }
+}
@@ -0,0 +1,308 @@
+#include "batch.h"
+#include "processor.h"
+#include "sim_features.h"
+#include "sys_config.h"
+#include "task_alloc.h"
+
+#include "lib/barrier.h"
+
+#include "scheduler/sched_core.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef TOTAL_TICKS
+#define TOTAL_TICKS 0
+#endif
+
+#define BATCH_MANIFEST_LINE_MAX 4096
+
+static const char *status_names[] = {"ok", "miss", "error", "stopped"};
+
+static int add_entry(batch_manifest *manifest, uint32_t *capacity,
+                     const char *path, uint32_t features,
+                     const sched_policy *policy) {
+  if (manifest->count == *capacity) {
+    uint32_t grown = *capacity ? *capacity * 2 : 64;
+    batch_entry *entries =
+        realloc(manifest->entries, grown * sizeof(*manifest->entries));
+    if (entries == NULL) {
+      return -1;
+    }
+    manifest->entries = entries;
+    *capacity = grown;
+  }
+
+  char *copy = strdup(path);
+  if (copy == NULL) {
+    return -1;
+  }
+  manifest->entries[manifest->count].path = copy;
+  manifest->entries[manifest->count].features = features;
+  manifest->entries[manifest->count].policy = policy;
+  manifest->count++;
+  return 0;
+}
+
+// One run per line: an allocation file, optionally followed by the features
+// to run it with ("all", "none" or e.g. "dvfs,dpm") and the scheduling policy;
+// those given with -f and -s otherwise. '#' starts a comment.
+static int read_manifest(const char *path, batch_manifest *manifest) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  char line[BATCH_MANIFEST_LINE_MAX];
+  uint32_t capacity = 0;
+  unsigned line_no = 0;
+  int ret = 0;
+
+  while (ret == 0 && fgets(line, sizeof(line), f) != NULL) {
+    line_no++;
+    line[strcspn(line, "#\r\n")] = '\0';
+
+    char *save = NULL;
+    char *alloc_path = strtok_r(line, " \t", &save);
+    if (alloc_path == NULL) {
+      continue;
+    }
+    char *spec = strtok_r(NULL, " \t", &save);
+    char *policy_name = strtok_r(NULL, " \t", &save);
+
+    uint32_t features = sim_features;
+    const sched_policy *policy = scheduler_policy;
+    if (policy_name != NULL) {
+      policy = sched_policy_find(policy_name);
+    }
+    if ((spec != NULL && features_parse(spec, &features) != 0) ||
+        policy == NULL || strtok_r(NULL, " \t", &save) != NULL) {
+      fprintf(stderr,
+              "%s:%u: expected an allocation file, features and a policy\n",
+              path, line_no);
+      ret = -1;
+    } else if (sched_policy_unsupported(policy, features) != 0) {
+      char unsupported[64];
+      features_format(sched_policy_unsupported(policy, features), unsupported,
+                      sizeof(unsupported));
+      fprintf(stderr, "%s:%u: %s cannot run with %s\n", path, line_no,
+              policy->name, unsupported);
+      ret = -1;
+    } else if (add_entry(manifest, &capacity, alloc_path, features, policy) !=
+               0) {
+      perror("manifest");
+      ret = -1;
+    }
+  }
+
+  fclose(f);
+  if (ret == 0 && manifest->count == 0) {
+    fprintf(stderr, "%s: no runs listed\n", path);
+    ret = -1;
+  }
+  return ret;
+}
+
+int batch_prepare(const char *manifest_path, const char *metrics_path,
+                  batch_manifest *manifest) {
+  if (TOTAL_TICKS == 0) {
+    fprintf(stderr, "Batch mode needs a build with a finite TICKS\n");
+    return -1;
+  }
+
+  manifest->entries = NULL;
+  manifest->count = 0;
+  if (read_manifest(manifest_path, manifest) != 0) {
+    return -1;
+  }
+
+  FILE *out = fopen(metrics_path, "w");
+  if (out == NULL) {
+    perror(metrics_path);
+    return -1;
+  }
+  fputs("run,allocation,features,policy,seed,status,ticks,jobs_released,"
+        "jobs_completed,deadline_misses,mode_changes,preemptions,migrations,"
+        "idle_ticks,low_power_ticks,replica_ticks,energy,replica_energy,"
+        "faults,lost_jobs,replica_saves,unmasked_faults,wall_us\n",
+        out);
+  fclose(out);
+  return 0;
+}
+
+static batch_run_status run_status(const batch_proc_result *results) {
+  batch_run_status worst = BATCH_RUN_OK;
+  for (uint8_t p = 0; p < NUM_PROC; p++) {
+    if (results[p].status > worst) {
+      worst = results[p].status;
+    }
+  }
+  return worst;
+}
+
+static void write_metrics(FILE *out, uint32_t run, const batch_entry *entry,
+                          const batch_proc_result *results, uint64_t wall_us) {
+  core_stats total = {0};
+  fault_stats faults = {0};
+  uint32_t ticks = 0;
+
+  for (uint8_t p = 0; p < NUM_PROC; p++) {
+    const core_stats *s = &results[p].stats;
+    total.jobs_released += s->jobs_released;
+    total.jobs_completed += s->jobs_completed;
+    total.deadline_misses += s->deadline_misses;
+    total.mode_changes += s->mode_changes;
+    total.preemptions += s->preemptions;
+    total.migrations += s->migrations;
+    total.idle_ticks += s->idle_ticks;
+    total.low_power_ticks += s->low_power_ticks;
+    total.replica_ticks += s->replica_ticks;
+    total.energy += s->energy;
+    total.replica_energy += s->replica_energy;
+
+    const fault_stats *f = &results[p].faults;
+    for (int k = 0; k < FAULT_KIND_COUNT; k++) {
+      faults.injected[k] += f->injected[k];
+    }
+    faults.lost_jobs += f->lost_jobs;
+    faults.replica_saves += f->replica_saves;
+    faults.unmasked += f->unmasked;
+    if (results[p].ticks > ticks) {
+      ticks = results[p].ticks;
+    }
+  }
+
+  uint64_t injected = 0;
+  for (int k = 0; k < FAULT_KIND_COUNT; k++) {
+    injected += faults.injected[k];
+  }
+
+  char features[64];
+  features_format(entry->features, features, sizeof(features));
+
+  // The feature list is quoted, it has commas of its own.
+  fprintf(out,
+          "%u,%s,\"%s\",%s,%llu,%s,%u,%llu,%llu,%llu,%llu,%llu,%llu,%llu,"
+          "%llu,%llu,%.1f,%.1f,%llu,%llu,%llu,%llu,%llu\n",
+          run, entry->path, features, entry->policy->name,
+          (unsigned long long)sim_seed, status_names[run_status(results)],
+          ticks,
+          (unsigned long long)total.jobs_released,
+          (unsigned long long)total.jobs_completed,
+          (unsigned long long)total.deadline_misses,
+          (unsigned long long)total.mode_changes,
+          (unsigned long long)total.preemptions,
+          (unsigned long long)total.migrations,
+          (unsigned long long)total.idle_ticks,
+          (unsigned long long)total.low_power_ticks,
+          (unsigned long long)total.replica_ticks, total.energy,
+          total.replica_energy, (unsigned long long)injected,
+          (unsigned long long)faults.lost_jobs,
+          (unsigned long long)faults.replica_saves,
+          (unsigned long long)faults.unmasked, (unsigned long long)wall_us);
+}
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+// Loads the entry and resets the processor for it. Every processor decides
+// on its own; they compare notes at the barrier that follows.
+static batch_run_status prepare_run(const batch_entry *entry, uint32_t run) {
+  if (processor_stop_requested()) {
+    return BATCH_RUN_STOPPED;
+  }
+  sim_features = entry->features;
+  scheduler_policy = entry->policy;
+  if (task_alloc_load(entry->path) != 0 || processor_reset(run) != 0) {
+    return BATCH_RUN_ERROR;
+  }
+  return BATCH_RUN_OK;
+}
+
+void batch_run(uint8_t proc_id, const batch_manifest *manifest,
+               batch_shared *shared, const char *metrics_path) {
+  processor_init(proc_id);
+  if (processor_start() != 0) {
+    _exit(EXIT_FAILURE);
+  }
+
+  FILE *out = NULL;
+  if (proc_id == 0) {
+    out = fopen(metrics_path, "a");
+    if (out == NULL) {
+      perror(metrics_path);
+    }
+  }
+
+  uint32_t counts[BATCH_RUN_STOPPED + 1] = {0};
+  uint64_t batch_start = now_us();
+
+  for (uint32_t i = 0; i < manifest->count; i++) {
+    const batch_entry *entry = &manifest->entries[i];
+    batch_proc_result *results = shared->result[i % 2];
+    batch_proc_result *mine = &results[proc_id];
+
+    memset(mine, 0, sizeof(*mine));
+    mine->status = prepare_run(entry, i + 1);
+    if (proc_id == 0) {
+      atomic_store(proc_abort_iteration, UINT32_MAX);
+    }
+    barrier_wait(proc_barrier);
+
+    batch_run_status agreed = run_status(results);
+    if (agreed == BATCH_RUN_STOPPED) {
+      task_alloc_unload();
+      break;
+    }
+
+    uint64_t start = now_us();
+    if (agreed == BATCH_RUN_OK) {
+      processor_simulate();
+      scheduler_read_stats(&mine->stats);
+      fault_read_stats(&mine->faults);
+      mine->ticks = proc_state.system_time;
+      if (mine->stats.deadline_misses > 0) {
+        mine->status = BATCH_RUN_MISS;
+      } else if (atomic_load(&core_fatal_shutdown_requested)) {
+        mine->status = BATCH_RUN_ERROR;
+      }
+    }
+    uint64_t wall_us = now_us() - start;
+    task_alloc_unload();
+    barrier_wait(proc_barrier);
+
+    if (proc_id == 0) {
+      counts[run_status(results)]++;
+      if (out != NULL) {
+        write_metrics(out, i, entry, results, wall_us);
+      }
+    }
+  }
+
+  if (proc_id == 0) {
+    double seconds = (double)(now_us() - batch_start) / 1e6;
+    uint32_t total =
+        counts[BATCH_RUN_OK] + counts[BATCH_RUN_MISS] + counts[BATCH_RUN_ERROR];
+    printf("Batch: %u runs, %u ok, %u missed deadlines, %u failed in %.2f s "
+           "(%.1f runs/s)\n",
+           total, counts[BATCH_RUN_OK], counts[BATCH_RUN_MISS],
+           counts[BATCH_RUN_ERROR], seconds,
+           seconds > 0 ? total / seconds : 0.0);
+    fflush(stdout);
+    if (out != NULL) {
+      fclose(out);
+    }
+  }
+
+  processor_stop();
+  processor_cleanup();
+  _exit(processor_stop_requested() ? EXIT_FAILURE : EXIT_SUCCESS);
+}
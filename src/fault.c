@@ -0,0 +1,447 @@
+#include "fault.h"
+#include "ipc.h"
+#include "task_alloc.h"
+
+#include "lib/log.h"
+#include "lib/ring_buffer.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FAULT_SEED_SALT 0xFA17ull
+
+static const char *kind_names[FAULT_KIND_COUNT] = {
+    "crash",
+    "corrupt",
+    "drop",
+    "delay",
+};
+
+static const char *dist_names[] = {"none", "fixed", "uniform", "exp"};
+
+fault_spec fault_specs[FAULT_KIND_COUNT];
+
+fault_core fault_cores[NUM_CORES_PER_PROC];
+
+// The processor's IPC faults, driven by the timer thread.
+static rng drop_rng;
+static rng delay_rng;
+static uint32_t next_drop;
+static uint32_t next_delay;
+static uint32_t ipc_until;
+static fault_ipc_action ipc_action;
+
+// Primaries allocated to the processors NUM_FAULTS leaves out. Processor 0
+// accounts for their releases.
+typedef struct {
+  const task_struct *task;
+  uint32_t next_release;
+} absent_primary;
+
+static absent_primary *absent_primaries = NULL;
+static uint32_t num_absent_primaries = 0;
+
+typedef struct {
+  uint32_t task_id;
+  uint32_t arrival;
+  uint32_t deadline;
+} lost_primary;
+
+static pthread_mutex_t ledger_lock = PTHREAD_MUTEX_INITIALIZER;
+static lost_primary ledger[FAULT_LEDGER_SIZE];
+static uint32_t ledger_count;
+static completion_message recent[FAULT_RECENT_COMPLETIONS];
+static uint32_t recent_next;
+static uint32_t grace_ticks;
+
+static fault_stats proc_stats;
+static bool enabled;
+
+static int parse_one(char *entry) {
+  char *save = NULL;
+  char *kind = strtok_r(entry, ":", &save);
+  char *dist = strtok_r(NULL, ":", &save);
+  char *interval = strtok_r(NULL, ":", &save);
+  char *duration = strtok_r(NULL, ":", &save);
+
+  if (kind == NULL || dist == NULL || interval == NULL ||
+      strtok_r(NULL, ":", &save) != NULL) {
+    return -1;
+  }
+
+  int k = 0;
+  while (k < FAULT_KIND_COUNT && strcmp(kind, kind_names[k]) != 0) {
+    k++;
+  }
+  uint32_t d = FAULT_DIST_FIXED;
+  while (d <= FAULT_DIST_EXP && strcmp(dist, dist_names[d]) != 0) {
+    d++;
+  }
+  if (k == FAULT_KIND_COUNT || d > FAULT_DIST_EXP) {
+    return -1;
+  }
+
+  char *end;
+  unsigned long mean = strtoul(interval, &end, 10);
+  if (*end != '\0' || mean == 0 || mean > UINT32_MAX / 4) {
+    return -1;
+  }
+  unsigned long length = 0;
+  if (duration != NULL) {
+    length = strtoul(duration, &end, 10);
+    if (*end != '\0' || length > UINT32_MAX / 4) {
+      return -1;
+    }
+  }
+
+  fault_specs[k] = (fault_spec){
+      .dist = d, .interval = (uint32_t)mean, .duration = (uint32_t)length};
+  return 0;
+}
+
+int faults_parse(const char *spec) {
+  char buf[256];
+  char *save = NULL;
+
+  if (strlen(spec) >= sizeof(buf)) {
+    return -1;
+  }
+  strcpy(buf, spec);
+
+  for (char *entry = strtok_r(buf, ",", &save); entry != NULL;
+       entry = strtok_r(NULL, ",", &save)) {
+    if (parse_one(entry) != 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static inline uint32_t after(uint32_t now, uint32_t ticks) {
+  return ticks > UINT32_MAX - now ? UINT32_MAX : now + ticks;
+}
+
+static uint32_t draw_interval(const fault_spec *spec, rng *r) {
+  switch (spec->dist) {
+  case FAULT_DIST_FIXED:
+    return spec->interval;
+  case FAULT_DIST_UNIFORM:
+    return 1 + (uint32_t)(rng_float(r) * 2.0f * (float)spec->interval);
+  case FAULT_DIST_EXP: {
+    float ticks = -(float)spec->interval * logf(1.0f - rng_float(r));
+    return ticks < 1.0f ? 1 : (uint32_t)fminf(ticks, (float)(UINT32_MAX / 2));
+  }
+  default:
+    return UINT32_MAX;
+  }
+}
+
+static void seed(rng *r, fault_kind kind, uint8_t place) {
+  uint64_t where = (uint64_t)proc_state.processor_id << 8 | place;
+  rng_init(r, rng_mix(rng_mix(sim_seed, FAULT_SEED_SALT + kind), where));
+}
+
+static void find_absent_primaries(void) {
+  free(absent_primaries);
+  absent_primaries = NULL;
+  num_absent_primaries = 0;
+
+  if (NUM_FAULTS == 0 || proc_state.processor_id != 0) {
+    return;
+  }
+
+  absent_primaries =
+      malloc(allocation_map_size * sizeof(*absent_primaries) + 1);
+  if (absent_primaries == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < allocation_map_size; i++) {
+    const task_alloc_map *instance = &allocation_map[i];
+    if (instance->proc_id < NUM_PROC || instance->task_type != Primary ||
+        instance->task_id >= task_lookup_size ||
+        task_lookup[instance->task_id] == NULL ||
+        task_lookup[instance->task_id]->period == 0) {
+      continue;
+    }
+    absent_primaries[num_absent_primaries++] = (absent_primary){
+        .task = task_lookup[instance->task_id], .next_release = 0};
+  }
+}
+
+void fault_init(void) {
+  for (uint8_t i = 0; i < NUM_CORES_PER_PROC; i++) {
+    fault_core *fc = &fault_cores[i];
+    memset(fc, 0, sizeof(*fc));
+    seed(&fc->crash_rng, FAULT_CRASH, i);
+    seed(&fc->corrupt_rng, FAULT_CORRUPT, i);
+    fc->next_crash = draw_interval(&fault_specs[FAULT_CRASH], &fc->crash_rng);
+    fc->next_corrupt =
+        draw_interval(&fault_specs[FAULT_CORRUPT], &fc->corrupt_rng);
+    fc->up_at = UINT32_MAX;
+    fc->next_change =
+        fc->next_crash < fc->next_corrupt ? fc->next_crash : fc->next_corrupt;
+  }
+
+  seed(&drop_rng, FAULT_DROP, 0xFF);
+  seed(&delay_rng, FAULT_DELAY, 0xFF);
+  next_drop = draw_interval(&fault_specs[FAULT_DROP], &drop_rng);
+  next_delay = draw_interval(&fault_specs[FAULT_DELAY], &delay_rng);
+  ipc_until = 0;
+  ipc_action = FAULT_IPC_DELIVER;
+
+  find_absent_primaries();
+
+  pthread_mutex_lock(&ledger_lock);
+  ledger_count = 0;
+  recent_next = 0;
+  memset(recent, 0, sizeof(recent));
+  memset(&proc_stats, 0, sizeof(proc_stats));
+  pthread_mutex_unlock(&ledger_lock);
+
+  // A completion can arrive late by a whole drop or delay window, or by a
+  // NACK round trip.
+  uint32_t window = fault_specs[FAULT_DROP].duration;
+  if (fault_specs[FAULT_DELAY].duration > window) {
+    window = fault_specs[FAULT_DELAY].duration;
+  }
+  grace_ticks = FAULT_GRACE_TICKS + window + IPC_NACK_RETRY_TICKS;
+
+  enabled = num_absent_primaries > 0;
+  for (int k = 0; k < FAULT_KIND_COUNT; k++) {
+    if (fault_specs[k].dist != FAULT_DIST_NONE) {
+      enabled = true;
+      LOG(LOG_LEVEL_INFO, "Injecting %s faults: %s, every %u ticks, for %u",
+          kind_names[k], dist_names[fault_specs[k].dist],
+          fault_specs[k].interval, fault_specs[k].duration);
+    }
+  }
+}
+
+void fault_cleanup(void) {
+  if (enabled) {
+    fault_stats stats;
+    fault_read_stats(&stats);
+    LOG(LOG_LEVEL_WARN,
+        "Faults: %llu crashes, %llu corruptions, %llu drops, %llu delays",
+        (unsigned long long)stats.injected[FAULT_CRASH],
+        (unsigned long long)stats.injected[FAULT_CORRUPT],
+        (unsigned long long)stats.injected[FAULT_DROP],
+        (unsigned long long)stats.injected[FAULT_DELAY]);
+    LOG(LOG_LEVEL_WARN,
+        "Faults: %llu jobs lost, %llu saved by replicas, %llu unmasked",
+        (unsigned long long)stats.lost_jobs,
+        (unsigned long long)stats.replica_saves,
+        (unsigned long long)stats.unmasked);
+  }
+  free(absent_primaries);
+  absent_primaries = NULL;
+  num_absent_primaries = 0;
+}
+
+fault_core_status fault_core_advance(uint8_t core_id) {
+  fault_core *fc = &fault_cores[core_id];
+  uint32_t now = proc_state.system_time;
+  fault_core_status status = fc->down ? FAULT_CORE_DOWN : FAULT_CORE_UP;
+
+  if (fc->down && now >= fc->up_at) {
+    LOG(LOG_LEVEL_WARN, "Core recovered from a crash");
+    fc->down = false;
+    fc->down_ticks += now - fc->down_since;
+    status = FAULT_CORE_UP;
+  }
+
+  const fault_spec *crash = &fault_specs[FAULT_CRASH];
+  if (!fc->down && now >= fc->next_crash) {
+    fc->down = true;
+    fc->down_since = now;
+    fc->crashes++;
+    fc->up_at = crash->duration > 0 ? after(now, crash->duration) : UINT32_MAX;
+    fc->next_crash = after(fc->up_at, draw_interval(crash, &fc->crash_rng));
+    status = FAULT_CORE_CRASHED;
+  }
+
+  if (now >= fc->next_corrupt) {
+    fc->corrupt_armed = true;
+    fc->next_corrupt = after(
+        now, draw_interval(&fault_specs[FAULT_CORRUPT], &fc->corrupt_rng));
+  }
+
+  uint32_t next = fc->down ? fc->up_at : fc->next_crash;
+  fc->next_change = next < fc->next_corrupt ? next : fc->next_corrupt;
+  return status;
+}
+
+// Settles ledger entry `i`, which the caller holds the lock for.
+static void settle(uint32_t i, bool saved) {
+  if (saved) {
+    proc_stats.replica_saves++;
+  } else {
+    proc_stats.unmasked++;
+  }
+  ledger[i] = ledger[--ledger_count];
+}
+
+void fault_job_lost(const task_struct *task, uint32_t arrival,
+                    bool is_replica) {
+  uint32_t deadline = arrival + task->deadline;
+
+  pthread_mutex_lock(&ledger_lock);
+  proc_stats.lost_jobs++;
+
+  if (!is_replica) {
+    // Another copy may have completed already.
+    for (uint32_t i = 0; i < FAULT_RECENT_COMPLETIONS; i++) {
+      const completion_message *msg = &recent[i];
+      if (msg->completed_task_id == task->id &&
+          msg->job_arrival_time == arrival && msg->system_time != 0) {
+        if (msg->system_time <= deadline) {
+          proc_stats.replica_saves++;
+        } else {
+          proc_stats.unmasked++;
+        }
+        pthread_mutex_unlock(&ledger_lock);
+        return;
+      }
+    }
+
+    if (ledger_count < FAULT_LEDGER_SIZE) {
+      ledger[ledger_count++] = (lost_primary){
+          .task_id = task->id, .arrival = arrival, .deadline = deadline};
+    } else {
+      LOG(LOG_LEVEL_WARN, "Fault ledger full, not tracking job %u", task->id);
+    }
+  }
+  pthread_mutex_unlock(&ledger_lock);
+}
+
+static void start_ipc_fault(fault_kind kind, fault_ipc_action action,
+                            uint32_t *next, rng *r) {
+  uint32_t now = proc_state.system_time;
+  const fault_spec *spec = &fault_specs[kind];
+  uint32_t duration = spec->duration > 0 ? spec->duration : 1;
+
+  ipc_action = action;
+  ipc_until = after(now, duration);
+  *next = after(ipc_until, draw_interval(spec, r));
+  proc_stats.injected[kind]++;
+  LOG(LOG_LEVEL_WARN, "Injected IPC %s fault until tick %u", kind_names[kind],
+      ipc_until);
+}
+
+void fault_timer_tick(void) {
+  if (!enabled) {
+    return;
+  }
+  uint32_t now = proc_state.system_time;
+
+  if (ipc_action != FAULT_IPC_DELIVER && now >= ipc_until) {
+    ipc_action = FAULT_IPC_DELIVER;
+  }
+  if (ipc_action == FAULT_IPC_DELIVER && now >= next_drop) {
+    start_ipc_fault(FAULT_DROP, FAULT_IPC_DROP, &next_drop, &drop_rng);
+  }
+  if (ipc_action == FAULT_IPC_DELIVER && now >= next_delay) {
+    start_ipc_fault(FAULT_DELAY, FAULT_IPC_HOLD, &next_delay, &delay_rng);
+  }
+
+  criticality_level level = atomic_load(&proc_state.system_criticality_level);
+  for (uint32_t i = 0; i < num_absent_primaries; i++) {
+    absent_primary *ap = &absent_primaries[i];
+    while (ap->next_release <= now) {
+      if (ap->task->crit_level >= level) {
+        fault_job_lost(ap->task, ap->next_release, false);
+      }
+      ap->next_release += ap->task->period;
+    }
+  }
+}
+
+fault_ipc_action fault_ipc_now(void) { return ipc_action; }
+
+void fault_count_packet(fault_ipc_action action) {
+  if (action == FAULT_IPC_DROP) {
+    proc_stats.packets_dropped++;
+  } else if (action == FAULT_IPC_HOLD) {
+    proc_stats.packets_delayed++;
+  }
+}
+
+// Settles the ledger entries the completion matches. The caller holds the
+// ledger lock.
+static void note_completion(const completion_message *msg) {
+  recent[recent_next] = *msg;
+  recent_next = (recent_next + 1) % FAULT_RECENT_COMPLETIONS;
+
+  for (uint32_t i = 0; i < ledger_count;) {
+    if (ledger[i].task_id == msg->completed_task_id &&
+        ledger[i].arrival == msg->job_arrival_time) {
+      settle(i, msg->system_time <= ledger[i].deadline);
+    } else {
+      i++;
+    }
+  }
+}
+
+void fault_job_completed(const completion_message *msg) {
+  if (!enabled) {
+    return;
+  }
+  pthread_mutex_lock(&ledger_lock);
+  note_completion(msg);
+  pthread_mutex_unlock(&ledger_lock);
+}
+
+void fault_observe_completions(void) {
+  if (!enabled) {
+    return;
+  }
+  uint32_t now = proc_state.system_time;
+  completion_message *msg;
+
+  pthread_mutex_lock(&ledger_lock);
+  ring_buffer_iter_read_unsafe(&proc_state.incoming_completion_msg_queue,
+                               msg) {
+    note_completion(msg);
+  }
+
+  for (uint32_t i = 0; i < ledger_count;) {
+    if (now > after(ledger[i].deadline, grace_ticks)) {
+      settle(i, false);
+    } else {
+      i++;
+    }
+  }
+  pthread_mutex_unlock(&ledger_lock);
+}
+
+uint32_t fault_next_tick(void) {
+  uint32_t next = ipc_action != FAULT_IPC_DELIVER ? ipc_until : UINT32_MAX;
+  if (next_drop < next) {
+    next = next_drop;
+  }
+  if (next_delay < next) {
+    next = next_delay;
+  }
+  for (uint8_t i = 0; i < NUM_CORES_PER_PROC; i++) {
+    if (fault_cores[i].next_change < next) {
+      next = fault_cores[i].next_change;
+    }
+  }
+  return next;
+}
+
+void fault_read_stats(fault_stats *out) {
+  pthread_mutex_lock(&ledger_lock);
+  *out = proc_stats;
+  pthread_mutex_unlock(&ledger_lock);
+
+  uint32_t now = proc_state.system_time;
+  for (uint8_t i = 0; i < NUM_CORES_PER_PROC; i++) {
+    const fault_core *fc = &fault_cores[i];
+    out->injected[FAULT_CRASH] += fc->crashes;
+    out->injected[FAULT_CORRUPT] += fc->corruptions;
+    out->down_ticks += fc->down_ticks + (fc->down ? now - fc->down_since : 0);
+  }
+}
@@ -1,33 +1,146 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
 #include "ipc.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <memory.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <arpa/inet.h>
+#include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <stdatomic.h>
 
+#include "fault.h"
 #include "lib/log.h"
 #include "processor.h"
+#include "replay.h"
 
 #define MCAST_GROUP "239.0.0.1"
 #define MCAST_PORT 12345
 
+#define IPC_BATCH_PACKETS (NUM_PROC * 4)
+
+#if defined(IPC_DEFAULT_UDP_BATCH)
+ipc_transport_kind ipc_transport = IPC_TRANSPORT_UDP_BATCH;
+#elif defined(IPC_DEFAULT_UDP)
+ipc_transport_kind ipc_transport = IPC_TRANSPORT_UDP;
+#else
+ipc_transport_kind ipc_transport = IPC_TRANSPORT_SHM;
+#endif
+
+ipc_shm_segment *ipc_shm __attribute__((weak)) = NULL;
+ipc_peer_list *ipc_peers __attribute__((weak)) = NULL;
+
 static int sockfd = -1;
 static struct sockaddr_in mcast_addr;
 
+// Every UDP packet goes to each of these: the multicast group, or each peer
+// (this processor included) when running distributed.
+static const struct sockaddr_in *dests = &mcast_addr;
+static uint8_t num_dests = 1;
+
 static completion_message g_incoming_buf[MESSAGE_QUEUE_SIZE];
 static _Atomic uint64_t g_incoming_seq[MESSAGE_QUEUE_SIZE];
 static completion_message g_outgoing_buf[MESSAGE_QUEUE_SIZE];
 static _Atomic uint64_t g_outgoing_seq[MESSAGE_QUEUE_SIZE];
 
-void ipc_thread_init(void) {
+typedef struct {
+  _Atomic uint64_t packets_sent;
+  _Atomic uint64_t packets_received;
+  _Atomic uint64_t syscalls;
+  _Atomic uint64_t lost;
+  _Atomic uint64_t recovered;
+  _Atomic uint64_t unrecovered;
+  _Atomic uint64_t duplicates;
+  _Atomic uint64_t nacks_sent;
+  _Atomic uint64_t retransmitted;
+  _Atomic uint64_t expired;
+} ipc_atomic_counters;
+
+static ipc_atomic_counters counters;
+
+#define COUNT(field, n)                                                        \
+  atomic_fetch_add_explicit(&counters.field, (n), memory_order_relaxed)
+
+// Packets this processor sent, kept until IPC_HISTORY_SIZE newer ones
+// replace them. A packet is composed in place, so the copy sent is the copy
+// retransmitted. Every peer sees a retransmission, so NACKs for the same
+// packet are answered at most once per NACK retry interval.
+typedef struct {
+  uint32_t seq;
+  uint32_t resent_tick;
+  uint16_t len;
+  bool resent;
+  bool valid;
+  char data[IPC_MAX_PACKET_SIZE];
+} ipc_history_entry;
+
+static ipc_history_entry history[IPC_HISTORY_SIZE];
+static uint32_t next_send_seq = 0;
+static pthread_mutex_t send_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct {
+  ipc_seq_window window;
+  uint32_t last_nack_tick;
+  bool nack_due;
+} ipc_peer_state;
+
+static ipc_peer_state peers[NUM_PROC];
+
+// Packets received during an injected delay, handled once it ends.
+#define IPC_HELD_PACKETS 64
+
+typedef struct {
+  uint16_t len;
+  char data[IPC_MAX_PACKET_SIZE];
+} ipc_held_packet;
+
+static ipc_held_packet held[IPC_HELD_PACKETS];
+static uint32_t num_held = 0;
+
+#ifdef __linux__
+// Receive and send descriptors for the batched transport, set up once so a
+// tick costs one recvmmsg and at most one sendmmsg.
+typedef struct {
+  char rx_buf[IPC_BATCH_PACKETS][IPC_MAX_PACKET_SIZE];
+  struct iovec rx_iov[IPC_BATCH_PACKETS];
+  struct mmsghdr rx_msgs[IPC_BATCH_PACKETS];
+
+  struct iovec tx_iov;
+  struct mmsghdr tx_msgs[NUM_PROC];
+} ipc_batch_state;
+
+static ipc_batch_state batch;
+#endif
+
+// Highest criticality level raised by a core since the last tick packet,
+// only used by the batched transport.
+static _Atomic int pending_criticality = 0;
+
+static uint32_t current_run = 0;
+
+void ipc_shm_segment_init(ipc_shm_segment *seg) {
+  for (uint8_t i = 0; i < NUM_PROC; i++) {
+    ipc_shm_inbox *inbox = &seg->inbox[i];
+    ring_buffer_init(&inbox->ring, IPC_SHM_INBOX_SIZE, inbox->slots,
+                     inbox->seq, sizeof(ipc_shm_slot));
+    atomic_store(&inbox->dropped, 0);
+  }
+}
+
+static void udp_init(void) {
   sockfd = socket(AF_INET, SOCK_DGRAM, 0);
   if (sockfd < 0) {
     perror("socket() failed");
@@ -110,28 +223,516 @@ void ipc_thread_init(void) {
     exit(EXIT_FAILURE);
   }
 
+  LOG(LOG_LEVEL_INFO,
+      "IPC thread initialized. Multicasting to %s:%d (loopback-only)",
+      MCAST_GROUP, MCAST_PORT);
+}
+
+
+// Unicast setup for distributed runs: bind to this processor's own peer
+// address and send every packet to each peer.
+static void udp_peer_init(void) {
+  const struct sockaddr_in *self = &ipc_peers->addr[proc_state.processor_id];
+
+  sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sockfd < 0) {
+    perror("socket() failed");
+    exit(EXIT_FAILURE);
+  }
+
+  struct sockaddr_in local_addr;
+  memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sin_family = AF_INET;
+  local_addr.sin_port = self->sin_port;
+  local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(sockfd, (struct sockaddr *)&local_addr, sizeof(local_addr)) < 0) {
+    perror("bind() failed");
+    close(sockfd);
+    exit(EXIT_FAILURE);
+  }
+
+  int flags = fcntl(sockfd, F_GETFL, 0);
+  if (flags < 0 || fcntl(sockfd, F_SETFL, flags | O_NONBLOCK) < 0) {
+    perror("fcntl(O_NONBLOCK) failed");
+    close(sockfd);
+    exit(EXIT_FAILURE);
+  }
+
+  dests = ipc_peers->addr;
+  num_dests = NUM_PROC;
+
+  LOG(LOG_LEVEL_INFO,
+      "IPC thread initialized. Sending to %d peers, listening on port %d",
+      NUM_PROC, ntohs(self->sin_port));
+}
+
+int ipc_parse_peers(const char *spec, ipc_peer_list *out) {
+  char buf[1024];
+  char *save = NULL;
+  uint8_t count = 0;
+
+  if (strlen(spec) >= sizeof(buf)) {
+    return -1;
+  }
+  strcpy(buf, spec);
+
+  for (char *entry = strtok_r(buf, ",", &save); entry != NULL;
+       entry = strtok_r(NULL, ",", &save)) {
+    char *colon = strrchr(entry, ':');
+    if (colon == NULL || count >= NUM_PROC) {
+      return -1;
+    }
+    *colon = '\0';
+
+    struct addrinfo hints = {.ai_family = AF_INET, .ai_socktype = SOCK_DGRAM};
+    struct addrinfo *res;
+    if (getaddrinfo(entry, colon + 1, &hints, &res) != 0) {
+      return -1;
+    }
+    memcpy(&out->addr[count++], res->ai_addr, sizeof(struct sockaddr_in));
+    freeaddrinfo(res);
+  }
+
+  return count == NUM_PROC ? 0 : -1;
+}
+
+#ifdef __linux__
+static void batch_init(void) {
+  for (int i = 0; i < IPC_BATCH_PACKETS; i++) {
+    batch.rx_iov[i].iov_base = batch.rx_buf[i];
+    batch.rx_iov[i].iov_len = sizeof(batch.rx_buf[i]);
+    batch.rx_msgs[i].msg_hdr.msg_iov = &batch.rx_iov[i];
+    batch.rx_msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  for (uint8_t i = 0; i < num_dests; i++) {
+    batch.tx_msgs[i].msg_hdr.msg_iov = &batch.tx_iov;
+    batch.tx_msgs[i].msg_hdr.msg_iovlen = 1;
+    batch.tx_msgs[i].msg_hdr.msg_name = (void *)&dests[i];
+    batch.tx_msgs[i].msg_hdr.msg_namelen = sizeof(dests[i]);
+  }
+}
+#endif
+
+void ipc_thread_init(void) {
+  if (ipc_transport == IPC_TRANSPORT_SHM && ipc_shm == NULL) {
+    LOG(LOG_LEVEL_WARN, "No shared IPC segment, falling back to UDP");
+    ipc_transport = IPC_TRANSPORT_UDP;
+  }
+#ifndef __linux__
+  if (ipc_transport == IPC_TRANSPORT_UDP_BATCH) {
+    LOG(LOG_LEVEL_WARN, "recvmmsg is not available, falling back to UDP");
+    ipc_transport = IPC_TRANSPORT_UDP;
+  }
+#endif
+
+  if (ipc_transport == IPC_TRANSPORT_REPLAY) {
+    LOG(LOG_LEVEL_INFO,
+        "IPC thread initialized. Replaying recorded deliveries");
+  } else if (ipc_transport != IPC_TRANSPORT_SHM) {
+    if (ipc_peers != NULL) {
+      udp_peer_init();
+    } else {
+      udp_init();
+    }
+#ifdef __linux__
+    if (ipc_transport == IPC_TRANSPORT_UDP_BATCH) {
+      batch_init();
+    }
+#endif
+  } else {
+    LOG(LOG_LEVEL_INFO,
+        "IPC thread initialized. Using shared-memory inboxes (%d slots)",
+        IPC_SHM_INBOX_SIZE);
+  }
+
   ring_buffer_init(&proc_state.incoming_completion_msg_queue,
                    MESSAGE_QUEUE_SIZE, g_incoming_buf, g_incoming_seq,
                    sizeof(completion_message));
   ring_buffer_init(&proc_state.outgoing_completion_msg_queue,
                    MESSAGE_QUEUE_SIZE, g_outgoing_buf, g_outgoing_seq,
                    sizeof(completion_message));
+}
 
-  LOG(LOG_LEVEL_INFO,
-      "IPC thread initialized. Multicasting to %s:%d (loopback-only)",
-      MCAST_GROUP, MCAST_PORT);
+static void udp_send(const char *packet, size_t len) {
+  for (uint8_t i = 0; i < num_dests; i++) {
+    ssize_t sent_len = sendto(sockfd, packet, len, 0,
+                              (const struct sockaddr *)&dests[i],
+                              sizeof(dests[i]));
+    COUNT(syscalls, 1);
+
+    if (sent_len < 0) {
+      perror("sendto() failed");
+    } else if ((size_t)sent_len != len) {
+      fprintf(stderr, "Warning: sendto() sent partial packet!\n");
+    }
+  }
 }
 
-void ipc_receive_completion_messages(void) {
-  LOG(LOG_LEVEL_DEBUG, "Checking for incoming completion messages...");
-  char packet_buf[1 + (MESSAGE_QUEUE_SIZE * sizeof(completion_message))];
+#ifdef __linux__
+static void batch_send(const char *packet, size_t len) {
+  batch.tx_iov.iov_base = (void *)packet;
+  batch.tx_iov.iov_len = len;
+
+  unsigned int done = 0;
+  while (done < num_dests) {
+    int sent = sendmmsg(sockfd, &batch.tx_msgs[done], num_dests - done, 0);
+    COUNT(syscalls, 1);
+
+    if (sent < 0) {
+      perror("sendmmsg() failed");
+      break;
+    }
+    done += (unsigned int)sent;
+  }
+}
+#endif
+
+// Delivers to every inbox including our own, as multicast loopback does. A
+// full inbox drops the packet instead of waiting: its owner may itself be
+// waiting for us at the tick barrier.
+static void shm_send(const char *packet, size_t len) {
+  ipc_shm_slot slot;
+  slot.len = (uint16_t)len;
+  memcpy(slot.data, packet, len);
+
+  for (uint8_t i = 0; i < NUM_PROC; i++) {
+    ipc_shm_inbox *inbox = &ipc_shm->inbox[i];
+    int ret;
+    while ((ret = ring_buffer_try_enqueue(&inbox->ring, &slot)) == -EAGAIN)
+      ;
+    if (ret != 0) {
+      atomic_fetch_add(&inbox->dropped, 1);
+    }
+  }
+}
+
+static void transport_send(const char *packet, size_t len) {
+  COUNT(packets_sent, 1);
+
+  switch (ipc_transport) {
+  case IPC_TRANSPORT_SHM:
+    shm_send(packet, len);
+    break;
+  case IPC_TRANSPORT_REPLAY:
+    break;
+#ifdef __linux__
+  case IPC_TRANSPORT_UDP_BATCH:
+    batch_send(packet, len);
+    break;
+#endif
+  default:
+    udp_send(packet, len);
+    break;
+  }
+}
+
+static void write_header(char *packet, packet_type type, uint32_t seq,
+                         uint8_t flags) {
+  ipc_header hdr = {
+      .version = IPC_WIRE_VERSION,
+      .type = (uint8_t)type,
+      .sender = proc_state.processor_id,
+      .flags = flags,
+      .seq = seq,
+      .tick = proc_state.system_time,
+      .run = current_run,
+  };
+  memcpy(packet, &hdr, sizeof(hdr));
+}
+
+// Numbers the packet, composes it in the history ring from up to two payload
+// parts and sends it.
+static void send_sequenced(packet_type type, const void *part1, size_t len1,
+                           const void *part2, size_t len2) {
+  pthread_mutex_lock(&send_lock);
+
+  uint32_t seq = next_send_seq++;
+  ipc_history_entry *entry = &history[seq % IPC_HISTORY_SIZE];
+
+  write_header(entry->data, type, seq, 0);
+  memcpy(entry->data + sizeof(ipc_header), part1, len1);
+  if (len2 > 0) {
+    memcpy(entry->data + sizeof(ipc_header) + len1, part2, len2);
+  }
+  entry->seq = seq;
+  entry->len = (uint16_t)(sizeof(ipc_header) + len1 + len2);
+  entry->resent = false;
+  entry->valid = true;
+
+  transport_send(entry->data, entry->len);
+
+  pthread_mutex_unlock(&send_lock);
+}
+
+static void handle_nack(const nack_message *nack, uint8_t sender) {
+  if (nack->target != proc_state.processor_id) {
+    return;
+  }
+
+  uint32_t seqs[IPC_HISTORY_SIZE];
+  uint32_t count = ipc_nack_seqs(nack, seqs);
+
+  pthread_mutex_lock(&send_lock);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t seq = seqs[i];
+    ipc_history_entry *entry = &history[seq % IPC_HISTORY_SIZE];
+    if (!entry->valid || entry->seq != seq) {
+      COUNT(expired, 1);
+      continue;
+    }
+    if (entry->resent &&
+        proc_state.system_time - entry->resent_tick < IPC_NACK_RETRY_TICKS) {
+      continue;
+    }
+    entry->resent = true;
+    entry->resent_tick = proc_state.system_time;
+
+    LOG(LOG_LEVEL_INFO, "Retransmitting packet %u for P%u", seq, sender);
+    entry->data[offsetof(ipc_header, flags)] |= IPC_FLAG_RETRANSMIT;
+    transport_send(entry->data, entry->len);
+    COUNT(retransmitted, 1);
+  }
+  pthread_mutex_unlock(&send_lock);
+}
+
+static void send_nacks(void) {
+  uint32_t now = proc_state.system_time;
+
+  for (uint8_t i = 0; i < NUM_PROC; i++) {
+    ipc_peer_state *peer = &peers[i];
+    if (peer->window.missing == 0 ||
+        (!peer->nack_due &&
+         now - peer->last_nack_tick < IPC_NACK_RETRY_TICKS)) {
+      continue;
+    }
+
+    char packet[sizeof(ipc_header) + sizeof(nack_message)];
+    nack_message nack = ipc_window_nack(&peer->window, i);
+    write_header(packet, PACKET_TYPE_NACK, 0, 0);
+    memcpy(packet + sizeof(ipc_header), &nack, sizeof(nack));
+    transport_send(packet, sizeof(packet));
+
+    peer->nack_due = false;
+    peer->last_nack_tick = now;
+    COUNT(nacks_sent, 1);
+  }
+}
+
+static inline uint64_t missing_count(uint64_t bits) {
+  return (uint64_t)__builtin_popcountll(bits);
+}
+
+ipc_seq_result ipc_window_accept(ipc_seq_window *w, uint32_t seq,
+                                 uint64_t *lost, uint64_t *unrecovered) {
+  int32_t ahead = (int32_t)(seq - w->next_seq);
+
+  if (ahead >= 0) {
+    uint32_t advance = (uint32_t)ahead + 1;
+    if (advance >= IPC_HISTORY_SIZE) {
+      *unrecovered += missing_count(w->missing);
+      w->missing = 0;
+    } else {
+      *unrecovered +=
+          missing_count(w->missing >> (IPC_HISTORY_SIZE - advance));
+      w->missing <<= advance;
+    }
+
+    // Bits 1..ahead are the gap; the part beyond the window is lost for good.
+    if (ahead > 0) {
+      uint32_t marked = (uint32_t)ahead < IPC_HISTORY_SIZE
+                            ? (uint32_t)ahead
+                            : IPC_HISTORY_SIZE - 1;
+      w->missing |= (~0ULL >> (IPC_HISTORY_SIZE - 1 - marked)) & ~1ULL;
+      *lost += (uint64_t)ahead;
+      *unrecovered += (uint64_t)ahead - marked;
+    }
+
+    w->next_seq = seq + 1;
+    return IPC_SEQ_NEW;
+  }
+
+  uint32_t k = w->next_seq - 1 - seq;
+  if (k < IPC_HISTORY_SIZE && (w->missing & (1ULL << k))) {
+    w->missing &= ~(1ULL << k);
+    return IPC_SEQ_RECOVERED;
+  }
+
+  return IPC_SEQ_DUPLICATE;
+}
+
+nack_message ipc_window_nack(const ipc_seq_window *w, uint8_t target) {
+  return (nack_message){
+      .missing = w->missing,
+      .base_seq = w->next_seq - 1,
+      .target = target,
+  };
+}
+
+uint32_t ipc_nack_seqs(const nack_message *nack,
+                       uint32_t seqs[IPC_HISTORY_SIZE]) {
+  uint32_t count = 0;
+  for (uint32_t k = 0; k < IPC_HISTORY_SIZE; k++) {
+    if (nack->missing & (1ULL << k)) {
+      seqs[count++] = nack->base_seq - k;
+    }
+  }
+  return count;
+}
+
+// Returns false for a packet that was already delivered. Packets beyond a
+// gap are delivered straight away; the ones in the gap are requested and
+// delivered when they arrive.
+static bool accept_sequence(const ipc_header *hdr) {
+  ipc_peer_state *peer = &peers[hdr->sender];
+  uint64_t lost = 0;
+  uint64_t gone = 0;
+
+  switch (ipc_window_accept(&peer->window, hdr->seq, &lost, &gone)) {
+  case IPC_SEQ_NEW:
+    if (lost > 0) {
+      LOG(LOG_LEVEL_WARN, "Missed %llu packets from P%u before packet %u",
+          (unsigned long long)lost, hdr->sender, hdr->seq);
+      COUNT(lost, lost);
+      peer->nack_due = true;
+    }
+    COUNT(unrecovered, gone);
+    return true;
+  case IPC_SEQ_RECOVERED:
+    LOG(LOG_LEVEL_INFO, "Recovered packet %u from P%u", hdr->seq, hdr->sender);
+    COUNT(recovered, 1);
+    return true;
+  case IPC_SEQ_DUPLICATE:
+  default:
+    COUNT(duplicates, 1);
+    return false;
+  }
+}
+
+static void handle_criticality_change(const char *payload, uint8_t sender) {
+  criticality_change_message msg;
+  memcpy(&msg, payload, sizeof(criticality_change_message));
+
+  if (msg.new_level > atomic_load(&proc_state.system_criticality_level) &&
+      msg.new_level < MAX_CRITICALITY_LEVELS) {
+    LOG(LOG_LEVEL_WARN, "Received criticality change to level %d from P%u",
+        msg.new_level, sender);
+    atomic_store(&proc_state.system_criticality_level, msg.new_level);
+    if (replay_mode == REPLAY_RECORD) {
+      replay_record_criticality(msg.new_level);
+    }
+  }
+}
+
+static void handle_completions(const char *payload, size_t payload_len,
+                               uint8_t sender) {
+  size_t num_msgs = payload_len / sizeof(completion_message);
+
+  for (size_t i = 0; i < num_msgs; i++) {
+    completion_message msg;
+    memcpy(&msg, payload + (i * sizeof(completion_message)),
+           sizeof(completion_message));
+
+    LOG(LOG_LEVEL_DEBUG, "Received completion message for task ID %d from P%u",
+        msg.completed_task_id, sender);
+    ring_buffer_enqueue(&proc_state.incoming_completion_msg_queue, &msg);
+    if (replay_mode == REPLAY_RECORD) {
+      replay_record_completion(&msg);
+    }
+  }
+}
+
+static void handle_packet(const char *packet_buf, size_t len) {
+  ipc_header hdr;
+
+  if (len < sizeof(ipc_header)) {
+    LOG(LOG_LEVEL_WARN, "Received truncated packet of %u bytes",
+        (unsigned)len);
+    return;
+  }
+  memcpy(&hdr, packet_buf, sizeof(hdr));
+  if (hdr.version != IPC_WIRE_VERSION || hdr.sender >= NUM_PROC) {
+    LOG(LOG_LEVEL_WARN, "Received packet with version %u from sender %u",
+        hdr.version, hdr.sender);
+    return;
+  }
+  if (hdr.run != current_run) {
+    return;
+  }
+
+  COUNT(packets_received, 1);
+
+  const char *payload = packet_buf + sizeof(ipc_header);
+  size_t payload_len = len - sizeof(ipc_header);
+
+  if (hdr.type == PACKET_TYPE_NACK) {
+    if (payload_len == sizeof(nack_message)) {
+      nack_message nack;
+      memcpy(&nack, payload, sizeof(nack));
+      handle_nack(&nack, hdr.sender);
+    }
+    return;
+  }
+
+  if (!accept_sequence(&hdr)) {
+    return;
+  }
+
+  if (hdr.type == PACKET_TYPE_CRITICALITY_CHANGE &&
+      payload_len == sizeof(criticality_change_message)) {
+    handle_criticality_change(payload, hdr.sender);
+  } else if (hdr.type == PACKET_TYPE_COMPLETION) {
+    handle_completions(payload, payload_len, hdr.sender);
+  } else if (hdr.type == PACKET_TYPE_TICK &&
+             payload_len >= sizeof(criticality_change_message)) {
+    // Level 0 never raises the criticality, so it marks "no change".
+    handle_criticality_change(payload, hdr.sender);
+    handle_completions(payload + sizeof(criticality_change_message),
+                       payload_len - sizeof(criticality_change_message),
+                       hdr.sender);
+  } else {
+    LOG(LOG_LEVEL_WARN, "Received unknown packet type %d from P%u", hdr.type,
+        hdr.sender);
+  }
+}
+
+// Handles a packet unless an injected fault drops or delays it. A delayed
+// packet that does not fit is dropped.
+static void receive_packet(const char *packet_buf, size_t len) {
+  fault_ipc_action action = fault_ipc_now();
+
+  if (action == FAULT_IPC_HOLD && num_held < IPC_HELD_PACKETS) {
+    held[num_held].len = (uint16_t)len;
+    memcpy(held[num_held].data, packet_buf, len);
+    num_held++;
+  } else if (action != FAULT_IPC_DELIVER) {
+    action = FAULT_IPC_DROP;
+  } else {
+    handle_packet(packet_buf, len);
+    return;
+  }
+  fault_count_packet(action);
+}
+
+static void release_held_packets(void) {
+  if (num_held == 0 || fault_ipc_now() == FAULT_IPC_HOLD) {
+    return;
+  }
+  for (uint32_t i = 0; i < num_held; i++) {
+    handle_packet(held[i].data, held[i].len);
+  }
+  num_held = 0;
+}
+
+static size_t udp_receive(void) {
+  size_t num_packets = 0;
+  char packet_buf[IPC_MAX_PACKET_SIZE];
   ssize_t len;
-  struct sockaddr_in sender_addr;
-  socklen_t sender_len = sizeof(sender_addr);
 
   while (1) {
-    len = recvfrom(sockfd, packet_buf, sizeof(packet_buf), 0,
-                   (struct sockaddr *)&sender_addr, &sender_len);
+    len = recvfrom(sockfd, packet_buf, sizeof(packet_buf), 0, NULL, NULL);
+    COUNT(syscalls, 1);
 
     if (len < 0) {
       if (errno == EWOULDBLOCK || errno == EAGAIN) {
@@ -140,101 +741,239 @@ void ipc_receive_completion_messages(void) {
       perror("recvfrom() error");
       break;
     }
+    num_packets++;
+    receive_packet(packet_buf, (size_t)len);
+  }
 
-    packet_type pkt_type = (packet_type)packet_buf[0];
-    char *payload = packet_buf + 1;
-    size_t payload_len = (size_t)len - 1;
+  return num_packets;
+}
 
-    if (pkt_type == PACKET_TYPE_CRITICALITY_CHANGE &&
-        payload_len == sizeof(criticality_change_message)) {
-      criticality_change_message msg;
-      memcpy(&msg, payload, sizeof(criticality_change_message));
+#ifdef __linux__
+static size_t batch_receive(void) {
+  size_t num_packets = 0;
 
-      if (msg.new_level > atomic_load(&proc_state.system_criticality_level) &&
-          msg.new_level < MAX_CRITICALITY_LEVELS) {
-        LOG(LOG_LEVEL_WARN,
-            "Received criticality change to level %d from %s:%d", msg.new_level,
-            inet_ntoa(sender_addr.sin_addr), ntohs(sender_addr.sin_port));
-        atomic_store(&proc_state.system_criticality_level, msg.new_level);
-      }
-    } else if (pkt_type == PACKET_TYPE_COMPLETION) {
-      size_t num_msgs = payload_len / sizeof(completion_message);
-
-      for (size_t i = 0; i < num_msgs; i++) {
-        completion_message msg;
-        memcpy(&msg, payload + (i * sizeof(completion_message)),
-               sizeof(completion_message));
-
-        LOG(LOG_LEVEL_DEBUG,
-            "Received completion message for task ID %d from %s:%d",
-            msg.completed_task_id, inet_ntoa(sender_addr.sin_addr),
-            ntohs(sender_addr.sin_port));
-        ring_buffer_enqueue(&proc_state.incoming_completion_msg_queue, &msg);
+  while (1) {
+    int n = recvmmsg(sockfd, batch.rx_msgs, IPC_BATCH_PACKETS, MSG_DONTWAIT,
+                     NULL);
+    COUNT(syscalls, 1);
+
+    if (n < 0) {
+      if (errno != EWOULDBLOCK && errno != EAGAIN) {
+        perror("recvmmsg() error");
       }
-    } else {
-      LOG(LOG_LEVEL_WARN, "Received unknown packet type %d from %s:%d",
-          pkt_type, inet_ntoa(sender_addr.sin_addr),
-          ntohs(sender_addr.sin_port));
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      num_packets++;
+      receive_packet(batch.rx_buf[i], batch.rx_msgs[i].msg_len);
+    }
+
+    if (n < IPC_BATCH_PACKETS) {
+      break;
+    }
+  }
+
+  return num_packets;
+}
+#endif
+
+// Delivers what the recording received at this tick, in the same order.
+static size_t replay_receive(void) {
+  size_t num_deliveries = 0;
+  replay_record rec;
+
+  while (replay_delivery(proc_state.system_time, &rec)) {
+    num_deliveries++;
+    if (rec.type == REPLAY_RECORD_CRITICALITY) {
+      atomic_store(&proc_state.system_criticality_level, rec.level);
       continue;
     }
+
+    completion_message msg = {
+        .completed_task_id = rec.a,
+        .job_arrival_time = rec.b,
+        .system_time = rec.tick - rec.lag,
+    };
+    ring_buffer_enqueue(&proc_state.incoming_completion_msg_queue, &msg);
+  }
+
+  return num_deliveries;
+}
+
+static size_t shm_receive(void) {
+  ipc_shm_inbox *inbox = &ipc_shm->inbox[proc_state.processor_id];
+  size_t num_packets = 0;
+  ipc_shm_slot slot;
+
+  while (ring_buffer_try_dequeue(&inbox->ring, &slot) == 0) {
+    num_packets++;
+    receive_packet(slot.data, slot.len);
+  }
+
+  return num_packets;
+}
+
+size_t ipc_receive_completion_messages(void) {
+  LOG(LOG_LEVEL_DEBUG, "Checking for incoming completion messages...");
+
+  size_t num_packets;
+  if (ipc_transport != IPC_TRANSPORT_REPLAY) {
+    release_held_packets();
   }
+  switch (ipc_transport) {
+  case IPC_TRANSPORT_SHM:
+    num_packets = shm_receive();
+    break;
+  case IPC_TRANSPORT_REPLAY:
+    return replay_receive();
+#ifdef __linux__
+  case IPC_TRANSPORT_UDP_BATCH:
+    num_packets = batch_receive();
+    break;
+#endif
+  default:
+    num_packets = udp_receive();
+    break;
+  }
+
+  send_nacks();
+
+  return num_packets;
 }
 
 void ipc_broadcast_criticality_change(criticality_level new_level) {
   LOG(LOG_LEVEL_WARN, "Broadcasting criticality change to level %d", new_level);
-  char packet[1 + sizeof(criticality_change_message)];
-  packet[0] = PACKET_TYPE_CRITICALITY_CHANGE;
+
+  if (ipc_transport == IPC_TRANSPORT_UDP_BATCH) {
+    int pending = atomic_load(&pending_criticality);
+    while ((int)new_level > pending &&
+           !atomic_compare_exchange_weak(&pending_criticality, &pending,
+                                         (int)new_level))
+      ;
+    return;
+  }
+
   criticality_change_message msg = {
       .new_level = new_level,
   };
-  memcpy(packet + 1, &msg, sizeof(criticality_change_message));
-  sendto(sockfd, packet, sizeof(packet), 0, (struct sockaddr *)&mcast_addr,
-         sizeof(mcast_addr));
+  send_sequenced(PACKET_TYPE_CRITICALITY_CHANGE, &msg, sizeof(msg), NULL, 0);
 }
 
-void ipc_send_completion_messages(void) {
-  char packet_buf[1 + (MESSAGE_QUEUE_SIZE * sizeof(completion_message))];
-
+size_t ipc_send_completion_messages(void) {
+  completion_message msgs[MESSAGE_QUEUE_SIZE];
   size_t num_msgs = 0;
 
-  packet_buf[0] = PACKET_TYPE_COMPLETION;
+  while (num_msgs < MESSAGE_QUEUE_SIZE &&
+         ring_buffer_try_dequeue(&proc_state.outgoing_completion_msg_queue,
+                                 &msgs[num_msgs]) == 0) {
+    LOG(LOG_LEVEL_DEBUG, "Queued completion message for task ID %d for sending",
+        msgs[num_msgs].completed_task_id);
+    num_msgs++;
+  }
 
-  while (num_msgs < MESSAGE_QUEUE_SIZE) {
-    completion_message msg;
-    if (ring_buffer_try_dequeue(&proc_state.outgoing_completion_msg_queue,
-                                &msg) == 0) {
-      memcpy(packet_buf + 1 + (num_msgs * sizeof(completion_message)), &msg,
-             sizeof(completion_message));
-      LOG(LOG_LEVEL_DEBUG,
-          "Queued completion message for task ID %d for sending",
-          msg.completed_task_id);
-      num_msgs++;
-    } else {
-      break;
+  // The batched transport sends this tick's completions and any pending
+  // criticality change as one packet.
+  if (ipc_transport == IPC_TRANSPORT_UDP_BATCH) {
+    int level = atomic_exchange(&pending_criticality, 0);
+    if (num_msgs > 0 || level > 0) {
+      criticality_change_message msg = {
+          .new_level = (criticality_level)level,
+      };
+      send_sequenced(PACKET_TYPE_TICK, &msg, sizeof(msg), msgs,
+                     num_msgs * sizeof(completion_message));
     }
+  } else if (num_msgs > 0) {
+    send_sequenced(PACKET_TYPE_COMPLETION, msgs,
+                   num_msgs * sizeof(completion_message), NULL, 0);
   }
 
-  if (num_msgs > 0) {
-    size_t len = 1 + (num_msgs * sizeof(completion_message));
+  return num_msgs;
+}
 
-    ssize_t sent_len =
-        sendto(sockfd, packet_buf, len, 0, (struct sockaddr *)&mcast_addr,
-               sizeof(mcast_addr));
+void ipc_reset(uint32_t run) {
+  current_run = run;
+
+  // Anything handled now belongs to the previous run and is dropped by run
+  // number; later stragglers are dropped the same way.
+  switch (ipc_transport) {
+  case IPC_TRANSPORT_SHM:
+    shm_receive();
+    break;
+  case IPC_TRANSPORT_REPLAY:
+    break;
+#ifdef __linux__
+  case IPC_TRANSPORT_UDP_BATCH:
+    batch_receive();
+    break;
+#endif
+  default:
+    udp_receive();
+    break;
+  }
 
-    if (sent_len < 0) {
-      perror("sendto() failed");
-    } else if ((size_t)sent_len != len) {
-      fprintf(stderr, "Warning: sendto() sent partial packet!\n");
-    }
+  pthread_mutex_lock(&send_lock);
+  next_send_seq = 0;
+  for (uint32_t i = 0; i < IPC_HISTORY_SIZE; i++) {
+    history[i].valid = false;
   }
+  pthread_mutex_unlock(&send_lock);
+
+  memset(peers, 0, sizeof(peers));
+  num_held = 0;
+  atomic_store(&pending_criticality, 0);
+
+  ring_buffer_clear(&proc_state.incoming_completion_msg_queue);
+  ring_buffer_clear(&proc_state.outgoing_completion_msg_queue);
+}
+
+void ipc_read_counters(ipc_counters *out) {
+  out->packets_sent = atomic_load(&counters.packets_sent);
+  out->packets_received = atomic_load(&counters.packets_received);
+  out->syscalls = atomic_load(&counters.syscalls);
+  out->lost = atomic_load(&counters.lost);
+  out->recovered = atomic_load(&counters.recovered);
+  out->unrecovered = atomic_load(&counters.unrecovered);
+  out->duplicates = atomic_load(&counters.duplicates);
+  out->nacks_sent = atomic_load(&counters.nacks_sent);
+  out->retransmitted = atomic_load(&counters.retransmitted);
+  out->expired = atomic_load(&counters.expired);
 }
 
 void ipc_cleanup(void) {
+  static const char *names[] = {"shm", "udp", "batch", "replay"};
+  ipc_counters c;
+
+  ipc_read_counters(&c);
+  LOG(LOG_LEVEL_INFO,
+      "IPC transport %s: %llu packets sent, %llu received, %llu syscalls",
+      names[ipc_transport], (unsigned long long)c.packets_sent,
+      (unsigned long long)c.packets_received, (unsigned long long)c.syscalls);
+  LOG(LOG_LEVEL_INFO,
+      "IPC loss: %llu lost, %llu recovered, %llu unrecovered, %llu "
+      "duplicates",
+      (unsigned long long)c.lost, (unsigned long long)c.recovered,
+      (unsigned long long)c.unrecovered, (unsigned long long)c.duplicates);
+  LOG(LOG_LEVEL_INFO, "IPC NACKs: %llu sent, %llu retransmitted, %llu expired",
+      (unsigned long long)c.nacks_sent, (unsigned long long)c.retransmitted,
+      (unsigned long long)c.expired);
+
+  if (ipc_transport == IPC_TRANSPORT_SHM && ipc_shm != NULL) {
+    uint64_t dropped =
+        atomic_load(&ipc_shm->inbox[proc_state.processor_id].dropped);
+    if (dropped > 0) {
+      LOG(LOG_LEVEL_WARN, "Dropped %llu packets addressed to this processor",
+          (unsigned long long)dropped);
+    }
+  }
+
   if (sockfd >= 0) {
-    struct ip_mreq mreq;
-    mreq.imr_multiaddr.s_addr = inet_addr(MCAST_GROUP);
-    mreq.imr_interface.s_addr = inet_addr("127.0.0.1");
-    setsockopt(sockfd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+    if (ipc_peers == NULL) {
+      struct ip_mreq mreq;
+      mreq.imr_multiaddr.s_addr = inet_addr(MCAST_GROUP);
+      mreq.imr_interface.s_addr = inet_addr("127.0.0.1");
+      setsockopt(sockfd, IPPROTO_IP, IP_DROP_MEMBERSHIP, &mreq, sizeof(mreq));
+    }
 
     close(sockfd);
     sockfd = -1;
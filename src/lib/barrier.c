@@ -1,11 +1,112 @@
 #include "lib/barrier.h"
 
 #include <errno.h>
+#include <limits.h>
+#include <sched.h>
 
-int barrier_init(barrier *barrier, unsigned n, int pshared) {
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define BARRIER_SPIN_MIN 64
+#define BARRIER_SPIN_MAX (1u << 16)
+#define BARRIER_SPIN_INIT 4096
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+static void generation_wait(barrier *barrier, uint32_t gen) {
+#ifdef __linux__
+  int op = (barrier->flags & BARRIER_PROCESS_SHARED) ? FUTEX_WAIT
+                                                      : FUTEX_WAIT_PRIVATE;
+  syscall(SYS_futex, &barrier->generation, op, gen, NULL, NULL, 0);
+#else
+  (void)barrier;
+  (void)gen;
+  sched_yield();
+#endif
+}
+
+static void generation_wake(barrier *barrier) {
+#ifdef __linux__
+  int op = (barrier->flags & BARRIER_PROCESS_SHARED) ? FUTEX_WAKE
+                                                      : FUTEX_WAKE_PRIVATE;
+  syscall(SYS_futex, &barrier->generation, op, INT_MAX, NULL, NULL, 0);
+#else
+  (void)barrier;
+#endif
+}
+
+static int spin_barrier_wait(barrier *barrier) {
+  uint32_t gen = atomic_load_explicit(&barrier->generation,
+                                      memory_order_acquire);
+
+  uint32_t arrived =
+      atomic_fetch_add_explicit(&barrier->arrived, 1, memory_order_acq_rel) + 1;
+
+  if (arrived == barrier->target) {
+    atomic_store_explicit(&barrier->arrived, 0, memory_order_relaxed);
+    atomic_store(&barrier->generation, gen + 1);
+    if (atomic_load(&barrier->sleepers) > 0) {
+      generation_wake(barrier);
+    }
+    return BARRIER_SERIAL_THREAD;
+  }
+
+  // Grow the spin budget when the barrier opens while spinning and shrink it
+  // when waiters end up sleeping, so oversubscribed runs stop burning CPU.
+  uint32_t limit =
+      atomic_load_explicit(&barrier->spin_limit, memory_order_relaxed);
+  for (uint32_t i = 0; i < limit; i++) {
+    if (atomic_load_explicit(&barrier->generation, memory_order_acquire) !=
+        gen) {
+      if (limit < BARRIER_SPIN_MAX) {
+        atomic_store_explicit(&barrier->spin_limit, limit * 2,
+                              memory_order_relaxed);
+      }
+      return 0;
+    }
+    cpu_relax();
+  }
+
+  if (limit > BARRIER_SPIN_MIN) {
+    atomic_store_explicit(&barrier->spin_limit, limit / 2,
+                          memory_order_relaxed);
+  }
+
+  atomic_fetch_add(&barrier->sleepers, 1);
+  while (atomic_load(&barrier->generation) == gen) {
+    generation_wait(barrier, gen);
+  }
+  atomic_fetch_sub(&barrier->sleepers, 1);
+
+  return 0;
+}
+
+int barrier_init(barrier *barrier, unsigned n, int flags) {
   if (n == 0)
     return EINVAL;
 
+  barrier->target = n;
+  barrier->count = 0;
+  barrier->cycle = 0;
+  barrier->flags = flags;
+
+  if (flags & BARRIER_SPIN) {
+    atomic_init(&barrier->arrived, 0);
+    atomic_init(&barrier->generation, 0);
+    atomic_init(&barrier->sleepers, 0);
+    atomic_init(&barrier->spin_limit, BARRIER_SPIN_INIT);
+    return 0;
+  }
+
   pthread_mutexattr_t mut_attr;
   pthread_condattr_t cond_attr;
   int ret = 0;
@@ -13,7 +114,7 @@ int barrier_init(barrier *barrier, unsigned n, int pshared) {
   pthread_mutexattr_init(&mut_attr);
   pthread_condattr_init(&cond_attr);
 
-  if (pshared) {
+  if (flags & BARRIER_PROCESS_SHARED) {
     if ((ret = pthread_mutexattr_setpshared(&mut_attr, PTHREAD_PROCESS_SHARED)))
       goto fail;
     if ((ret = pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED)))
@@ -27,10 +128,6 @@ int barrier_init(barrier *barrier, unsigned n, int pshared) {
     goto fail;
   }
 
-  barrier->target = n;
-  barrier->count = 0;
-  barrier->cycle = 0;
-
   ret = 0;
   goto cleanup;
 
@@ -43,6 +140,10 @@ cleanup:
 }
 
 int barrier_destroy(barrier *barrier) {
+  if (barrier->flags & BARRIER_SPIN) {
+    return atomic_load(&barrier->arrived) != 0 ? EBUSY : 0;
+  }
+
   pthread_mutex_lock(&barrier->mut);
   if (barrier->count != 0) {
     pthread_mutex_unlock(&barrier->mut);
@@ -57,6 +158,10 @@ int barrier_destroy(barrier *barrier) {
 }
 
 int barrier_wait(barrier *barrier) {
+  if (barrier->flags & BARRIER_SPIN) {
+    return spin_barrier_wait(barrier);
+  }
+
   pthread_mutex_lock(&barrier->mut);
 
   unsigned cur_cycle = barrier->cycle;
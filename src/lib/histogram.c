@@ -0,0 +1,85 @@
+#include "lib/histogram.h"
+
+#include <string.h>
+
+void histogram_init(histogram *h) {
+  memset(h, 0, sizeof(*h));
+  h->min = UINT64_MAX;
+}
+
+uint32_t histogram_bucket(uint64_t value) {
+  if (value < 2 * HISTOGRAM_SUB_BUCKETS) {
+    return (uint32_t)value;
+  }
+
+  uint32_t msb = 63 - (uint32_t)__builtin_clzll(value);
+  if (msb >= HISTOGRAM_MAX_BITS) {
+    return HISTOGRAM_BUCKETS - 1;
+  }
+
+  uint32_t shift = msb - HISTOGRAM_SUB_BUCKET_BITS;
+  uint32_t sub = (uint32_t)(value >> shift) - HISTOGRAM_SUB_BUCKETS;
+  return 2 * HISTOGRAM_SUB_BUCKETS +
+         (msb - HISTOGRAM_SUB_BUCKET_BITS - 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+uint64_t histogram_bucket_value(uint32_t bucket) {
+  if (bucket < 2 * HISTOGRAM_SUB_BUCKETS) {
+    return bucket;
+  }
+
+  uint32_t rest = bucket - 2 * HISTOGRAM_SUB_BUCKETS;
+  uint32_t shift = rest / HISTOGRAM_SUB_BUCKETS + 1;
+  uint64_t sub = rest % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS;
+  return sub << shift;
+}
+
+void histogram_record(histogram *h, uint64_t value) {
+  h->counts[histogram_bucket(value)]++;
+  h->total++;
+  h->sum += value;
+  if (value < h->min) {
+    h->min = value;
+  }
+  if (value > h->max) {
+    h->max = value;
+  }
+}
+
+void histogram_merge(histogram *dst, const histogram *src) {
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    dst->counts[i] += src->counts[i];
+  }
+  dst->total += src->total;
+  dst->sum += src->sum;
+  if (src->min < dst->min) {
+    dst->min = src->min;
+  }
+  if (src->max > dst->max) {
+    dst->max = src->max;
+  }
+}
+
+uint64_t histogram_percentile(const histogram *h, double percentile) {
+  if (h->total == 0) {
+    return 0;
+  }
+
+  uint64_t rank = (uint64_t)(percentile / 100.0 * (double)h->total + 0.5);
+  if (rank == 0) {
+    rank = 1;
+  }
+  if (rank >= h->total) {
+    return h->max;
+  }
+
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t value = histogram_bucket_value(i);
+      return value < h->min ? h->min : (value > h->max ? h->max : value);
+    }
+  }
+  return h->max;
+}
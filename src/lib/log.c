@@ -5,44 +5,709 @@
 #include "lib/ring_buffer.h"
 
 #include <pthread.h>
+#include <sched.h>
 #include <stdarg.h>
 #include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
-ring_buffer log_queue;
-
 static FILE *log_file = NULL;
 static pthread_t logger_thread;
 static _Atomic int log_shutdown_requested = 0;
+static _Atomic bool logger_running = false;
 
-platform_sem_t log_sem;
+static platform_sem_t log_sem;
 
-#define LOG_QUEUE_SIZE 512
+static _Atomic int log_wakeup_pending;
 
-static char log_buffer[LOG_QUEUE_SIZE][MAX_LOG_MSG_SIZE];
-static _Atomic uint64_t log_seq[LOG_QUEUE_SIZE];
+log_level __attribute__((weak)) current_log_level = LOG_LEVEL_INFO;
 
-_Atomic int log_wakeup_pending;
+log_overflow_policy log_overflow = LOG_OVERFLOW_DROP;
 
-log_level __attribute__((weak)) current_log_level = LOG_LEVEL_INFO;
+static const char *const level_names[] = {"DEBUG", "INFO", "WARN", "ERROR",
+                                          "FATAL"};
+
+#define LOG_RING_SIZE 4096
+#define LOG_MAX_THREADS (NUM_CORES_PER_PROC + 4)
+#define LOG_MAX_EXT (MAX_LOG_MSG_SIZE / sizeof(log_record))
+#define LOG_NUM_LEVELS (LOG_LEVEL_FATAL + 1)
+
+#define LOG_SPILL_CHUNK 256
+
+#define LOG_FLAG_LEVEL_MASK 0x7
+#define LOG_FLAG_CTX_SET 0x8
+#define LOG_FLAG_TEXT 0x10
+
+// A log entry is a header record followed by num_ext continuation records
+// holding its text, or in trace mode its string arguments.
+typedef struct {
+  const void *site;
+  uint64_t timestamp;
+  uint32_t tick;
+  uint8_t proc_id;
+  uint8_t core_id;
+  uint8_t flags;
+  uint8_t num_ext;
+  uint64_t args[5];
+} log_record;
+
+_Static_assert(sizeof(log_record) == 64, "log records span a cache line");
+
+typedef struct log_spill_chunk {
+  struct log_spill_chunk *next;
+  uint32_t count;
+  log_record records[LOG_SPILL_CHUNK];
+} log_spill_chunk;
+
+typedef struct {
+  _Atomic uint64_t written;
+  _Atomic uint64_t dropped[LOG_NUM_LEVELS];
+  _Atomic uint64_t retried;
+  _Atomic uint64_t blocked;
+  _Atomic uint64_t spilled;
+} log_counters;
+
+// The ring is written only by its owning thread and drained only by the
+// logger thread. Entries that do not fit under LOG_OVERFLOW_SPILL go to a
+// mutex-protected list of chunks, which the logger merges like a ring.
+typedef struct {
+  _Atomic uint64_t head __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+  _Atomic uint64_t tail __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+  log_counters counters;
+  uint64_t reported_drops;
+  log_thread_context owner;
+
+  pthread_mutex_t spill_lock;
+  log_spill_chunk *spill_head;
+  log_spill_chunk *spill_tail;
+  uint32_t spill_read;
+  _Atomic uint64_t spill_pending;
+
+  log_record records[LOG_RING_SIZE];
+} log_ring;
+
+static log_ring log_rings[LOG_MAX_THREADS];
+static _Atomic uint32_t num_log_rings;
+static __thread log_ring *thread_log_ring;
+
+// Entries from threads that found every ring taken.
+static log_counters unowned_counters;
+static uint64_t reported_unowned_drops;
+
+// Where an entry is being written: a ring slot or the end of a spill chunk.
+typedef struct {
+  log_ring *ring;
+  log_record *records;
+  uint32_t size;
+  uint64_t pos;
+  uint8_t num_ext;
+  bool spilled;
+} log_entry;
+
+static inline uint64_t log_timestamp(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// The semaphore only exists while the logger runs; entries written before
+// or after that are drained by log_system_shutdown.
+static inline void wake_logger(void) {
+  if (!atomic_load_explicit(&logger_running, memory_order_acquire)) {
+    return;
+  }
+  if (atomic_exchange(&log_wakeup_pending, 1) == 0) {
+    platform_sem_post(&log_sem);
+  }
+}
+
+static uint64_t total_drops(const log_counters *c) {
+  uint64_t dropped = 0;
+  for (int i = 0; i < LOG_NUM_LEVELS; i++) {
+    dropped += atomic_load_explicit(&c->dropped[i], memory_order_relaxed);
+  }
+  return dropped;
+}
+
+static log_ring *get_thread_log_ring(void) {
+  if (thread_log_ring == NULL) {
+    uint32_t id = atomic_fetch_add(&num_log_rings, 1);
+    if (id >= LOG_MAX_THREADS) {
+      return NULL;
+    }
+    thread_log_ring = &log_rings[id];
+    thread_log_ring->owner = log_thread_ctx;
+    pthread_mutex_init(&thread_log_ring->spill_lock, NULL);
+  }
+  return thread_log_ring;
+}
+
+// Copies `len` bytes to or from the continuation records following `pos`,
+// wrapping around `size` records.
+static void copy_ext(log_record *records, uint32_t size, uint64_t pos,
+                     size_t offset, void *buf, size_t len, bool write) {
+  char *bytes = buf;
+  while (len > 0) {
+    uint64_t slot = pos + 1 + offset / sizeof(log_record);
+    size_t in_slot = offset % sizeof(log_record);
+    size_t n = sizeof(log_record) - in_slot;
+    if (n > len) {
+      n = len;
+    }
+
+    char *rec = (char *)&records[slot % size] + in_slot;
+    if (write) {
+      memcpy(rec, bytes, n);
+    } else {
+      memcpy(bytes, rec, n);
+    }
+
+    bytes += n;
+    offset += n;
+    len -= n;
+  }
+}
+
+static inline void log_entry_copy(const log_entry *e, size_t offset,
+                                  const void *buf, size_t len) {
+  copy_ext(e->records, e->size, e->pos, offset, (void *)buf, len, true);
+}
+
+static inline bool ring_has_room(log_ring *ring, uint8_t num_ext) {
+  uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  return tail + 1 + num_ext - head <= LOG_RING_SIZE;
+}
+
+// Makes room for the entry at the end of the spill list, returning with the
+// spill lock held.
+static bool spill_reserve(log_ring *ring, log_entry *e) {
+  pthread_mutex_lock(&ring->spill_lock);
+
+  log_spill_chunk *chunk = ring->spill_tail;
+  if (chunk == NULL || chunk->count + 1 + e->num_ext > LOG_SPILL_CHUNK) {
+    log_spill_chunk *fresh = malloc(sizeof(log_spill_chunk));
+    if (fresh == NULL) {
+      pthread_mutex_unlock(&ring->spill_lock);
+      return false;
+    }
+    fresh->next = NULL;
+    fresh->count = 0;
+    if (chunk) {
+      chunk->next = fresh;
+    } else {
+      ring->spill_head = fresh;
+      ring->spill_read = 0;
+    }
+    ring->spill_tail = fresh;
+    chunk = fresh;
+  }
+
+  e->records = chunk->records;
+  e->size = LOG_SPILL_CHUNK;
+  e->pos = chunk->count;
+  e->spilled = true;
+  return true;
+}
+
+// Applies the overflow policy when the ring is full. Returns false if the
+// entry has to be dropped.
+static bool handle_overflow(log_ring *ring, log_entry *e) {
+  switch (log_overflow) {
+  case LOG_OVERFLOW_RETRY:
+    for (int i = 0; i < LOG_RETRY_LIMIT; i++) {
+      atomic_fetch_add_explicit(&ring->counters.retried, 1,
+                                memory_order_relaxed);
+      wake_logger();
+      sched_yield();
+      if (ring_has_room(ring, e->num_ext)) {
+        return true;
+      }
+    }
+    return false;
+  case LOG_OVERFLOW_BLOCK:
+    atomic_fetch_add_explicit(&ring->counters.blocked, 1,
+                              memory_order_relaxed);
+    while (!ring_has_room(ring, e->num_ext)) {
+      if (atomic_load(&log_shutdown_requested) ||
+          !atomic_load(&logger_running)) {
+        return false;
+      }
+      atomic_store(&log_wakeup_pending, 1);
+      platform_sem_post(&log_sem);
+      sched_yield();
+    }
+    return true;
+  case LOG_OVERFLOW_SPILL:
+    if (spill_reserve(ring, e)) {
+      atomic_fetch_add_explicit(&ring->counters.spilled, 1,
+                                memory_order_relaxed);
+      return true;
+    }
+    return false;
+  case LOG_OVERFLOW_DROP:
+  default:
+    return false;
+  }
+}
+
+// Claims a header and `num_ext` continuation records for the calling thread,
+// filling in the header. Returns NULL and counts a drop if the overflow
+// policy gives up on the entry.
+static log_record *log_entry_begin(log_level level, uint8_t num_ext,
+                                   log_entry *e) {
+  log_ring *ring = get_thread_log_ring();
+  if (ring == NULL) {
+    atomic_fetch_add_explicit(&unowned_counters.dropped[level],
+                              1, memory_order_relaxed);
+    return NULL;
+  }
+
+  e->ring = ring;
+  e->num_ext = num_ext;
+  e->spilled = false;
+
+  if (!ring_has_room(ring, num_ext) && !handle_overflow(ring, e)) {
+    atomic_fetch_add_explicit(&ring->counters.dropped[level], 1,
+                              memory_order_relaxed);
+    return NULL;
+  }
+
+  if (!e->spilled) {
+    e->records = ring->records;
+    e->size = LOG_RING_SIZE;
+    e->pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  }
+
+  log_record *rec = &e->records[e->pos % e->size];
+  rec->timestamp = log_timestamp();
+  rec->tick = proc_state.system_time;
+  rec->proc_id = log_thread_ctx.proc_id;
+  rec->core_id = log_thread_ctx.core_id;
+  rec->flags = (uint8_t)((level & LOG_FLAG_LEVEL_MASK) |
+                         (log_thread_ctx.is_set ? LOG_FLAG_CTX_SET : 0));
+  rec->num_ext = num_ext;
+  return rec;
+}
+
+static void log_entry_commit(log_entry *e) {
+  log_ring *ring = e->ring;
+
+  if (e->spilled) {
+    ring->spill_tail->count += 1 + e->num_ext;
+    atomic_fetch_add_explicit(&ring->spill_pending, 1, memory_order_release);
+    pthread_mutex_unlock(&ring->spill_lock);
+  } else {
+    atomic_store_explicit(&ring->tail, e->pos + 1 + e->num_ext,
+                          memory_order_release);
+  }
+  atomic_fetch_add_explicit(&ring->counters.written, 1, memory_order_relaxed);
+
+  wake_logger();
+}
+
+void log_text(log_level level, const char *msg, int len) {
+  if (len < 0) {
+    return;
+  }
+  size_t n = (size_t)len < MAX_LOG_MSG_SIZE ? (size_t)len
+                                            : MAX_LOG_MSG_SIZE - 1;
+  uint8_t num_ext =
+      (uint8_t)((n + sizeof(log_record) - 1) / sizeof(log_record));
+
+  log_entry e;
+  log_record *rec = log_entry_begin(level, num_ext, &e);
+  if (rec == NULL) {
+    return;
+  }
+
+  rec->site = NULL;
+  rec->flags |= LOG_FLAG_TEXT;
+  rec->args[0] = n;
+  log_entry_copy(&e, 0, msg, n);
+
+  log_entry_commit(&e);
+}
+
+#ifdef ENABLE_BINARY_TRACE
+
+_Static_assert(LOG_TRACE_MAX_ARGS <= 5, "trace arguments fit in a record");
+
+void log_trace(log_level level, const log_site *site,
+               const log_trace_arg *args, uint8_t nargs) {
+  size_t str_bytes = 0;
+  for (uint8_t i = 0; i < nargs; i++) {
+    if (args[i].is_str) {
+      str_bytes += strlen(args[i].s) + 1;
+    }
+  }
+  if (str_bytes > LOG_MAX_EXT * sizeof(log_record)) {
+    str_bytes = LOG_MAX_EXT * sizeof(log_record);
+  }
+  uint8_t num_ext =
+      (uint8_t)((str_bytes + sizeof(log_record) - 1) / sizeof(log_record));
+
+  log_entry e;
+  log_record *rec = log_entry_begin(level, num_ext, &e);
+  if (rec == NULL) {
+    return;
+  }
+  rec->site = site;
+
+  // String arguments hold their offset into the continuation records.
+  size_t offset = 0;
+  for (uint8_t i = 0; i < nargs; i++) {
+    if (!args[i].is_str) {
+      rec->args[i] = args[i].u;
+      continue;
+    }
+
+    size_t room = str_bytes - offset;
+    size_t len = strlen(args[i].s) + 1;
+    if (room == 0) {
+      rec->args[i] = UINT64_MAX;
+      continue;
+    }
+    if (len > room) {
+      len = room;
+    }
+    rec->args[i] = offset;
+    log_entry_copy(&e, offset, args[i].s, len);
+    offset += len;
+    if (offset == str_bytes) {
+      log_entry_copy(&e, offset - 1, "", 1);
+    }
+  }
+
+  log_entry_commit(&e);
+}
+
+// Formats one argument with the conversion spec `spec`, using the length
+// modifier to pick the type the value was promoted from.
+static int format_trace_arg(char *out, size_t size, const char *spec,
+                            char conv, const char *length, uint64_t raw,
+                            const char *str) {
+  switch (conv) {
+  case 's':
+    return snprintf(out, size, spec, str ? str : "(null)");
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A': {
+    double d;
+    memcpy(&d, &raw, sizeof(d));
+    return snprintf(out, size, spec, d);
+  }
+  case 'd':
+  case 'i':
+    if (strcmp(length, "ll") == 0 || length[0] == 'j')
+      return snprintf(out, size, spec, (long long)raw);
+    if (length[0] == 'l')
+      return snprintf(out, size, spec, (long)raw);
+    if (length[0] == 'z')
+      return snprintf(out, size, spec, (size_t)raw);
+    return snprintf(out, size, spec, (int)raw);
+  default:
+    if (strcmp(length, "ll") == 0 || length[0] == 'j')
+      return snprintf(out, size, spec, (unsigned long long)raw);
+    if (length[0] == 'l')
+      return snprintf(out, size, spec, (unsigned long)raw);
+    if (length[0] == 'z')
+      return snprintf(out, size, spec, (size_t)raw);
+    return snprintf(out, size, spec, (unsigned)raw);
+  }
+}
+
+static size_t format_trace_record(const log_record *rec, const char *strs,
+                                  size_t strs_len, char *out, size_t size) {
+  const log_site *site = rec->site;
+  const char *file = strrchr(site->file, '/');
+  file = file ? file + 1 : site->file;
+  uint8_t level = rec->flags & LOG_FLAG_LEVEL_MASK;
+  const char *level_str = level <= LOG_LEVEL_FATAL ? level_names[level]
+                                                   : "UNKNOWN";
+
+  int n;
+  if (rec->flags & LOG_FLAG_CTX_SET) {
+    n = snprintf(out, size, "[%u] [P%u: C%u] [%s] [%s:%d] ", rec->tick,
+                 rec->proc_id, rec->core_id, level_str, file, site->line);
+  } else {
+    n = snprintf(out, size, "[%u] [SYS] [%s] [%s:%d] ", rec->tick, level_str,
+                 file, site->line);
+  }
+  size_t len = n < 0 ? 0 : (size_t)n;
+
+  uint8_t arg = 0;
+  for (const char *p = site->fmt; *p && len + 1 < size; p++) {
+    if (*p != '%') {
+      out[len++] = *p;
+      continue;
+    }
+    if (p[1] == '%') {
+      out[len++] = '%';
+      p++;
+      continue;
+    }
+
+    char spec[32];
+    size_t spec_len = 0;
+    const char *q = p;
+    while (*q && !strchr("diouxXcsfFeEgGaAp", *q) &&
+           spec_len < sizeof(spec) - 2) {
+      spec[spec_len++] = *q++;
+    }
+    if (!*q) {
+      break;
+    }
+    spec[spec_len++] = *q;
+    spec[spec_len] = '\0';
+
+    char length[3];
+    size_t ls = spec_len - 1;
+    while (ls > 0 && strchr("hljzt", spec[ls - 1])) {
+      ls--;
+    }
+    size_t length_len = spec_len - 1 - ls;
+    if (length_len > sizeof(length) - 1) {
+      length_len = sizeof(length) - 1;
+    }
+    memcpy(length, spec + ls, length_len);
+    length[length_len] = '\0';
+
+    uint64_t raw = arg < LOG_TRACE_MAX_ARGS ? rec->args[arg] : 0;
+    const char *str = (*q == 's' && raw < strs_len) ? strs + raw : NULL;
+    arg++;
+
+    n = format_trace_arg(out + len, size - len, spec, *q, length, raw, str);
+    if (n > 0) {
+      len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+    }
+    p = q;
+  }
+
+  if (len + 1 < size) {
+    out[len++] = '\n';
+  }
+  out[len] = '\0';
+  return len;
+}
+
+#endif
+
+static void write_drop_notice(uint64_t dropped, const log_thread_context *ctx) {
+  if (!log_file) {
+    return;
+  }
+  if (ctx && ctx->is_set) {
+    fprintf(log_file,
+            "[%u] [P%u: C%u] [WARN] [log.c:%d] Dropped %llu log records\n",
+            proc_state.system_time, ctx->proc_id, ctx->core_id, __LINE__,
+            (unsigned long long)dropped);
+  } else {
+    fprintf(log_file, "[%u] [SYS] [WARN] [log.c:%d] Dropped %llu log records\n",
+            proc_state.system_time, __LINE__, (unsigned long long)dropped);
+  }
+}
+
+static void report_drops(uint32_t rings) {
+  for (uint32_t i = 0; i < rings; i++) {
+    log_ring *ring = &log_rings[i];
+    uint64_t dropped = total_drops(&ring->counters);
+    if (dropped != ring->reported_drops) {
+      write_drop_notice(dropped - ring->reported_drops, &ring->owner);
+      ring->reported_drops = dropped;
+    }
+  }
+
+  uint64_t unowned = total_drops(&unowned_counters);
+  if (unowned != reported_unowned_drops) {
+    write_drop_notice(unowned - reported_unowned_drops, NULL);
+    reported_unowned_drops = unowned;
+  }
+}
+
+// Timestamp of the oldest spilled entry of `ring`, if any.
+static bool spill_peek(log_ring *ring, uint64_t *ts) {
+  if (atomic_load_explicit(&ring->spill_pending, memory_order_acquire) == 0) {
+    return false;
+  }
+  pthread_mutex_lock(&ring->spill_lock);
+  *ts = ring->spill_head->records[ring->spill_read].timestamp;
+  pthread_mutex_unlock(&ring->spill_lock);
+  return true;
+}
+
+// Copies the oldest spilled entry of `ring` out and releases its records.
+static void spill_take(log_ring *ring, log_record *hdr, char *ext) {
+  pthread_mutex_lock(&ring->spill_lock);
+
+  log_spill_chunk *chunk = ring->spill_head;
+  *hdr = chunk->records[ring->spill_read];
+  copy_ext(chunk->records, LOG_SPILL_CHUNK, ring->spill_read, 0, ext,
+           hdr->num_ext * sizeof(log_record), false);
+  ring->spill_read += 1 + hdr->num_ext;
+
+  if (ring->spill_read == chunk->count) {
+    if (chunk->next) {
+      ring->spill_head = chunk->next;
+      free(chunk);
+    } else {
+      chunk->count = 0;
+    }
+    ring->spill_read = 0;
+  }
+
+  atomic_fetch_sub_explicit(&ring->spill_pending, 1, memory_order_release);
+  pthread_mutex_unlock(&ring->spill_lock);
+}
+
+static size_t format_entry(const log_record *hdr, const char *ext, char *msg,
+                           size_t size) {
+  if (hdr->flags & LOG_FLAG_TEXT) {
+    size_t len = hdr->args[0];
+    memcpy(msg, ext, len);
+    return len;
+  }
+#ifdef ENABLE_BINARY_TRACE
+  return format_trace_record(hdr, ext, hdr->num_ext * sizeof(log_record), msg,
+                             size);
+#else
+  (void)size;
+  return 0;
+#endif
+}
+
+// Writes out every pending entry, merging the rings and spill lists on their
+// timestamps.
+static void drain_log_rings(void) {
+  char msg[MAX_LOG_MSG_SIZE];
+  char ext[LOG_MAX_EXT * sizeof(log_record)];
+  uint32_t rings = atomic_load(&num_log_rings);
+  if (rings > LOG_MAX_THREADS) {
+    rings = LOG_MAX_THREADS;
+  }
+
+  for (;;) {
+    log_ring *next = NULL;
+    bool next_spilled = false;
+    uint64_t next_ts = 0;
+
+    // The ring is checked before the spill list, so an entry seen in the ring
+    // has any older spilled entry of the same thread visible as well.
+    for (uint32_t i = 0; i < rings; i++) {
+      log_ring *ring = &log_rings[i];
+      uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+      uint64_t ts;
+      if (head != atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+        ts = ring->records[head % LOG_RING_SIZE].timestamp;
+        if (next == NULL || ts < next_ts) {
+          next = ring;
+          next_spilled = false;
+          next_ts = ts;
+        }
+      }
+      // A thread's spilled entries predate its ring entries, so they win
+      // timestamp ties against them.
+      if (spill_peek(ring, &ts) &&
+          (next == NULL || ts < next_ts || (ts == next_ts && next == ring))) {
+        next = ring;
+        next_spilled = true;
+        next_ts = ts;
+      }
+    }
+    if (next == NULL) {
+      break;
+    }
+
+    log_record hdr;
+    if (next_spilled) {
+      spill_take(next, &hdr, ext);
+    } else {
+      uint64_t head = atomic_load_explicit(&next->head, memory_order_relaxed);
+      hdr = next->records[head % LOG_RING_SIZE];
+      copy_ext(next->records, LOG_RING_SIZE, head, 0, ext,
+               hdr.num_ext * sizeof(log_record), false);
+      atomic_store_explicit(&next->head, head + 1 + hdr.num_ext,
+                            memory_order_release);
+    }
+
+    size_t len = format_entry(&hdr, ext, msg, sizeof(msg));
+    if (log_file) {
+      fwrite(msg, len, 1, log_file);
+    }
+  }
+
+  report_drops(rings);
+}
+
+static void add_counters(log_counters *sum, const log_counters *c) {
+  atomic_fetch_add(&sum->written, atomic_load(&c->written));
+  atomic_fetch_add(&sum->retried, atomic_load(&c->retried));
+  atomic_fetch_add(&sum->blocked, atomic_load(&c->blocked));
+  atomic_fetch_add(&sum->spilled, atomic_load(&c->spilled));
+  for (int i = 0; i < LOG_NUM_LEVELS; i++) {
+    atomic_fetch_add(&sum->dropped[i], atomic_load(&c->dropped[i]));
+  }
+}
+
+static void report_log_counters(void) {
+  static const char *const policy_names[] = {"drop", "retry", "block",
+                                             "spill"};
+  log_counters sum = {0};
+
+  uint32_t rings = atomic_load(&num_log_rings);
+  if (rings > LOG_MAX_THREADS) {
+    rings = LOG_MAX_THREADS;
+  }
+  for (uint32_t i = 0; i < rings; i++) {
+    add_counters(&sum, &log_rings[i].counters);
+  }
+  add_counters(&sum, &unowned_counters);
+
+  char dropped[128] = "";
+  for (int i = 0; i < LOG_NUM_LEVELS; i++) {
+    snprintf(dropped + strlen(dropped), sizeof(dropped) - strlen(dropped),
+             "%s%s %llu", i ? ", " : "", level_names[i],
+             (unsigned long long)atomic_load(&sum.dropped[i]));
+  }
+
+  char report[MAX_LOG_MSG_SIZE];
+  snprintf(report, sizeof(report),
+           "Log policy %s: %llu written, %llu spilled, %llu retries, "
+           "%llu blocked, dropped %s\n",
+           policy_names[log_overflow],
+           (unsigned long long)atomic_load(&sum.written),
+           (unsigned long long)atomic_load(&sum.spilled),
+           (unsigned long long)atomic_load(&sum.retried),
+           (unsigned long long)atomic_load(&sum.blocked), dropped);
+
+  if (log_file) {
+    fprintf(log_file, "[%u] [SYS] [INFO] [log.c:%d] %s",
+            proc_state.system_time, __LINE__, report);
+  }
+  if (total_drops(&sum) > 0) {
+    fprintf(stderr, "P%u: %s", proc_state.processor_id, report);
+  }
+}
 
 static void *logger_thread_func(void *arg) {
   (void)arg;
-  char msg[MAX_LOG_MSG_SIZE];
 
   atomic_store(&log_wakeup_pending, 0);
 
   while (!atomic_load(&log_shutdown_requested)) {
     platform_sem_wait(&log_sem);
 
-    while (ring_buffer_try_dequeue(&log_queue, msg) == 0) {
-      if (log_file) {
-        fwrite(msg, strlen(msg), 1, log_file);
-      }
-    }
+    // Clear the flag first so entries written while draining post again.
     atomic_store(&log_wakeup_pending, 0);
+
+    drain_log_rings();
   }
 
   return NULL;
@@ -59,15 +724,15 @@ void log_system_init(uint8_t proc_id) {
     perror("Failed to open log file");
   }
 
-  ring_buffer_init(&log_queue, LOG_QUEUE_SIZE, log_buffer, log_seq,
-                   MAX_LOG_MSG_SIZE);
-
   platform_sem_init(&log_sem, 0);
 
+  atomic_store(&log_shutdown_requested, 0);
   atomic_store(&log_wakeup_pending, 0);
 
   if (pthread_create(&logger_thread, NULL, logger_thread_func, NULL)) {
     perror("pthread_create logger failed");
+  } else {
+    atomic_store(&logger_running, true);
   }
 }
 
@@ -77,9 +742,13 @@ void log_system_shutdown(void) {
   platform_sem_post(&log_sem);
 
   pthread_join(logger_thread, NULL);
+  atomic_store(&logger_running, false);
 
   platform_sem_destroy(&log_sem);
 
+  drain_log_rings();
+  report_log_counters();
+
   if (log_file) {
     fflush(log_file);
     fclose(log_file);
@@ -1,11 +1,22 @@
+#include "affinity.h"
+#include "batch.h"
+#include "fault.h"
+#include "ipc.h"
 #include "processor.h"
+#include "replay.h"
+#include "sim_features.h"
 #include "sys_config.h"
+#include "task_alloc.h"
 
 #include "lib/barrier.h"
 #include "lib/log.h"
 
+#include "scheduler/sched_policy.h"
+
+#include <errno.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <sys/wait.h>
@@ -19,6 +30,26 @@ static volatile sig_atomic_t shutdown_requested = 0;
 static pid_t proc_pids[NUM_PROC] = {0};
 
 barrier *proc_barrier = NULL;
+event_sync_state *proc_event_sync = NULL;
+_Atomic uint32_t *proc_abort_iteration = NULL;
+ipc_shm_segment *ipc_shm = NULL;
+ipc_peer_list *ipc_peers = NULL;
+
+affinity_policy thread_affinity = AFFINITY_NONE;
+
+static ipc_peer_list peer_list;
+
+sim_mode simulation_mode = SIM_MODE_TICK;
+uint64_t sim_seed = 0;
+
+// State shared by all processor processes, kept in one segment.
+typedef struct {
+  barrier proc_barrier;
+  event_sync_state event_sync;
+  _Atomic uint32_t abort_iteration;
+  ipc_shm_segment ipc;
+  batch_shared batch;
+} shared_state;
 
 static void sigint_handler(int signum) {
   (void)signum;
@@ -27,34 +58,301 @@ static void sigint_handler(int signum) {
 
 static void sigterm_handler(int signum) { (void)signum; }
 
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "Usage: %s [-m tick|event] [-l debug|info|warn|error|fatal]\n"
+          "          [-o drop|retry|block|spill] [-t shm|udp|batch]\n"
+          "          [-p id -P host:port,...] [-a none|pin] [-c file]\n"
+          "          [-f features] [-s edf-vd|fp-amc|edf-llf] [-S seed]\n"
+          "          [-b manifest [-O metrics]] [-w dir | -r dir] [-F faults]\n"
+          "  -m  simulation mode; event skips ticks where every core sleeps\n"
+          "  -l  minimum log level\n"
+          "  -o  what a thread does when its log ring is full\n"
+          "  -t  IPC transport between processors\n"
+          "  -p  run only this processor, syncing with the peers given by -P\n"
+          "  -P  address of every processor, in processor id order\n"
+          "  -a  pin core threads to CPUs and processors to NUMA nodes\n"
+          "  -c  allocation file written by tools/task_allocator.py\n"
+          "  -f  scheduler features: all, none or a list such as dvfs,dpm\n"
+          "  -s  scheduling policy\n"
+          "  -S  seed for job execution times, from the clock by default\n"
+          "  -b  run each allocation listed in the manifest in turn\n"
+          "  -O  metrics file written in batch mode\n"
+          "  -w  record every processor's ACETs and deliveries into dir\n"
+          "  -r  replay the recording in dir, with -p only that processor\n"
+          "  -F  faults to inject, as kind:dist:interval[:duration],...\n",
+          prog);
+}
+
+static int parse_log_overflow(const char *name, log_overflow_policy *policy) {
+  static const char *names[] = {"drop", "retry", "block", "spill"};
+
+  for (int i = 0; i <= LOG_OVERFLOW_SPILL; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *policy = (log_overflow_policy)i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int parse_ipc_transport(const char *name, ipc_transport_kind *kind) {
+  static const char *names[] = {"shm", "udp", "batch"};
+
+  for (int i = 0; i <= IPC_TRANSPORT_UDP_BATCH; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *kind = (ipc_transport_kind)i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int parse_log_level(const char *name, log_level *level) {
+  static const char *names[] = {"debug", "info", "warn", "error", "fatal"};
+
+  for (int i = 0; i <= LOG_LEVEL_FATAL; i++) {
+    if (strcmp(name, names[i]) == 0) {
+      *level = (log_level)i;
+      return 0;
+    }
+  }
+  return -1;
+}
+
 int main(int argc, char *argv[]) {
-  srand((unsigned)time(NULL));
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  sim_seed = (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+
+  int opt;
+  int single_proc = -1;
+  const char *peer_spec = NULL;
+  const char *alloc_path = TASK_ALLOC_DEFAULT_PATH;
+  const char *manifest_path = NULL;
+  const char *metrics_path = BATCH_DEFAULT_METRICS_PATH;
+  bool log_level_set = false;
+  batch_manifest manifest;
+  bool transport_set = false;
+  while ((opt = getopt(argc, argv, "m:l:o:t:p:P:a:c:f:s:S:b:O:w:r:F:h")) !=
+         -1) {
+    switch (opt) {
+    case 'm':
+      if (strcmp(optarg, "tick") == 0) {
+        simulation_mode = SIM_MODE_TICK;
+      } else if (strcmp(optarg, "event") == 0) {
+        simulation_mode = SIM_MODE_EVENT;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'l':
+      if (parse_log_level(optarg, &current_log_level) != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      log_level_set = true;
+      break;
+    case 'o':
+      if (parse_log_overflow(optarg, &log_overflow) != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 't':
+      if (parse_ipc_transport(optarg, &ipc_transport) != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      transport_set = true;
+      break;
+    case 'p':
+      single_proc = atoi(optarg);
+      if (single_proc < 0 || single_proc >= NUM_PROC) {
+        fprintf(stderr, "Processor id must be in [0, %d)\n", NUM_PROC);
+        return 1;
+      }
+      break;
+    case 'P':
+      peer_spec = optarg;
+      break;
+    case 'a':
+      if (strcmp(optarg, "none") == 0) {
+        thread_affinity = AFFINITY_NONE;
+      } else if (strcmp(optarg, "pin") == 0) {
+        thread_affinity = AFFINITY_PIN;
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'c':
+      alloc_path = optarg;
+      break;
+    case 'f':
+      if (features_parse(optarg, &sim_features) != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 's':
+      scheduler_policy = sched_policy_find(optarg);
+      if (scheduler_policy == NULL) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'b':
+      manifest_path = optarg;
+      break;
+    case 'O':
+      metrics_path = optarg;
+      break;
+    case 'w':
+      replay_mode = REPLAY_RECORD;
+      replay_dir = optarg;
+      break;
+    case 'r':
+      replay_mode = REPLAY_PLAY;
+      replay_dir = optarg;
+      break;
+    case 'F':
+      if (faults_parse(optarg) != 0) {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    case 'S': {
+      char *end;
+      errno = 0;
+      sim_seed = strtoull(optarg, &end, 0);
+      if (errno != 0 || end == optarg || *end != '\0') {
+        usage(argv[0]);
+        return 1;
+      }
+      break;
+    }
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
 
-  (void)argc;
-  (void)argv;
+  // A replayed processor needs no peers.
+  bool needs_peers = single_proc >= 0 && replay_mode != REPLAY_PLAY;
+  if (needs_peers != (peer_spec != NULL) ||
+      (manifest_path != NULL &&
+       (single_proc >= 0 || replay_mode != REPLAY_OFF))) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Batch runs are checked per manifest entry, and a replay runs with the
+  // recording's features.
+  uint32_t unsupported = sched_policy_unsupported(scheduler_policy,
+                                                  sim_features);
+  if (manifest_path == NULL && replay_mode != REPLAY_PLAY &&
+      unsupported != 0) {
+    char features[64];
+    features_format(unsupported, features, sizeof(features));
+    fprintf(stderr,
+            "%s cannot run with %s, whose slack analysis assumes EDF; "
+            "leave them out with -f\n",
+            scheduler_policy->name, features);
+    return 1;
+  }
+
+  // A batch loads each run's allocation in the processors, and only reports
+  // metrics unless asked for logs.
+  if (manifest_path != NULL) {
+    if (batch_prepare(manifest_path, metrics_path, &manifest) != 0) {
+      return 1;
+    }
+    if (!log_level_set) {
+      current_log_level = LOG_LEVEL_FATAL;
+    }
+  } else if (task_alloc_load(alloc_path) != 0) {
+    fprintf(stderr, "Could not load the allocation from %s\n", alloc_path);
+    return 1;
+  }
+
+  // A replay takes its deliveries from the recording, and leaves out the logs
+  // unless asked for them.
+  if (replay_mode == REPLAY_PLAY) {
+    ipc_transport = IPC_TRANSPORT_REPLAY;
+    if (!log_level_set) {
+      current_log_level = LOG_LEVEL_FATAL;
+    }
+    if (single_proc >= 0) {
+      processor_init((uint8_t)single_proc);
+      processor_run();
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Distributed mode: this process is one processor and the peers are
+  // reached over the network, so there is no shared segment.
+  if (single_proc >= 0) {
+    if (ipc_parse_peers(peer_spec, &peer_list) != 0) {
+      fprintf(stderr, "Expected %d peers as host:port,host:port,...\n",
+              NUM_PROC);
+      return 1;
+    }
+    if (ipc_transport == IPC_TRANSPORT_SHM) {
+      if (transport_set) {
+        fprintf(stderr, "The shm transport needs all processors on one host, "
+                        "started without -p\n");
+        return 1;
+      }
+      ipc_transport = IPC_TRANSPORT_UDP_BATCH;
+    }
+    ipc_peers = &peer_list;
+
+    processor_init((uint8_t)single_proc);
+    processor_run();
+    return EXIT_FAILURE;
+  }
 
   signal(SIGINT, sigint_handler);
   signal(SIGTERM, sigterm_handler);
 
   int shmid;
 
-  shmid = shmget(IPC_PRIVATE, sizeof(barrier), IPC_CREAT | 0666);
+  shmid = shmget(IPC_PRIVATE, sizeof(shared_state), IPC_CREAT | 0666);
   if (shmid < 0) {
     perror("shmget failed");
     return 1;
   }
 
-  proc_barrier = (barrier *)shmat(shmid, NULL, 0);
-  if (proc_barrier == (barrier *)-1) {
+  shared_state *shared = (shared_state *)shmat(shmid, NULL, 0);
+  if (shared == (shared_state *)-1) {
     perror("shmat failed");
     return 1;
   }
+  proc_barrier = &shared->proc_barrier;
+  proc_event_sync = &shared->event_sync;
+  proc_abort_iteration = &shared->abort_iteration;
+  atomic_store(proc_abort_iteration, UINT32_MAX);
 
-  if (barrier_init(proc_barrier, NUM_PROC, 1) != 0) {
+  if (barrier_init(proc_barrier, NUM_PROC,
+                   BARRIER_PROCESS_SHARED | BARRIER_SPIN) != 0) {
     perror("barrier_init failed");
     return 1;
   }
 
+  if (ipc_transport == IPC_TRANSPORT_SHM) {
+    ipc_shm = &shared->ipc;
+    ipc_shm_segment_init(ipc_shm);
+  }
+
+  // Replayed processors take nothing from each other, so none waits for the
+  // rest.
+  if (replay_mode == REPLAY_PLAY) {
+    proc_barrier = NULL;
+    proc_event_sync = NULL;
+  }
+
   for (uint8_t proc_id = 0; proc_id < NUM_PROC; proc_id++) {
     proc_pids[proc_id] = fork();
     if (proc_pids[proc_id] < 0) {
@@ -62,6 +360,9 @@ int main(int argc, char *argv[]) {
       return 1;
     }
     if (proc_pids[proc_id] == 0) {
+      if (manifest_path != NULL) {
+        batch_run(proc_id, &manifest, &shared->batch, metrics_path);
+      }
       processor_init(proc_id);
       processor_run();
 
@@ -92,7 +393,7 @@ int main(int argc, char *argv[]) {
         fatal_error = 1;
       }
 
-      if (fatal_error) {
+      if (fatal_error && replay_mode != REPLAY_PLAY) {
         shutdown_requested = 1;
         break;
       }
@@ -129,8 +430,8 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  barrier_destroy(proc_barrier);
-  shmdt(proc_barrier);
+  barrier_destroy(&shared->proc_barrier);
+  shmdt(shared);
   shmctl(shmid, IPC_RMID, NULL);
 
   return shutdown_requested || fatal_error ? EXIT_FAILURE : EXIT_SUCCESS;
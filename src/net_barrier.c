@@ -0,0 +1,227 @@
+#include "net_barrier.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "lib/log.h"
+#include "processor.h"
+
+typedef struct {
+  uint32_t round;
+  uint32_t value;
+} net_barrier_msg;
+
+typedef struct {
+  uint8_t proc_id;
+  uint8_t num_proc;
+} net_barrier_hello;
+
+typedef struct {
+  uint8_t proc_id;
+  uint32_t round;
+  // Coordinator: one connection per processor, indexed by id. Others: the
+  // connection to the coordinator in conns[0].
+  int conns[NUM_PROC];
+  int listen_fd;
+} net_barrier_state;
+
+static net_barrier_state nb = {.listen_fd = -1};
+
+static int write_full(int fd, const void *buf, size_t len) {
+  const char *p = buf;
+  while (len > 0) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+  char *p = buf;
+  while (len > 0) {
+    ssize_t n = recv(fd, p, len, 0);
+    if (n == 0) {
+      errno = ECONNRESET;
+      return -1;
+    }
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static void set_nodelay(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+}
+
+static int accept_peers(const ipc_peer_list *peers) {
+  nb.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (nb.listen_fd < 0) {
+    perror("socket() failed");
+    return -1;
+  }
+
+  int reuse = 1;
+  setsockopt(nb.listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  struct sockaddr_in local_addr;
+  memset(&local_addr, 0, sizeof(local_addr));
+  local_addr.sin_family = AF_INET;
+  local_addr.sin_port = peers->addr[0].sin_port;
+  local_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(nb.listen_fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) <
+          0 ||
+      listen(nb.listen_fd, NUM_PROC) < 0) {
+    perror("net barrier bind/listen failed");
+    return -1;
+  }
+
+  for (uint8_t joined = 1; joined < NUM_PROC;) {
+    struct pollfd pfd = {.fd = nb.listen_fd, .events = POLLIN};
+    int ready = poll(&pfd, 1, NET_BARRIER_CONNECT_TIMEOUT_MS);
+    if (ready <= 0) {
+      if (ready < 0 && errno == EINTR)
+        continue;
+      LOG(LOG_LEVEL_ERROR, "Timed out waiting for %d processors to connect",
+          NUM_PROC - joined);
+      return -1;
+    }
+
+    int fd = accept(nb.listen_fd, NULL, NULL);
+    if (fd < 0) {
+      perror("accept() failed");
+      return -1;
+    }
+
+    net_barrier_hello hello;
+    if (read_full(fd, &hello, sizeof(hello)) != 0 ||
+        hello.num_proc != NUM_PROC || hello.proc_id == 0 ||
+        hello.proc_id >= NUM_PROC || nb.conns[hello.proc_id] >= 0) {
+      LOG(LOG_LEVEL_WARN, "Rejected tick barrier connection");
+      close(fd);
+      continue;
+    }
+
+    set_nodelay(fd);
+    nb.conns[hello.proc_id] = fd;
+    joined++;
+    LOG(LOG_LEVEL_INFO, "Processor %d joined the tick barrier", hello.proc_id);
+  }
+
+  return 0;
+}
+
+static int connect_coordinator(const ipc_peer_list *peers) {
+  struct timespec delay = {.tv_sec = 0, .tv_nsec = 100 * 1000 * 1000};
+
+  for (int waited = 0; waited < NET_BARRIER_CONNECT_TIMEOUT_MS;
+       waited += 100) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+      perror("socket() failed");
+      return -1;
+    }
+
+    if (connect(fd, (const struct sockaddr *)&peers->addr[0],
+                sizeof(peers->addr[0])) == 0) {
+      net_barrier_hello hello = {.proc_id = nb.proc_id, .num_proc = NUM_PROC};
+      if (write_full(fd, &hello, sizeof(hello)) != 0) {
+        close(fd);
+        return -1;
+      }
+      set_nodelay(fd);
+      nb.conns[0] = fd;
+      return 0;
+    }
+
+    close(fd);
+    nanosleep(&delay, NULL);
+  }
+
+  LOG(LOG_LEVEL_ERROR, "Could not reach the tick barrier coordinator");
+  return -1;
+}
+
+int net_barrier_init(uint8_t proc_id, const ipc_peer_list *peers) {
+  nb.proc_id = proc_id;
+  nb.round = 0;
+  for (uint8_t i = 0; i < NUM_PROC; i++) {
+    nb.conns[i] = -1;
+  }
+
+  int ret = proc_id == 0 ? accept_peers(peers) : connect_coordinator(peers);
+  if (ret != 0) {
+    net_barrier_destroy();
+    return -1;
+  }
+
+  LOG(LOG_LEVEL_INFO, "Tick barrier ready with %d processors", NUM_PROC);
+  return 0;
+}
+
+int net_barrier_wait(uint32_t proposal, uint32_t *agreed) {
+  net_barrier_msg msg = {.round = nb.round++, .value = proposal};
+
+  if (nb.proc_id != 0) {
+    uint32_t round = msg.round;
+    if (write_full(nb.conns[0], &msg, sizeof(msg)) != 0 ||
+        read_full(nb.conns[0], &msg, sizeof(msg)) != 0 || msg.round != round) {
+      return -1;
+    }
+    *agreed = msg.value;
+    return 0;
+  }
+
+  for (uint8_t i = 1; i < NUM_PROC; i++) {
+    net_barrier_msg arrival;
+    if (read_full(nb.conns[i], &arrival, sizeof(arrival)) != 0 ||
+        arrival.round != msg.round) {
+      return -1;
+    }
+    if (arrival.value < msg.value) {
+      msg.value = arrival.value;
+    }
+  }
+
+  for (uint8_t i = 1; i < NUM_PROC; i++) {
+    if (write_full(nb.conns[i], &msg, sizeof(msg)) != 0) {
+      return -1;
+    }
+  }
+
+  *agreed = msg.value;
+  return 0;
+}
+
+void net_barrier_destroy(void) {
+  for (uint8_t i = 0; i < NUM_PROC; i++) {
+    if (nb.conns[i] >= 0) {
+      close(nb.conns[i]);
+      nb.conns[i] = -1;
+    }
+  }
+  if (nb.listen_fd >= 0) {
+    close(nb.listen_fd);
+    nb.listen_fd = -1;
+  }
+}
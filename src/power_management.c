@@ -1,5 +1,6 @@
 #include "power_management.h"
 #include "processor.h"
+#include "sim_features.h"
 #include "sys_config.h"
 
 #include "lib/list.h"
@@ -31,6 +32,15 @@ float power_get_current_scaling_factor(uint8_t core_id) {
   return dvfs_levels[core_states[core_id].current_dvfs_level].scaling_factor;
 }
 
+float power_get_relative_power(uint8_t core_id) {
+  const dvfs_level *cur = &dvfs_levels[core_states[core_id].current_dvfs_level];
+  const dvfs_level *top = &dvfs_levels[0];
+  return ((float)cur->voltage_mv * (float)cur->voltage_mv *
+          (float)cur->frequency_mhz) /
+         ((float)top->voltage_mv * (float)top->voltage_mv *
+          (float)top->frequency_mhz);
+}
+
 uint8_t calc_required_dvfs_level(uint8_t core_id) {
   core_state *cs = &core_states[core_id];
   if (cs->is_idle || cs->running_job == NULL)
@@ -171,19 +181,19 @@ bool power_management_try_procrastination(uint8_t core_id) {
   cs->running_job->state = JOB_STATE_READY;
 
   if (cs->running_job->is_replica) {
-    add_to_queue_sorted(&cs->replica_queue, cs->running_job);
+    job_queue_push(&cs->replica_queue, cs->running_job);
   } else {
-    add_to_queue_sorted(&cs->ready_queue, cs->running_job);
+    job_queue_push(&cs->ready_queue, cs->running_job);
   }
   cs->running_job = NULL;
   cs->is_idle = true;
 
   UNLOCK_RQ(core_id);
 
-#ifdef ENABLE_DPM
-  power_management_set_dpm_interval(
-      core_id, proc_state.system_time + (uint32_t)floorf(deferrable_time));
-#endif
+  if (sim_features & FEATURE_DPM) {
+    power_management_set_dpm_interval(
+        core_id, proc_state.system_time + (uint32_t)floorf(deferrable_time));
+  }
 
   LOG(LOG_LEVEL_INFO, "Procrastinating for %.2f ticks", deferrable_time);
 
@@ -1,6 +1,11 @@
 #include "processor.h"
+#include "affinity.h"
+#include "fault.h"
 #include "ipc.h"
+#include "net_barrier.h"
+#include "replay.h"
 #include "sys_config.h"
+#include "tick_profile.h"
 
 #include "lib/list.h"
 #include "lib/log.h"
@@ -16,9 +21,24 @@
 processor_state proc_state;
 
 barrier *proc_barrier __attribute__((weak)) = NULL;
+event_sync_state *proc_event_sync __attribute__((weak)) = NULL;
+_Atomic uint32_t *proc_abort_iteration __attribute__((weak)) = NULL;
+
+sim_mode simulation_mode __attribute__((weak)) = SIM_MODE_TICK;
+uint64_t sim_seed __attribute__((weak)) = 0;
 
 _Atomic int core_fatal_shutdown_requested = 0;
 static _Atomic int proc_shutdown_requested = 0;
+static _Atomic int proc_stop_requested = 0;
+
+// The timer and core threads wait here between simulations, together with
+// the thread driving them.
+static barrier run_gate;
+static _Atomic bool workers_done = false;
+
+static pthread_t timer_thread;
+static pthread_t core_threads[NUM_CORES_PER_PROC];
+static uint8_t core_ids[NUM_CORES_PER_PROC];
 
 #define SYSTEM_TICK_MS 1
 
@@ -28,17 +48,125 @@ static _Atomic int proc_shutdown_requested = 0;
 
 __thread log_thread_context log_thread_ctx = {0, 0, false};
 
-static void *timer_thread_func(void *arg) {
-  (void)arg;
+// Earliest tick at which this processor has something to do. Skipped ticks
+// only ever log at debug level, so skipping is disabled when those are shown.
+// Releases due while a core sleeps are dropped in tick mode as well, so only
+// the DPM exits, discard queue deadlines and injected faults matter.
+static uint32_t next_event_tick(uint32_t now) {
+  if (current_log_level <= LOG_LEVEL_DEBUG) {
+    return now;
+  }
+
+  uint32_t next = TOTAL_TICKS > 0 ? TOTAL_TICKS : UINT32_MAX;
+  uint32_t fault = fault_next_tick();
+  if (fault < next) {
+    next = fault;
+  }
+
+  for (uint8_t i = 0; i < NUM_CORES_PER_PROC; i++) {
+    const core_state *cs = &core_states[i];
+    if (!cs->dpm_control_block.in_low_power_state ||
+        cs->local_criticality_level != proc_state.system_criticality_level) {
+      return now;
+    }
+    if (cs->dpm_control_block.dpm_end_time < next) {
+      next = cs->dpm_control_block.dpm_end_time;
+    }
+  }
+
+  job_struct *cur;
+  pthread_mutex_lock(&proc_state.discard_queue_lock);
+  list_for_each_entry(cur, &proc_state.discard_queue, link) {
+    if (cur->actual_deadline < next) {
+      next = cur->actual_deadline;
+    }
+  }
+  pthread_mutex_unlock(&proc_state.discard_queue_lock);
+
+  return (next == UINT32_MAX || next < now) ? now : next;
+}
+
+// Distributed runs sync through the network tick barrier, which also agrees
+// on the earliest proposed tick. Losing it ends the run.
+static void wait_for_peers(uint32_t *tick) {
+  if (net_barrier_wait(*tick, tick) != 0) {
+    LOG(LOG_LEVEL_FATAL, "Lost connection to the tick barrier");
+    atomic_store(&core_fatal_shutdown_requested, 1);
+    atomic_store(&proc_shutdown_requested, 1);
+  }
+}
+
+// Processors agree on the earliest proposed tick through proc_barrier, which
+// also keeps them in lockstep in place of the per-tick wait in tick mode.
+static void skip_to_next_event(bool ipc_active, uint8_t slot) {
+  uint32_t now = proc_state.system_time;
+  uint32_t target = ipc_active ? now : next_event_tick(now);
+
+  if (replay_mode == REPLAY_PLAY) {
+    target = replay_skip_target(now);
+  } else if (ipc_peers) {
+    wait_for_peers(&target);
+  } else if (proc_barrier && proc_event_sync) {
+    atomic_store(&proc_event_sync->next_tick[slot][proc_state.processor_id],
+                 target);
+    barrier_wait(proc_barrier);
+    for (uint8_t p = 0; p < NUM_PROC; p++) {
+      uint32_t proposed = atomic_load(&proc_event_sync->next_tick[slot][p]);
+      if (proposed < target) {
+        target = proposed;
+      }
+    }
+  }
+
+  if (target > now) {
+    if (replay_mode == REPLAY_RECORD) {
+      replay_record_skip(now, target);
+    }
+    uint32_t end =
+        TOTAL_TICKS > 0 && target > TOTAL_TICKS ? TOTAL_TICKS : target;
+    if (end > now) {
+      scheduler_skip_ticks(end - now);
+    }
+    atomic_store(&proc_state.system_time, target);
+    if (TOTAL_TICKS > 0 && target >= TOTAL_TICKS) {
+      atomic_store(&proc_shutdown_requested, 1);
+    }
+  }
+}
+
+// Without a shared abort iteration the processor stops straight away.
+static void raise_abort(uint32_t iteration) {
+  if (proc_abort_iteration == NULL) {
+    atomic_store(&proc_shutdown_requested, 1);
+    return;
+  }
+
+  uint32_t none = UINT32_MAX;
+  atomic_compare_exchange_strong(proc_abort_iteration, &none, iteration);
+}
+
+static bool wait_for_run(void) {
+  barrier_wait(&run_gate);
+  return !atomic_load(&workers_done);
+}
+
+static void run_timer(void) {
+  uint8_t slot = 0;
+  uint32_t iteration = 0;
+  TICK_PROFILE_BEGIN(phase_clock);
 
   while (!atomic_load(&proc_shutdown_requested)) {
     barrier_wait(&proc_state.core_completion_barrier);
+    TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_CORE_BARRIER, phase_clock);
     if (atomic_load(&proc_shutdown_requested)) {
       break;
     }
     ring_buffer_clear(&proc_state.incoming_completion_msg_queue);
 
-    ipc_receive_completion_messages();
+    fault_timer_tick();
+    size_t received = ipc_receive_completion_messages();
+    fault_observe_completions();
+    TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_IPC_RECEIVE, phase_clock);
 
     job_struct *cur, *next;
     pthread_mutex_lock(&proc_state.discard_queue_lock);
@@ -51,24 +179,57 @@ static void *timer_thread_func(void *arg) {
       }
     }
     pthread_mutex_unlock(&proc_state.discard_queue_lock);
+    TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_DISCARD_RELEASE, phase_clock);
 
-    if (atomic_load(&core_fatal_shutdown_requested)) {
-      atomic_store(&proc_shutdown_requested, 1);
+    // A replay ends where the recording did, whatever ended it.
+    if (replay_mode != REPLAY_PLAY) {
+      if (atomic_load(&core_fatal_shutdown_requested)) {
+        raise_abort(iteration);
+      }
+      if (proc_abort_iteration != NULL &&
+          atomic_load(proc_abort_iteration) < iteration) {
+        atomic_store(&proc_shutdown_requested, 1);
+      }
     }
 
     atomic_fetch_add_explicit(&proc_state.system_time, 1, memory_order_relaxed);
 
-    if (TOTAL_TICKS > 0 && proc_state.system_time >= TOTAL_TICKS) {
+    if ((TOTAL_TICKS > 0 && proc_state.system_time >= TOTAL_TICKS) ||
+        (replay_mode == REPLAY_PLAY &&
+         replay_finished(proc_state.system_time))) {
       atomic_store(&proc_shutdown_requested, 1);
     }
 
-    ipc_send_completion_messages();
+    size_t sent = ipc_send_completion_messages();
+    TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_IPC_SEND, phase_clock);
+
+    if (simulation_mode == SIM_MODE_EVENT) {
+      skip_to_next_event(received > 0 || sent > 0, slot);
+      slot ^= 1;
+    } else if (ipc_peers) {
+      // Before releasing the cores, so a lost barrier can still stop them.
+      uint32_t tick = proc_state.system_time;
+      wait_for_peers(&tick);
+    }
+    TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_PEER_SYNC, phase_clock);
 
     barrier_wait(&proc_state.time_sync_barrier);
+    TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_TIME_SYNC, phase_clock);
 
-    if (proc_barrier) {
+    if (proc_barrier && simulation_mode == SIM_MODE_TICK) {
       barrier_wait(proc_barrier);
+      TICK_PROFILE_LAP(TICK_PROFILE_TIMER, TICK_PHASE_PROC_BARRIER, phase_clock);
     }
+    iteration++;
+  }
+}
+
+static void *timer_thread_func(void *arg) {
+  (void)arg;
+
+  while (wait_for_run()) {
+    run_timer();
+    barrier_wait(&run_gate);
   }
   return NULL;
 }
@@ -79,34 +240,69 @@ static void *core_thread_func(void *arg) {
   log_thread_ctx.core_id = core_id;
   log_thread_ctx.is_set = true;
 
-  while (!atomic_load(&proc_shutdown_requested)) {
-    scheduler_tick(core_id);
-    barrier_wait(&proc_state.core_completion_barrier);
-    barrier_wait(&proc_state.time_sync_barrier);
+  while (wait_for_run()) {
+    TICK_PROFILE_BEGIN(phase_clock);
+    while (!atomic_load(&proc_shutdown_requested)) {
+      scheduler_tick(core_id);
+      TICK_PROFILE_LAP(core_id, TICK_PHASE_TICK, phase_clock);
+      barrier_wait(&proc_state.core_completion_barrier);
+      TICK_PROFILE_LAP(core_id, TICK_PHASE_CORE_BARRIER, phase_clock);
+      barrier_wait(&proc_state.time_sync_barrier);
+      TICK_PROFILE_LAP(core_id, TICK_PHASE_TIME_SYNC, phase_clock);
+    }
+    barrier_wait(&run_gate);
   }
   return NULL;
 }
 
 void processor_cleanup(void) {
   LOG(LOG_LEVEL_INFO, "Cleaning up processor...");
+  tick_profile_dump(proc_state.processor_id);
+  replay_close();
+  fault_cleanup();
+  ipc_cleanup();
+  if (ipc_peers) {
+    net_barrier_destroy();
+  }
   log_system_shutdown();
   pthread_mutex_destroy(&proc_state.discard_queue_lock);
   barrier_destroy(&proc_state.core_completion_barrier);
   barrier_destroy(&proc_state.time_sync_barrier);
-  ipc_cleanup();
+  barrier_destroy(&run_gate);
 }
 
 static void processor_sigusr_handler(int sig) {
   (void)sig;
+  atomic_store(&proc_stop_requested, 1);
   atomic_store(&proc_shutdown_requested, 1);
 }
 
+bool processor_stop_requested(void) {
+  return atomic_load(&proc_stop_requested);
+}
+
 void processor_init(uint8_t proc_id) {
   signal(SIGUSR1, processor_sigusr_handler);
 
+  // Before anything is allocated or any thread started, so both land on the
+  // processor's node.
+  affinity_bind_processor(proc_id);
+
   log_system_init(proc_id);
+  tick_profile_init();
+
+  // A replay restores the seed, mode, features and policy it was recorded
+  // with, so before anything reads them.
+  if (replay_open(proc_id) != 0) {
+    LOG(LOG_LEVEL_FATAL, "Processor %d could not open its recording",
+        proc_id);
+    log_system_shutdown();
+    exit(EXIT_FAILURE);
+  }
 
   LOG(LOG_LEVEL_INFO, "Initializing System for Processor %d...", proc_id);
+  LOG(LOG_LEVEL_INFO, "Seed: %llu", (unsigned long long)sim_seed);
+  affinity_log_placement();
 
   proc_state.system_time = 0;
   proc_state.processor_id = proc_id;
@@ -115,42 +311,94 @@ void processor_init(uint8_t proc_id) {
   atomic_store(&proc_state.system_criticality_level, 0);
 
   // Initialize barrier to wait for all cores + the timer thread.
-  barrier_init(&proc_state.core_completion_barrier, NUM_CORES_PER_PROC + 1, 0);
-  barrier_init(&proc_state.time_sync_barrier, NUM_CORES_PER_PROC + 1, 0);
+  barrier_init(&proc_state.core_completion_barrier, NUM_CORES_PER_PROC + 1,
+               BARRIER_SPIN);
+  barrier_init(&proc_state.time_sync_barrier, NUM_CORES_PER_PROC + 1,
+               BARRIER_SPIN);
+  barrier_init(&run_gate, NUM_CORES_PER_PROC + 2, 0);
 
   ipc_thread_init();
-  scheduler_init();
+  if (ipc_peers && net_barrier_init(proc_id, ipc_peers) != 0) {
+    LOG(LOG_LEVEL_FATAL, "Processor %d could not join the tick barrier",
+        proc_id);
+    log_system_shutdown();
+    exit(EXIT_FAILURE);
+  }
+  fault_init();
+  if (scheduler_init() != 0) {
+    log_system_shutdown();
+    exit(EXIT_FAILURE);
+  }
 
   LOG(LOG_LEVEL_INFO, "Processor %d Initialization Complete.", proc_id);
 }
 
-void processor_run(void) {
-  pthread_t timer_thread;
-  pthread_t core_threads[NUM_CORES_PER_PROC];
-  uint8_t core_ids[NUM_CORES_PER_PROC];
-
+int processor_start(void) {
   LOG(LOG_LEVEL_INFO, "Launching threads...");
 
   if (pthread_create(&timer_thread, NULL, timer_thread_func, NULL)) {
     perror("pthread_create timer");
-    return;
+    return -1;
   }
 
   for (uint8_t i = 0; i < NUM_CORES_PER_PROC; ++i) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (affinity_core_thread_attr(&attr, i) != 0) {
+      LOG(LOG_LEVEL_WARN, "Could not pin core %d", i);
+    }
+
     core_ids[i] = i;
-    if (pthread_create(&core_threads[i], NULL, core_thread_func,
-                       &core_ids[i])) {
+    int ret = pthread_create(&core_threads[i], &attr, core_thread_func,
+                             &core_ids[i]);
+    pthread_attr_destroy(&attr);
+    if (ret) {
       perror("pthread_create core");
-      return;
+      return -1;
     }
   }
 
   LOG(LOG_LEVEL_INFO, "All threads running.");
+  return 0;
+}
+
+int processor_reset(uint32_t run) {
+  if (!atomic_load(&proc_stop_requested)) {
+    atomic_store(&proc_shutdown_requested, 0);
+  }
+  atomic_store(&core_fatal_shutdown_requested, 0);
+
+  proc_state.system_time = 0;
+  atomic_store(&proc_state.system_criticality_level, 0);
+  INIT_LIST_HEAD(&proc_state.discard_queue);
+
+  ipc_reset(run);
+  scheduler_cleanup();
+  fault_init();
+  return scheduler_init();
+}
+
+void processor_simulate(void) {
+  barrier_wait(&run_gate);
+  barrier_wait(&run_gate);
+}
+
+void processor_stop(void) {
+  atomic_store(&workers_done, true);
+  barrier_wait(&run_gate);
 
   for (int i = 0; i < NUM_CORES_PER_PROC; ++i) {
     pthread_join(core_threads[i], NULL);
   }
   pthread_join(timer_thread, NULL);
+}
+
+void processor_run(void) {
+  if (processor_start() != 0) {
+    return;
+  }
+  processor_simulate();
+  processor_stop();
   processor_cleanup();
 
   if (atomic_load(&core_fatal_shutdown_requested)) {
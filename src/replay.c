@@ -0,0 +1,331 @@
+#include "replay.h"
+#include "processor.h"
+#include "sim_features.h"
+
+#include "scheduler/sched_policy.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define REPLAY_THREADS (NUM_CORES_PER_PROC + 1)
+
+replay_kind replay_mode = REPLAY_OFF;
+const char *replay_dir = NULL;
+
+// Recording: each thread fills its own chunk, and only writing a full chunk
+// out takes the lock.
+typedef struct {
+  replay_record records[REPLAY_CHUNK_RECORDS];
+  uint32_t count;
+} replay_chunk;
+
+static replay_chunk chunks[REPLAY_THREADS];
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *file = NULL;
+
+// Replay: each thread's records in order, consumed from `next`. A thread
+// that meets a record other than the one it expects stops replaying.
+typedef struct {
+  replay_record *records;
+  uint32_t count;
+  uint32_t next;
+  bool diverged;
+  uint32_t diverged_tick;
+} replay_stream;
+
+static replay_stream streams[REPLAY_THREADS];
+static uint32_t end_tick = UINT32_MAX;
+
+static void path_for(uint8_t proc_id, char *buf, size_t len) {
+  snprintf(buf, len, "%s/replay_p%u.bin", replay_dir, proc_id);
+}
+
+static void flush_chunk(replay_chunk *chunk) {
+  pthread_mutex_lock(&file_lock);
+  if (fwrite(chunk->records, sizeof(replay_record), chunk->count, file) !=
+      chunk->count) {
+    perror("replay write");
+  }
+  pthread_mutex_unlock(&file_lock);
+  chunk->count = 0;
+}
+
+static void append(uint8_t thread, replay_record rec) {
+  replay_chunk *chunk = &chunks[thread];
+  rec.thread = thread;
+  chunk->records[chunk->count++] = rec;
+  if (chunk->count == REPLAY_CHUNK_RECORDS) {
+    flush_chunk(chunk);
+  }
+}
+
+static int open_recording(uint8_t proc_id) {
+  char path[256];
+
+  if (mkdir(replay_dir, 0755) != 0 && errno != EEXIST) {
+    perror(replay_dir);
+    return -1;
+  }
+  path_for(proc_id, path, sizeof(path));
+  file = fopen(path, "wb");
+  if (file == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  replay_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC));
+  hdr.version = REPLAY_VERSION;
+  hdr.proc_id = proc_id;
+  hdr.sim_mode = (uint8_t)simulation_mode;
+  hdr.features = sim_features;
+  hdr.seed = sim_seed;
+  snprintf(hdr.policy, sizeof(hdr.policy), "%s", scheduler_policy->name);
+  memcpy(hdr.faults, fault_specs, sizeof(hdr.faults));
+  fwrite(&hdr, sizeof(hdr), 1, file);
+
+  for (int t = 0; t < REPLAY_THREADS; t++) {
+    chunks[t].count = 0;
+  }
+  return 0;
+}
+
+// Splits the file's records into per-thread streams.
+static int load_streams(FILE *f, const char *path) {
+  long start = ftell(f);
+  fseek(f, 0, SEEK_END);
+  long bytes = ftell(f) - start;
+  fseek(f, start, SEEK_SET);
+
+  size_t total = (size_t)bytes / sizeof(replay_record);
+  replay_record *all = malloc(total * sizeof(replay_record) + 1);
+  if (all == NULL || fread(all, sizeof(replay_record), total, f) != total) {
+    fprintf(stderr, "Could not read the recording %s\n", path);
+    free(all);
+    return -1;
+  }
+
+  uint32_t counts[REPLAY_THREADS] = {0};
+  for (size_t i = 0; i < total; i++) {
+    if (all[i].thread >= REPLAY_THREADS) {
+      fprintf(stderr, "Corrupt record %zu in %s\n", i, path);
+      free(all);
+      return -1;
+    }
+    counts[all[i].thread]++;
+  }
+
+  for (int t = 0; t < REPLAY_THREADS; t++) {
+    streams[t] = (replay_stream){0};
+    streams[t].records = malloc(counts[t] * sizeof(replay_record) + 1);
+    if (streams[t].records == NULL) {
+      free(all);
+      return -1;
+    }
+  }
+  for (size_t i = 0; i < total; i++) {
+    replay_stream *s = &streams[all[i].thread];
+    s->records[s->count++] = all[i];
+    if (all[i].type == REPLAY_RECORD_END) {
+      end_tick = all[i].tick;
+    }
+  }
+
+  free(all);
+  return 0;
+}
+
+static int open_replay(uint8_t proc_id) {
+  char path[256];
+  path_for(proc_id, path, sizeof(path));
+
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+
+  replay_header hdr;
+  if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+      memcmp(hdr.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 ||
+      hdr.version != REPLAY_VERSION || hdr.proc_id != proc_id) {
+    fprintf(stderr, "%s is not a recording of processor %u\n", path, proc_id);
+    fclose(f);
+    return -1;
+  }
+
+  hdr.policy[sizeof(hdr.policy) - 1] = '\0';
+  const sched_policy *policy = sched_policy_find(hdr.policy);
+  if (policy == NULL) {
+    fprintf(stderr, "%s uses unknown policy %s\n", path, hdr.policy);
+    fclose(f);
+    return -1;
+  }
+
+  simulation_mode = (sim_mode)hdr.sim_mode;
+  sim_features = hdr.features;
+  sim_seed = hdr.seed;
+  scheduler_policy = policy;
+  memcpy(fault_specs, hdr.faults, sizeof(hdr.faults));
+
+  end_tick = UINT32_MAX;
+  int ret = load_streams(f, path);
+  fclose(f);
+  return ret;
+}
+
+int replay_open(uint8_t proc_id) {
+  switch (replay_mode) {
+  case REPLAY_RECORD:
+    return open_recording(proc_id);
+  case REPLAY_PLAY:
+    return open_replay(proc_id);
+  default:
+    return 0;
+  }
+}
+
+void replay_close(void) {
+  if (replay_mode == REPLAY_RECORD && file != NULL) {
+    append(REPLAY_TIMER_THREAD,
+           (replay_record){.type = REPLAY_RECORD_END,
+                           .tick = proc_state.system_time});
+    for (int t = 0; t < REPLAY_THREADS; t++) {
+      flush_chunk(&chunks[t]);
+    }
+    fclose(file);
+    file = NULL;
+  } else if (replay_mode == REPLAY_PLAY) {
+    for (int t = 0; t < REPLAY_THREADS; t++) {
+      if (streams[t].diverged) {
+        fprintf(stderr,
+                "P%u: core %d diverged from the recording at tick %u\n",
+                proc_state.processor_id, t, streams[t].diverged_tick);
+      }
+      free(streams[t].records);
+      streams[t] = (replay_stream){0};
+    }
+  }
+}
+
+void replay_record_acet(uint8_t core_id, const job_struct *job, float acet) {
+  replay_record rec = {.type = REPLAY_RECORD_ACET,
+                       .tick = job->arrival_time,
+                       .a = job->parent_task->id};
+  memcpy(&rec.b, &acet, sizeof(acet));
+  append(core_id, rec);
+}
+
+void replay_record_mode_change(uint8_t core_id, criticality_level level,
+                               bool triggered) {
+  append(core_id, (replay_record){.type = triggered
+                                              ? REPLAY_RECORD_MODE_TRIGGERED
+                                              : REPLAY_RECORD_MODE_OBSERVED,
+                                  .level = level,
+                                  .tick = proc_state.system_time});
+}
+
+void replay_record_completion(const completion_message *msg) {
+  uint32_t now = proc_state.system_time;
+  uint32_t lag = now > msg->system_time ? now - msg->system_time : 0;
+  append(REPLAY_TIMER_THREAD,
+         (replay_record){.type = REPLAY_RECORD_COMPLETION,
+                         .lag = lag < UINT8_MAX ? (uint8_t)lag : UINT8_MAX,
+                         .tick = now,
+                         .a = msg->completed_task_id,
+                         .b = msg->job_arrival_time});
+}
+
+void replay_record_criticality(criticality_level level) {
+  append(REPLAY_TIMER_THREAD,
+         (replay_record){.type = REPLAY_RECORD_CRITICALITY,
+                         .level = level,
+                         .tick = proc_state.system_time});
+}
+
+void replay_record_skip(uint32_t from, uint32_t to) {
+  append(REPLAY_TIMER_THREAD, (replay_record){.type = REPLAY_RECORD_SKIP,
+                                              .tick = from,
+                                              .a = to});
+}
+
+static const replay_record *peek(uint8_t thread) {
+  replay_stream *s = &streams[thread];
+  if (s->diverged || s->next == s->count) {
+    return NULL;
+  }
+  return &s->records[s->next];
+}
+
+static void diverge(uint8_t thread) {
+  replay_stream *s = &streams[thread];
+  if (!s->diverged) {
+    s->diverged = true;
+    s->diverged_tick = proc_state.system_time;
+  }
+}
+
+bool replay_acet(uint8_t core_id, const job_struct *job, float *acet) {
+  const replay_record *rec = peek(core_id);
+  if (rec == NULL || rec->type != REPLAY_RECORD_ACET ||
+      rec->tick != job->arrival_time || rec->a != job->parent_task->id) {
+    diverge(core_id);
+    return false;
+  }
+
+  memcpy(acet, &rec->b, sizeof(*acet));
+  streams[core_id].next++;
+  return true;
+}
+
+bool replay_mode_change(uint8_t core_id, criticality_level *level) {
+  const replay_record *rec = peek(core_id);
+  if (rec == NULL || rec->type != REPLAY_RECORD_MODE_OBSERVED ||
+      rec->tick != proc_state.system_time) {
+    return false;
+  }
+
+  *level = rec->level;
+  streams[core_id].next++;
+  return true;
+}
+
+void replay_check_trigger(uint8_t core_id, criticality_level level) {
+  const replay_record *rec = peek(core_id);
+  if (rec == NULL || rec->type != REPLAY_RECORD_MODE_TRIGGERED ||
+      rec->tick != proc_state.system_time || rec->level != level) {
+    diverge(core_id);
+    return;
+  }
+  streams[core_id].next++;
+}
+
+bool replay_delivery(uint32_t tick, replay_record *rec) {
+  const replay_record *next = peek(REPLAY_TIMER_THREAD);
+  if (next == NULL || next->tick != tick ||
+      (next->type != REPLAY_RECORD_COMPLETION &&
+       next->type != REPLAY_RECORD_CRITICALITY)) {
+    return false;
+  }
+
+  *rec = *next;
+  streams[REPLAY_TIMER_THREAD].next++;
+  return true;
+}
+
+uint32_t replay_skip_target(uint32_t now) {
+  const replay_record *rec = peek(REPLAY_TIMER_THREAD);
+  if (rec == NULL || rec->type != REPLAY_RECORD_SKIP || rec->tick != now) {
+    return now;
+  }
+
+  streams[REPLAY_TIMER_THREAD].next++;
+  return rec->a;
+}
+
+bool replay_finished(uint32_t now) { return now >= end_tick; }
@@ -0,0 +1,194 @@
+#include "processor.h"
+#include "sys_config.h"
+#include "task_management.h"
+
+#include "lib/list.h"
+#include "lib/log.h"
+
+#include "scheduler/sched_calendar.h"
+#include "scheduler/sched_core.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct {
+  uint32_t tick;
+  uint32_t task_idx;
+} release_entry;
+
+typedef struct {
+  release_entry *entries;
+  uint32_t size;
+} release_heap;
+
+// Tasks are split by criticality level so the next arrival above the local
+// criticality level is a peek at a handful of heap roots. Each heap has room
+// for every task of the core.
+typedef struct {
+  release_heap heaps[MAX_CRITICALITY_LEVELS];
+  uint32_t *slot;
+  release_entry *block;
+} __attribute__((aligned(CACHE_LINE_SIZE_BYTES))) release_calendar;
+
+static release_calendar calendars[NUM_CORES_PER_PROC];
+
+// Ties are broken by task index so releases due on the same tick keep the
+// allocation order.
+static inline bool entry_before(const release_entry *a,
+                                const release_entry *b) {
+  return a->tick < b->tick || (a->tick == b->tick && a->task_idx < b->task_idx);
+}
+
+static inline void heap_place(release_calendar *cal, release_heap *heap,
+                              uint32_t pos, release_entry entry) {
+  heap->entries[pos] = entry;
+  cal->slot[entry.task_idx] = pos;
+}
+
+static void sift_up(release_calendar *cal, release_heap *heap, uint32_t pos) {
+  release_entry entry = heap->entries[pos];
+
+  while (pos > 0) {
+    uint32_t parent = (pos - 1) / 2;
+    if (!entry_before(&entry, &heap->entries[parent]))
+      break;
+    heap_place(cal, heap, pos, heap->entries[parent]);
+    pos = parent;
+  }
+  heap_place(cal, heap, pos, entry);
+}
+
+static void sift_down(release_calendar *cal, release_heap *heap,
+                      uint32_t pos) {
+  release_entry entry = heap->entries[pos];
+
+  for (;;) {
+    uint32_t child = 2 * pos + 1;
+    if (child >= heap->size)
+      break;
+    if (child + 1 < heap->size &&
+        entry_before(&heap->entries[child + 1], &heap->entries[child])) {
+      child++;
+    }
+    if (!entry_before(&heap->entries[child], &entry))
+      break;
+    heap_place(cal, heap, pos, heap->entries[child]);
+    pos = child;
+  }
+  heap_place(cal, heap, pos, entry);
+}
+
+static inline uint32_t next_multiple(uint32_t tick, uint32_t period) {
+  return ((tick + period - 1) / period) * period;
+}
+
+int release_calendar_init(uint8_t core_id) {
+  release_calendar *cal = &calendars[core_id];
+  const core_task_index *idx = &core_states[core_id].task_index;
+  uint32_t now = proc_state.system_time;
+
+  free(cal->block);
+  cal->block = malloc(sizeof(release_entry) * idx->count *
+                          MAX_CRITICALITY_LEVELS +
+                      sizeof(uint32_t) * idx->count + 1);
+  if (cal->block == NULL) {
+    LOG(LOG_LEVEL_FATAL, "Could not allocate the release calendar of core %u",
+        core_id);
+    return -1;
+  }
+
+  for (uint8_t c = 0; c < MAX_CRITICALITY_LEVELS; c++) {
+    cal->heaps[c].entries = cal->block + (size_t)idx->count * c;
+    cal->heaps[c].size = 0;
+  }
+  cal->slot =
+      (uint32_t *)(cal->block + (size_t)idx->count * MAX_CRITICALITY_LEVELS);
+
+  for (uint32_t i = 0; i < idx->count; i++) {
+    release_heap *heap = &cal->heaps[idx->task[i]->crit_level];
+    release_entry entry = {.tick = next_multiple(now, idx->period[i]),
+                           .task_idx = i};
+
+    heap_place(cal, heap, heap->size++, entry);
+    sift_up(cal, heap, heap->size - 1);
+  }
+
+  return 0;
+}
+
+uint32_t release_calendar_pop_due(uint8_t core_id, uint32_t now) {
+  release_calendar *cal = &calendars[core_id];
+  const core_task_index *idx = &core_states[core_id].task_index;
+
+  for (;;) {
+    release_heap *first = NULL;
+    for (uint8_t c = 0; c < MAX_CRITICALITY_LEVELS; c++) {
+      release_heap *heap = &cal->heaps[c];
+      if (heap->size > 0 && (first == NULL || entry_before(&heap->entries[0],
+                                                           &first->entries[0])))
+        first = heap;
+    }
+
+    if (first == NULL || first->entries[0].tick > now)
+      return RELEASE_CALENDAR_NONE;
+
+    release_entry *top = &first->entries[0];
+    uint32_t task_idx = top->task_idx;
+    uint32_t period = idx->period[task_idx];
+
+    if (top->tick < now) {
+      top->tick = next_multiple(now, period);
+      sift_down(cal, first, 0);
+      continue;
+    }
+
+    top->tick += period;
+    sift_down(cal, first, 0);
+    return task_idx;
+  }
+}
+
+bool release_calendar_skip(uint8_t core_id, uint32_t task_id, uint32_t tick) {
+  release_calendar *cal = &calendars[core_id];
+  const core_task_index *idx = &core_states[core_id].task_index;
+
+  for (uint32_t i = 0; i < idx->count; i++) {
+    if (idx->task[i]->id != task_id)
+      continue;
+
+    release_heap *heap = &cal->heaps[idx->task[i]->crit_level];
+    uint32_t pos = cal->slot[i];
+    if (heap->entries[pos].tick != tick)
+      return false;
+
+    heap->entries[pos].tick += idx->period[i];
+    sift_down(cal, heap, pos);
+    return true;
+  }
+
+  return false;
+}
+
+uint32_t release_calendar_next(uint8_t core_id, criticality_level min_crit) {
+  release_calendar *cal = &calendars[core_id];
+  core_state *cs = &core_states[core_id];
+  uint32_t now = proc_state.system_time;
+  uint32_t next = UINT32_MAX;
+
+  job_struct *pending;
+  list_for_each_entry(pending, &cs->pending_jobs_queue, link) {
+    if (pending->arrival_time > now) {
+      next = pending->arrival_time;
+      break;
+    }
+  }
+
+  for (uint8_t c = min_crit; c < MAX_CRITICALITY_LEVELS; c++) {
+    const release_heap *heap = &cal->heaps[c];
+    if (heap->size > 0 && heap->entries[0].tick < next) {
+      next = heap->entries[0].tick;
+    }
+  }
+
+  return next;
+}
@@ -2,16 +2,22 @@
 #include "lib/log.h"
 #include "lib/ring_buffer.h"
 
+#include "scheduler/sched_calendar.h"
 #include "scheduler/sched_core.h"
 #include "scheduler/sched_migration.h"
+#include "scheduler/sched_slack.h"
 #include "scheduler/sched_util.h"
 
+#include "fault.h"
 #include "ipc.h"
 #include "power_management.h"
 #include "processor.h"
+#include "replay.h"
+#include "sim_features.h"
 #include "sys_config.h"
 #include "task_alloc.h"
 #include "task_management.h"
+#include "tick_profile.h"
 
 #include <float.h>
 #include <stdatomic.h>
@@ -19,15 +25,15 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 core_state core_states[NUM_CORES_PER_PROC];
 
 core_summary core_summaries[NUM_CORES_PER_PROC];
 
-pthread_mutex_t core_summary_locks[NUM_CORES_PER_PROC];
-
-const task_struct *task_lookup[MAX_TASKS + 1];
+_Static_assert(sizeof(core_summary) == CACHE_LINE_SIZE_BYTES,
+               "a core summary fills one cache line");
 
 static void handle_job_completion(uint8_t core_id) {
   core_state *cs = &core_states[core_id];
@@ -41,84 +47,106 @@ static void handle_job_completion(uint8_t core_id) {
     return;
   }
 
-  LOG(LOG_LEVEL_INFO, "Job %d completed", completed_job->parent_task->id);
-
   completed_job->state = JOB_STATE_COMPLETED;
 
-  completion_message outgoing_msg = {
-      .completed_task_id = completed_job->parent_task->id,
-      .job_arrival_time = completed_job->arrival_time,
-      .system_time = proc_state.system_time};
+  // A corrupted result is caught by its checksum and never announced, so the
+  // job's other copies keep running.
+  if (fault_corrupts_completion(core_id)) {
+    LOG(LOG_LEVEL_WARN, "Job %d completed with a corrupted result",
+        completed_job->parent_task->id);
+    fault_job_lost(completed_job->parent_task, completed_job->arrival_time,
+                   completed_job->is_replica);
+  } else {
+    LOG(LOG_LEVEL_INFO, "Job %d completed", completed_job->parent_task->id);
+    cs->stats.jobs_completed++;
+
+    completion_message outgoing_msg = {
+        .completed_task_id = completed_job->parent_task->id,
+        .job_arrival_time = completed_job->arrival_time,
+        .system_time = proc_state.system_time};
 
-  ring_buffer_enqueue(&proc_state.outgoing_completion_msg_queue, &outgoing_msg);
+    ring_buffer_enqueue(&proc_state.outgoing_completion_msg_queue,
+                        &outgoing_msg);
+    fault_job_completed(&outgoing_msg);
+  }
 
   cs->running_job = NULL;
+  slack_engine_invalidate(core_id);
   UNLOCK_RQ(core_id);
 
   cs->is_idle = true;
   put_job_ref(completed_job, core_id);
 }
 
-static void remove_completed_jobs(uint8_t core_id) {
+static void remove_completed_job(uint8_t core_id,
+                                 const completion_message *msg) {
   core_state *cs = &core_states[core_id];
-  completion_message *incoming_msg;
+  job_struct *matched[JOB_QUEUE_CAPACITY];
+
+  uint32_t num_matched =
+      job_index_find(&cs->queued_jobs, msg->completed_task_id,
+                     msg->job_arrival_time, matched, JOB_QUEUE_CAPACITY);
+
+  for (uint32_t i = 0; i < num_matched; i++) {
+    job_struct *cur = matched[i];
+    cur->state = JOB_STATE_REMOVED;
+    LOG(LOG_LEVEL_INFO, "Removed %s job %d, Reclaimed %.2f ticks",
+        cur->queue == &cs->replica_queue ? "replica" : "ready",
+        msg->completed_task_id, cur->acet - cur->executed_time);
+    job_queue_remove(cur->queue, cur);
+    put_job_ref(cur, core_id);
+    slack_engine_invalidate(core_id);
+  }
+
+  if (cs->running_job != NULL &&
+      cs->running_job->parent_task->id == msg->completed_task_id) {
+    job_struct *running_job = cs->running_job;
+    LOG(LOG_LEVEL_INFO, "Preempting Job %d", running_job->parent_task->id);
+    cs->running_job = NULL;
+    running_job->state = JOB_STATE_REMOVED;
+    cs->is_idle = true;
+    LOG(LOG_LEVEL_INFO, "Removed running job %d, Reclaimed %.2f ticks",
+        msg->completed_task_id, running_job->acet - running_job->executed_time);
+    put_job_ref(running_job, core_id);
+    slack_engine_invalidate(core_id);
+  }
+}
+
+static void remove_completed_jobs(uint8_t core_id) {
   ring_buffer *incoming_queue = &proc_state.incoming_completion_msg_queue;
+  if (atomic_load(&incoming_queue->head) ==
+      atomic_load(&incoming_queue->tail)) {
+    return;
+  }
+
+  completion_message *incoming_msg;
+  LOCK_RQ(core_id);
   ring_buffer_iter_read_unsafe(incoming_queue, incoming_msg) {
-    LOCK_RQ(core_id);
-    job_struct *cur, *next;
-    list_for_each_entry_safe(cur, next, &cs->replica_queue, link) {
-      if (cur->parent_task->id == incoming_msg->completed_task_id &&
-          cur->arrival_time == incoming_msg->job_arrival_time) {
-        cur->state = JOB_STATE_REMOVED;
-        LOG(LOG_LEVEL_INFO, "Removed replica job %d, Reclaimed %.2f ticks",
-            incoming_msg->completed_task_id, cur->acet - cur->executed_time);
-        list_del(&cur->link);
-        put_job_ref(cur, core_id);
-      }
-    }
-    list_for_each_entry_safe(cur, next, &cs->ready_queue, link) {
-      if (cur->parent_task->id == incoming_msg->completed_task_id &&
-          cur->arrival_time == incoming_msg->job_arrival_time) {
-        cur->state = JOB_STATE_REMOVED;
-        LOG(LOG_LEVEL_INFO, "Removed ready job %d, Reclaimed %.2f ticks",
-            incoming_msg->completed_task_id, cur->acet - cur->executed_time);
-        list_del(&cur->link);
-        put_job_ref(cur, core_id);
-      }
-    }
+    remove_completed_job(core_id, incoming_msg);
+  }
+  UNLOCK_RQ(core_id);
+}
 
-    if (cs->running_job != NULL &&
-        cs->running_job->parent_task->id == incoming_msg->completed_task_id) {
-      job_struct *running_job = cs->running_job;
-      LOG(LOG_LEVEL_INFO, "Preempting Job %d", running_job->parent_task->id);
-      cs->running_job = NULL;
-      running_job->state = JOB_STATE_REMOVED;
-      cs->is_idle = true;
-      LOG(LOG_LEVEL_INFO, "Removed running job %d, Reclaimed %.2f ticks",
-          incoming_msg->completed_task_id,
-          running_job->acet - running_job->executed_time);
-      put_job_ref(running_job, core_id);
-    }
+static void filter_queue_for_mode_change(job_queue *queue, core_state *cs) {
+  job_struct *jobs[JOB_QUEUE_CAPACITY];
+  uint32_t num_jobs = 0;
 
-    UNLOCK_RQ(core_id);
+  while (!job_queue_empty(queue)) {
+    jobs[num_jobs++] = job_queue_pop(queue);
   }
-}
 
-static void filter_queue_for_mode_change(struct list_head *src_queue,
-                                         struct list_head *dest_queue,
-                                         core_state *cs) {
-  while (!list_empty(src_queue)) {
-    job_struct *job = pop_next_job(src_queue);
+  for (uint32_t i = 0; i < num_jobs; i++) {
+    job_struct *job = jobs[i];
     job->virtual_deadline =
-        job->arrival_time +
-        job->relative_tuned_deadlines[cs->local_criticality_level];
+        cs->policy->virtual_deadline(job, cs->local_criticality_level);
     job->wcet = (float)job->parent_task->wcet[cs->local_criticality_level];
 
-    if (job->parent_task->crit_level < cs->local_criticality_level &&
+    if (!cs->policy->keeps_after_mode_change(job,
+                                             cs->local_criticality_level) &&
         !atomic_load_explicit(&job->is_being_offered, memory_order_acquire)) {
-      add_to_queue_sorted(&cs->discard_list, job);
+      job_queue_push(&cs->discard_list, job);
     } else {
-      add_to_queue_sorted(dest_queue, job);
+      job_queue_push(queue, job);
     }
   }
 }
@@ -132,6 +160,7 @@ static void handle_mode_change(uint8_t core_id,
   cs->local_criticality_level = new_criticality_level;
 
   LOG(LOG_LEVEL_WARN, "Mode Change to %d", cs->local_criticality_level);
+  cs->stats.mode_changes++;
 
   LOCK_RQ(core_id);
 
@@ -142,20 +171,16 @@ static void handle_mode_change(uint8_t core_id,
     cs->is_idle = true;
 
     if (running_job->is_replica) {
-      add_to_queue_sorted(&cs->replica_queue, running_job);
+      job_queue_push(&cs->replica_queue, running_job);
     } else {
-      add_to_queue_sorted(&cs->ready_queue, running_job);
+      job_queue_push(&cs->ready_queue, running_job);
     }
   }
 
-  LIST_HEAD(new_ready_queue);
-  LIST_HEAD(new_replica_queue);
-
-  filter_queue_for_mode_change(&cs->ready_queue, &new_ready_queue, cs);
-  filter_queue_for_mode_change(&cs->replica_queue, &new_replica_queue, cs);
+  filter_queue_for_mode_change(&cs->ready_queue, cs);
+  filter_queue_for_mode_change(&cs->replica_queue, cs);
 
-  list_splice_init(&new_ready_queue, &cs->ready_queue);
-  list_splice_init(&new_replica_queue, &cs->replica_queue);
+  slack_engine_invalidate(core_id);
 
   UNLOCK_RQ(core_id);
 }
@@ -169,6 +194,7 @@ static void handle_job_arrivals(uint8_t core_id) {
       if (new_job->parent_task->crit_level < cs->local_criticality_level) {
         list_del(&new_job->link);
         put_job_ref(new_job, core_id);
+        slack_engine_invalidate(core_id);
       } else {
         LOG(LOG_LEVEL_ERROR, "Missed Pending Job %d Arrival!",
             new_job->parent_task->id);
@@ -181,11 +207,12 @@ static void handle_job_arrivals(uint8_t core_id) {
     }
 
     list_del(&new_job->link);
+    slack_engine_invalidate(core_id);
 
     new_job->state = JOB_STATE_READY;
+    new_job->arrival_time = proc_state.system_time;
     new_job->virtual_deadline =
-        proc_state.system_time +
-        new_job->relative_tuned_deadlines[cs->local_criticality_level];
+        cs->policy->virtual_deadline(new_job, cs->local_criticality_level);
     new_job->wcet =
         (float)new_job->parent_task->wcet[cs->local_criticality_level];
 
@@ -196,106 +223,81 @@ static void handle_job_arrivals(uint8_t core_id) {
         new_job->parent_task->id, new_job->actual_deadline,
         new_job->virtual_deadline, new_job->acet, new_job->wcet);
 
-    new_job->arrival_time = proc_state.system_time;
-
     LOCK_RQ(core_id);
     if (new_job->parent_task->crit_level < cs->local_criticality_level) {
-      add_to_queue_sorted(&cs->discard_list, new_job);
+      job_queue_push(&cs->discard_list, new_job);
     } else {
       cs->decision_point = true;
       if (new_job->is_replica) {
-        add_to_queue_sorted(&cs->replica_queue, new_job);
+        job_queue_push(&cs->replica_queue, new_job);
       } else {
-        add_to_queue_sorted(&cs->ready_queue, new_job);
+        job_queue_push(&cs->ready_queue, new_job);
       }
     }
     UNLOCK_RQ(core_id);
   }
 
-  for (uint32_t i = 0; i < ALLOCATION_MAP_SIZE; i++) {
-    const task_alloc_map *instance = &allocation_map[i];
-
-    if (instance->proc_id == cs->proc_id && instance->core_id == cs->core_id) {
-      const task_struct *task = find_task_by_id(instance->task_id);
-
-      if (!task || task->period == 0) {
-        continue;
-      }
+  delegated_job *dj, *tmp;
+  list_for_each_entry_safe(dj, tmp, &cs->delegated_job_queue, link) {
+    if (dj->arrival_tick >= proc_state.system_time)
+      break;
+    list_del(&dj->link);
+    release_delegation(dj, core_id);
+  }
 
-      if (proc_state.system_time % task->period != 0) {
-        continue;
-      }
+  const core_task_index *idx = &cs->task_index;
+  uint32_t i;
+  while ((i = release_calendar_pop_due(core_id, proc_state.system_time)) !=
+         RELEASE_CALENDAR_NONE) {
+    const task_struct *task = idx->task[i];
 
-      delegated_job *dj, *tmp;
-      bool delegated = false;
-      list_for_each_entry_safe(dj, tmp, &cs->delegated_job_queue, link) {
-        if (dj->arrival_tick < proc_state.system_time) {
-          list_del(&dj->link);
-          release_delegation(dj, core_id);
-          continue;
-        }
-        if (dj->task_id == task->id &&
-            dj->arrival_tick >= proc_state.system_time && dj->owned_by_remote) {
-          LOG(LOG_LEVEL_DEBUG,
-              "Skipping delegated arrival for Task %u (delegated until tick "
-              "%u)",
-              task->id, dj->arrival_tick);
-          delegated = true;
-          break;
-        }
-      }
-      if (delegated)
-        goto skip_arrival;
+    new_job = create_job(task, core_id);
+    if (new_job == NULL) {
+      continue;
+    }
 
-      new_job = create_job(task, core_id);
-      if (new_job == NULL) {
-        continue;
-      }
+    // update job parameters
+    new_job->arrival_time = proc_state.system_time;
+    for (uint8_t level = 0; level < MAX_CRITICALITY_LEVELS; level++) {
+      new_job->relative_tuned_deadlines[level] =
+          idx->tuned_deadlines[level][i];
+    }
+    new_job->actual_deadline =
+        proc_state.system_time + new_job->parent_task->deadline;
+    new_job->virtual_deadline =
+        cs->policy->virtual_deadline(new_job, cs->local_criticality_level);
+    new_job->wcet =
+        (float)new_job->parent_task->wcet[cs->local_criticality_level];
 
-      // update job parameters
-      new_job->arrival_time = proc_state.system_time;
-      for (uint8_t level = 0; level < MAX_CRITICALITY_LEVELS; level++) {
-        new_job->relative_tuned_deadlines[level] =
-            instance->tuned_deadlines[level];
-      }
-      new_job->actual_deadline =
-          proc_state.system_time + new_job->parent_task->deadline;
-      new_job->virtual_deadline =
-          proc_state.system_time +
-          instance->tuned_deadlines[cs->local_criticality_level];
-      new_job->wcet =
-          (float)new_job->parent_task->wcet[cs->local_criticality_level];
+    new_job->acet = generate_acet(new_job, core_id);
+    new_job->executed_time = 0;
+    cs->stats.jobs_released++;
 
-      new_job->acet = generate_acet(new_job);
-      new_job->executed_time = 0;
+    new_job->is_replica = idx->is_replica[i];
+    new_job->state = JOB_STATE_READY;
 
-      new_job->is_replica = (instance->task_type == Replica);
-      new_job->state = JOB_STATE_READY;
+    LOG(LOG_LEVEL_INFO,
+        "Job %d arrived with deadline (actual: %d, virtual: "
+        "%d) with ACET %.2f and "
+        "WCET %.2f",
+        new_job->parent_task->id, new_job->actual_deadline,
+        new_job->virtual_deadline, new_job->acet, new_job->wcet);
 
-      LOG(LOG_LEVEL_INFO,
-          "Job %d arrived with deadline (actual: %d, virtual: "
-          "%d) with ACET %.2f and "
-          "WCET %.2f",
-          new_job->parent_task->id, new_job->actual_deadline,
-          new_job->virtual_deadline, new_job->acet, new_job->wcet);
-
-      // in case of a job arrival where job's criticality is less than system
-      // criticality
-      LOCK_RQ(core_id);
-      if (new_job->parent_task->crit_level < cs->local_criticality_level) {
-        add_to_queue_sorted(&cs->discard_list, new_job);
+    // in case of a job arrival where job's criticality is less than system
+    // criticality
+    LOCK_RQ(core_id);
+    slack_engine_invalidate(core_id);
+    if (new_job->parent_task->crit_level < cs->local_criticality_level) {
+      job_queue_push(&cs->discard_list, new_job);
+    } else {
+      cs->decision_point = true;
+      if (new_job->is_replica) {
+        job_queue_push(&cs->replica_queue, new_job);
       } else {
-        cs->decision_point = true;
-        if (new_job->is_replica) {
-          add_to_queue_sorted(&cs->replica_queue, new_job);
-        } else {
-          add_to_queue_sorted(&cs->ready_queue, new_job);
-        }
+        job_queue_push(&cs->ready_queue, new_job);
       }
-      UNLOCK_RQ(core_id);
     }
-  skip_arrival:
-    continue;
+    UNLOCK_RQ(core_id);
   }
 }
 
@@ -311,6 +313,13 @@ static void handle_running_job(uint8_t core_id) {
   if (cs->running_job != NULL) {
     cs->running_job->executed_time += power_get_current_scaling_factor(core_id);
 
+    float power = power_get_relative_power(core_id);
+    cs->stats.energy += power;
+    if (cs->running_job->is_replica) {
+      cs->stats.replica_ticks++;
+      cs->stats.replica_energy += power;
+    }
+
     if (cs->running_job->state == JOB_STATE_RUNNING &&
         proc_state.system_time > cs->running_job->actual_deadline) {
 
@@ -318,6 +327,7 @@ static void handle_running_job(uint8_t core_id) {
       cs->running_job->state = JOB_STATE_COMPLETED;
       cs->running_job = NULL;
       cs->is_idle = true;
+      slack_engine_invalidate(core_id);
 
       uint32_t task_id = missed_job->parent_task->id;
       uint32_t deadline = missed_job->actual_deadline;
@@ -327,6 +337,7 @@ static void handle_running_job(uint8_t core_id) {
       UNLOCK_RQ(core_id);
 
       LOG(LOG_LEVEL_ERROR, "Job %d missed its deadline %d", task_id, deadline);
+      cs->stats.deadline_misses++;
       LOG(LOG_LEVEL_FATAL, "System Halted due to Deadline Miss");
       fputs("System Halted due to Deadline Miss\n", stderr);
       atomic_store(&core_fatal_shutdown_requested, 1);
@@ -357,6 +368,11 @@ static void handle_running_job(uint8_t core_id) {
   if (trigger_completion) {
     handle_job_completion(core_id);
   } else if (trigger_mode_change) {
+    if (replay_mode == REPLAY_RECORD) {
+      replay_record_mode_change(core_id, new_crit_level, true);
+    } else if (replay_mode == REPLAY_PLAY) {
+      replay_check_trigger(core_id, new_crit_level);
+    }
     ipc_broadcast_criticality_change(new_crit_level);
     handle_mode_change(core_id, new_crit_level);
   }
@@ -365,33 +381,22 @@ static void handle_running_job(uint8_t core_id) {
 static job_struct *select_next_job(uint8_t core_id) {
   core_state *cs = &core_states[core_id];
 
-  job_struct *next_job_candidate;
+  job_struct *next_job_candidate = NULL;
 
   LOCK_RQ(core_id);
-  if (!list_empty(&cs->ready_queue) && !list_empty(&cs->replica_queue)) {
-    job_struct *ready_job = peek_next_job(&cs->ready_queue);
-    job_struct *replica_job = peek_next_job(&cs->replica_queue);
-
-    if (ready_job->virtual_deadline <= replica_job->virtual_deadline) {
-      next_job_candidate = ready_job;
-    } else {
-      next_job_candidate = replica_job;
-    }
-  } else if (list_empty(&cs->ready_queue) == false) {
-    next_job_candidate = peek_next_job(&cs->ready_queue);
-  } else if (list_empty(&cs->replica_queue) == false) {
-    next_job_candidate = peek_next_job(&cs->replica_queue);
-  } else {
-    next_job_candidate = NULL;
+  job_struct *ready_job = job_queue_peek(&cs->ready_queue);
+  job_struct *replica_job = job_queue_peek(&cs->replica_queue);
+  if (ready_job != NULL || replica_job != NULL) {
+    next_job_candidate = cs->policy->select(ready_job, replica_job);
   }
 
   if (next_job_candidate != NULL &&
-      (cs->running_job == NULL || cs->running_job->virtual_deadline >
-                                      next_job_candidate->virtual_deadline)) {
+      (cs->running_job == NULL ||
+       cs->policy->preempts(next_job_candidate, cs->running_job))) {
     if (!next_job_candidate->is_replica) {
-      next_job_candidate = pop_next_job(&cs->ready_queue);
+      next_job_candidate = job_queue_pop(&cs->ready_queue);
     } else {
-      next_job_candidate = pop_next_job(&cs->replica_queue);
+      next_job_candidate = job_queue_pop(&cs->replica_queue);
     }
   } else {
     next_job_candidate = NULL;
@@ -410,11 +415,12 @@ static void dispatch_job(uint8_t core_id, job_struct *job_to_dispatch) {
     job_struct *current_job = cs->running_job;
     LOG(LOG_LEVEL_INFO, "Preempting Job %d", current_job->parent_task->id);
     current_job->state = JOB_STATE_READY;
+    cs->stats.preemptions++;
 
     if (current_job->is_replica) {
-      add_to_queue_sorted(&cs->replica_queue, current_job);
+      job_queue_push(&cs->replica_queue, current_job);
     } else {
-      add_to_queue_sorted(&cs->ready_queue, current_job);
+      job_queue_push(&cs->ready_queue, current_job);
     }
   }
 
@@ -431,18 +437,19 @@ static void reclaim_discarded_jobs(uint8_t core_id) {
   core_state *cs = &core_states[core_id];
 
   LOCK_RQ(core_id);
-  while (!list_empty(&cs->discard_list)) {
-    job_struct *discarded_job = pop_next_job(&cs->discard_list);
+  while (!job_queue_empty(&cs->discard_list)) {
+    job_struct *discarded_job = job_queue_pop(&cs->discard_list);
 
     if (is_admissible_locked(core_id, discarded_job, 0.0f)) {
       LOG(LOG_LEVEL_INFO,
           "Accommodating discarded job %d (Original Core ID: %u)",
           discarded_job->parent_task->id, discarded_job->job_pool_id);
       cs->decision_point = true;
+      slack_engine_invalidate(core_id);
       if (discarded_job->is_replica) {
-        add_to_queue_sorted(&cs->replica_queue, discarded_job);
+        job_queue_push(&cs->replica_queue, discarded_job);
       } else {
-        add_to_queue_sorted(&cs->ready_queue, discarded_job);
+        job_queue_push(&cs->ready_queue, discarded_job);
       }
     } else if (!atomic_load(&discarded_job->is_being_offered)) {
       pthread_mutex_lock(&proc_state.discard_queue_lock);
@@ -461,11 +468,12 @@ static void reclaim_discarded_jobs(uint8_t core_id) {
           cur->parent_task->id, cur->job_pool_id);
       cs->decision_point = true;
       list_del(&cur->link);
+      slack_engine_invalidate(core_id);
 
       if (cur->is_replica) {
-        add_to_queue_sorted(&cs->replica_queue, cur);
+        job_queue_push(&cs->replica_queue, cur);
       } else {
-        add_to_queue_sorted(&cs->ready_queue, cur);
+        job_queue_push(&cs->ready_queue, cur);
       }
     }
   }
@@ -474,6 +482,61 @@ static void reclaim_discarded_jobs(uint8_t core_id) {
   UNLOCK_RQ(core_id);
 }
 
+static bool is_core_instance(const core_state *cs,
+                             const task_alloc_map *instance) {
+  if (instance->proc_id != cs->proc_id || instance->core_id != cs->core_id)
+    return false;
+
+  const task_struct *task = find_task_by_id(instance->task_id);
+  return task && task->period != 0;
+}
+
+static int build_core_task_index(core_state *cs) {
+  core_task_index *idx = &cs->task_index;
+  idx->count = 0;
+
+  uint32_t capacity = 0;
+  for (uint32_t i = 0; i < allocation_map_size; i++) {
+    if (is_core_instance(cs, &allocation_map[i]))
+      capacity++;
+  }
+
+  // Pointers first, then the uint32 columns, then the flags, so every column
+  // stays aligned within the one block.
+  size_t words = (size_t)capacity * (1 + MAX_CRITICALITY_LEVELS);
+  char *block = malloc(capacity * sizeof(*idx->task) +
+                       words * sizeof(uint32_t) + capacity * sizeof(bool) + 1);
+  if (block == NULL) {
+    LOG(LOG_LEVEL_FATAL, "Could not allocate the task index of core %u",
+        cs->core_id);
+    return -1;
+  }
+
+  idx->task = (const task_struct **)block;
+  idx->period = (uint32_t *)(block + capacity * sizeof(*idx->task));
+  for (uint8_t level = 0; level < MAX_CRITICALITY_LEVELS; level++) {
+    idx->tuned_deadlines[level] = idx->period + capacity * (1 + level);
+  }
+  idx->is_replica = (bool *)(idx->period + words);
+
+  for (uint32_t i = 0; i < allocation_map_size; i++) {
+    const task_alloc_map *instance = &allocation_map[i];
+    if (!is_core_instance(cs, instance))
+      continue;
+
+    const task_struct *task = find_task_by_id(instance->task_id);
+    uint32_t n = idx->count++;
+    idx->task[n] = task;
+    idx->period[n] = task->period;
+    for (uint8_t level = 0; level < MAX_CRITICALITY_LEVELS; level++) {
+      idx->tuned_deadlines[level][n] = instance->tuned_deadlines[level];
+    }
+    idx->is_replica[n] = (instance->task_type == Replica);
+  }
+
+  return 0;
+}
+
 static inline void update_core_summary(uint8_t core_id) {
   core_state *cs = &core_states[core_id];
   core_summary *summary = &core_summaries[core_id];
@@ -483,25 +546,166 @@ static inline void update_core_summary(uint8_t core_id) {
       find_slack(core_id, cs->local_criticality_level, proc_state.system_time,
                  power_get_current_scaling_factor(core_id), NULL);
   uint32_t next_arrival = find_next_effective_arrival_time(core_id);
-  pthread_mutex_lock(&core_summary_locks[core_id]);
-  summary->util = utilization;
-  summary->slack = slack;
-  summary->is_idle = cs->is_idle;
-  summary->dvfs_level = cs->current_dvfs_level;
-  summary->next_arrival = next_arrival;
-  pthread_mutex_unlock(&core_summary_locks[core_id]);
+  seqlock_write_begin(&summary->seq);
+  atomic_store_explicit(&summary->util, utilization, memory_order_release);
+  atomic_store_explicit(&summary->slack, slack, memory_order_release);
+  atomic_store_explicit(&summary->is_idle, cs->is_idle, memory_order_release);
+  atomic_store_explicit(&summary->dvfs_level, cs->current_dvfs_level,
+                        memory_order_release);
+  atomic_store_explicit(&summary->next_arrival, next_arrival,
+                        memory_order_release);
+  seqlock_write_end(&summary->seq);
+}
+
+void core_summaries_snapshot(core_summary_snapshot snap[NUM_CORES_PER_PROC]) {
+  for (uint8_t i = 0; i < NUM_CORES_PER_PROC; i++) {
+    core_summary *summary = &core_summaries[i];
+    uint32_t seq;
+    do {
+      seq = seqlock_read_begin(&summary->seq);
+      snap[i].util = atomic_load_explicit(&summary->util, memory_order_acquire);
+      snap[i].slack =
+          atomic_load_explicit(&summary->slack, memory_order_acquire);
+      snap[i].next_arrival =
+          atomic_load_explicit(&summary->next_arrival, memory_order_acquire);
+      snap[i].is_idle =
+          atomic_load_explicit(&summary->is_idle, memory_order_acquire);
+      snap[i].dvfs_level =
+          atomic_load_explicit(&summary->dvfs_level, memory_order_acquire);
+    } while (seqlock_read_retry(&summary->seq, seq));
+  }
+}
+
+static void drop_lost_job(uint8_t core_id, job_struct *job) {
+  const core_state *cs = &core_states[core_id];
+  if (job->parent_task->crit_level >= cs->local_criticality_level) {
+    fault_job_lost(job->parent_task, job->arrival_time, job->is_replica);
+  }
+  job->state = JOB_STATE_REMOVED;
+  put_job_ref(job, core_id);
+}
+
+// A crash loses every job the core holds. Jobs it was offering elsewhere go
+// too; the core they were offered to finds them removed and lets them go.
+static void crash_core(uint8_t core_id) {
+  core_state *cs = &core_states[core_id];
+  LOG(LOG_LEVEL_WARN, "Core crashed");
+
+  LOCK_RQ(core_id);
+  if (cs->running_job != NULL) {
+    drop_lost_job(core_id, cs->running_job);
+    cs->running_job = NULL;
+  }
+  while (!job_queue_empty(&cs->ready_queue)) {
+    drop_lost_job(core_id, job_queue_pop(&cs->ready_queue));
+  }
+  while (!job_queue_empty(&cs->replica_queue)) {
+    drop_lost_job(core_id, job_queue_pop(&cs->replica_queue));
+  }
+  while (!job_queue_empty(&cs->discard_list)) {
+    job_struct *job = job_queue_pop(&cs->discard_list);
+    job->state = JOB_STATE_REMOVED;
+    put_job_ref(job, core_id);
+  }
+
+  job_struct *job, *next;
+  list_for_each_entry_safe(job, next, &cs->pending_jobs_queue, link) {
+    list_del(&job->link);
+    drop_lost_job(core_id, job);
+  }
+
+  cs->is_idle = true;
+  cs->decision_point = true;
+  cs->dpm_control_block.in_low_power_state = false;
+  slack_engine_invalidate(core_id);
+  UNLOCK_RQ(core_id);
+
+  // Marked idle, the core is no longer picked as a migration target.
+  update_core_summary(core_id);
+}
+
+// A crashed core keeps its place in the schedule: releases due while it is
+// down are lost, and offers made to it are turned down.
+static void tick_crashed_core(uint8_t core_id) {
+  core_state *cs = &core_states[core_id];
+
+  reject_migration_requests(core_id);
+  update_delegations(core_id);
+
+  delegated_job *dj, *tmp;
+  list_for_each_entry_safe(dj, tmp, &cs->delegated_job_queue, link) {
+    if (dj->arrival_tick >= proc_state.system_time)
+      break;
+    list_del(&dj->link);
+    release_delegation(dj, core_id);
+  }
+
+  const core_task_index *idx = &cs->task_index;
+  uint32_t i;
+  while ((i = release_calendar_pop_due(core_id, proc_state.system_time)) !=
+         RELEASE_CALENDAR_NONE) {
+    const task_struct *task = idx->task[i];
+    if (task->crit_level >= cs->local_criticality_level) {
+      fault_job_lost(task, proc_state.system_time, idx->is_replica[i]);
+    }
+  }
+}
+
+static void skip_step(uint8_t core_id) { (void)core_id; }
+
+static bool skip_procrastination(uint8_t core_id) {
+  (void)core_id;
+  return false;
+}
+
+static void migrate(uint8_t core_id) {
+  update_delegations(core_id);
+  attempt_migration_push(core_id);
+  process_migration_requests(core_id);
 }
 
-void scheduler_init(void) {
+static void scale_frequency(uint8_t core_id) {
+  if (core_states[core_id].decision_point) {
+    power_set_dvfs_level(core_id, calc_required_dvfs_level(core_id));
+  }
+}
+
+static void enter_low_power(uint8_t core_id) {
+  if (core_states[core_id].is_idle) {
+    uint32_t next_eff_arrival_time = find_next_effective_arrival_time(core_id);
+    power_management_set_dpm_interval(core_id, next_eff_arrival_time);
+  }
+}
+
+static tick_hooks select_tick_hooks(uint32_t features) {
+  return (tick_hooks){
+      .remove_completed =
+          features & FEATURE_ECC ? remove_completed_jobs : skip_step,
+      .migrate = features & FEATURE_MIGRATION ? migrate : skip_step,
+      .procrastinate = features & FEATURE_PROCRASTINATION
+                           ? power_management_try_procrastination
+                           : skip_procrastination,
+      .scale_frequency = features & FEATURE_DVFS ? scale_frequency : skip_step,
+      .enter_low_power = features & FEATURE_DPM ? enter_low_power : skip_step,
+  };
+}
+
+int scheduler_init(void) {
   LOG(LOG_LEVEL_INFO, "Initializing Scheduler...");
 
+  char features[64];
+  uint32_t unsupported = sched_policy_unsupported(scheduler_policy,
+                                                  sim_features);
+  if (unsupported != 0) {
+    features_format(unsupported, features, sizeof(features));
+    LOG(LOG_LEVEL_ERROR, "Policy %s cannot run with %s",
+        scheduler_policy->name, features);
+    return -1;
+  }
+
   task_management_init();
   power_management_init();
 
-  for (uint32_t i = 0; i < SYSTEM_TASKS_SIZE; i++) {
-    task_lookup[system_tasks[i].id] = &system_tasks[i];
-  }
-
   for (int i = 0; i < NUM_CORES_PER_PROC; i++) {
     core_states[i].proc_id = proc_state.processor_id;
     core_states[i].core_id = i;
@@ -509,9 +713,18 @@ void scheduler_init(void) {
     core_states[i].is_idle = true;
     core_states[i].current_dvfs_level = 0;
 
-    INIT_LIST_HEAD(&core_states[i].ready_queue);
-    INIT_LIST_HEAD(&core_states[i].replica_queue);
-    INIT_LIST_HEAD(&core_states[i].discard_list);
+    core_states[i].policy = scheduler_policy;
+    job_queue_init(&core_states[i].ready_queue);
+    job_queue_set_key(&core_states[i].ready_queue, scheduler_policy->job_key);
+    job_queue_init(&core_states[i].replica_queue);
+    job_queue_set_key(&core_states[i].replica_queue,
+                      scheduler_policy->job_key);
+    job_queue_init(&core_states[i].discard_list);
+    job_index_init(&core_states[i].queued_jobs);
+    job_queue_attach_index(&core_states[i].ready_queue,
+                           &core_states[i].queued_jobs);
+    job_queue_attach_index(&core_states[i].replica_queue,
+                           &core_states[i].queued_jobs);
     INIT_LIST_HEAD(&core_states[i].pending_jobs_queue);
     INIT_LIST_HEAD(&core_states[i].delegated_job_queue);
 
@@ -525,22 +738,65 @@ void scheduler_init(void) {
 
     core_states[i].local_criticality_level = 0;
     core_states[i].decision_point = false;
+    core_states[i].hooks = select_tick_hooks(sim_features);
+    if (build_core_task_index(&core_states[i]) != 0 ||
+        release_calendar_init(i) != 0) {
+      return -1;
+    }
     core_states[i].cached_slack_horizon = calculate_allocated_horizon(i);
+    slack_engine_init(i);
 
     pthread_mutex_init(&core_states[i].rq_lock, NULL);
 
-    core_summaries[i].util = 0.0f;
-    core_summaries[i].slack = 0.0f;
-    core_summaries[i].next_arrival = UINT32_MAX;
-    core_summaries[i].is_idle = true;
-    core_summaries[i].dvfs_level = 0;
-
-    pthread_mutex_init(&core_summary_locks[i], NULL);
+    seqlock_init(&core_summaries[i].seq);
+    atomic_init(&core_summaries[i].util, 0.0f);
+    atomic_init(&core_summaries[i].slack, 0.0f);
+    atomic_init(&core_summaries[i].next_arrival, UINT32_MAX);
+    atomic_init(&core_summaries[i].is_idle, true);
+    atomic_init(&core_summaries[i].dvfs_level, 0);
   }
 
   init_migration();
 
+  features_format(sim_features, features, sizeof(features));
+  LOG(LOG_LEVEL_INFO, "Scheduler features: %s", features);
+  LOG(LOG_LEVEL_INFO, "Scheduling policy: %s", scheduler_policy->name);
+
   LOG(LOG_LEVEL_INFO, "Scheduler Initialization Complete.");
+  return 0;
+}
+
+void scheduler_cleanup(void) {
+  for (int i = 0; i < NUM_CORES_PER_PROC; i++) {
+    pthread_mutex_destroy(&core_states[i].rq_lock);
+    free(core_states[i].task_index.task);
+    memset(&core_states[i], 0, sizeof(core_states[i]));
+  }
+}
+
+void scheduler_read_stats(core_stats *total) {
+  memset(total, 0, sizeof(*total));
+
+  for (int i = 0; i < NUM_CORES_PER_PROC; i++) {
+    const core_stats *s = &core_states[i].stats;
+    total->jobs_released += s->jobs_released;
+    total->jobs_completed += s->jobs_completed;
+    total->deadline_misses += s->deadline_misses;
+    total->mode_changes += s->mode_changes;
+    total->preemptions += s->preemptions;
+    total->migrations += s->migrations;
+    total->idle_ticks += s->idle_ticks;
+    total->low_power_ticks += s->low_power_ticks;
+    total->replica_ticks += s->replica_ticks;
+    total->energy += s->energy;
+    total->replica_energy += s->replica_energy;
+  }
+}
+
+void scheduler_skip_ticks(uint32_t ticks) {
+  for (int i = 0; i < NUM_CORES_PER_PROC; i++) {
+    core_states[i].stats.low_power_ticks += ticks;
+  }
 }
 
 static inline void log_core_state(uint8_t core_id) {
@@ -560,20 +816,39 @@ static inline void log_core_state(uint8_t core_id) {
 
   log_job_queue(LOG_LEVEL_DEBUG, "Ready Queue", &cs->ready_queue);
   log_job_queue(LOG_LEVEL_DEBUG, "Replica Queue", &cs->replica_queue);
-  log_job_queue(LOG_LEVEL_DEBUG, "Pending Jobs", &cs->pending_jobs_queue);
+  log_job_list(LOG_LEVEL_DEBUG, "Pending Jobs", &cs->pending_jobs_queue);
   UNLOCK_RQ(core_id);
 }
 
 void scheduler_tick(uint8_t core_id) {
   core_state *cs = &core_states[core_id];
+  TICK_PROFILE_BEGIN(phase_clock);
 
-#ifdef ENABLE_ECC
-  remove_completed_jobs(core_id);
-#endif
+  cs->hooks.remove_completed(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_ECC, phase_clock);
 
-  if (cs->local_criticality_level !=
-      atomic_load(&proc_state.system_criticality_level)) {
-    handle_mode_change(core_id, proc_state.system_criticality_level);
+  // A replay applies other cores' mode changes at the tick they were seen in
+  // the recording, not whenever this core happens to see them.
+  criticality_level level = atomic_load(&proc_state.system_criticality_level);
+  if (replay_mode == REPLAY_PLAY) {
+    if (replay_mode_change(core_id, &level)) {
+      handle_mode_change(core_id, level);
+    }
+  } else if (cs->local_criticality_level != level) {
+    if (replay_mode == REPLAY_RECORD) {
+      replay_record_mode_change(core_id, level, false);
+    }
+    handle_mode_change(core_id, level);
+  }
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_MODE_CHANGE, phase_clock);
+
+  fault_core_status status = fault_core_tick(core_id);
+  if (status != FAULT_CORE_UP) {
+    if (status == FAULT_CORE_CRASHED) {
+      crash_core(core_id);
+    }
+    tick_crashed_core(core_id);
+    return;
   }
 
   if (cs->dpm_control_block.in_low_power_state) {
@@ -582,21 +857,22 @@ void scheduler_tick(uint8_t core_id) {
       LOG(LOG_LEVEL_INFO, "Exiting low power state");
     } else {
       LOG(LOG_LEVEL_DEBUG, "Core in low power state");
+      cs->stats.low_power_ticks++;
       return;
     }
   }
 
   handle_running_job(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_RUNNING_JOB, phase_clock);
 
   handle_job_arrivals(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_ARRIVALS, phase_clock);
 
   reclaim_discarded_jobs(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_RECLAIM, phase_clock);
 
-#ifdef ENABLE_MIGRATION
-  update_delegations(core_id);
-  attempt_migration_push(core_id);
-  process_migration_requests(core_id);
-#endif
+  cs->hooks.migrate(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_MIGRATION, phase_clock);
 
   job_struct *next_job = select_next_job(core_id);
 
@@ -604,30 +880,23 @@ void scheduler_tick(uint8_t core_id) {
     cs->decision_point = true;
     dispatch_job(core_id, next_job);
   }
-
-#ifdef ENABLE_PROCRASTINATION
-  if (power_management_try_procrastination(core_id)) {
-    goto pmsp_skip;
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_SELECT, phase_clock);
+
+  bool procrastinating = cs->hooks.procrastinate(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_PROCRASTINATION, phase_clock);
+  if (!procrastinating) {
+    cs->hooks.scale_frequency(core_id);
+    TICK_PROFILE_LAP(core_id, TICK_PHASE_DVFS, phase_clock);
+    cs->hooks.enter_low_power(core_id);
+    TICK_PROFILE_LAP(core_id, TICK_PHASE_DPM, phase_clock);
   }
-#endif
 
-#ifdef ENABLE_DVFS
-  if (cs->decision_point) {
-    power_set_dvfs_level(core_id, calc_required_dvfs_level(core_id));
-  }
-#endif
-
-#ifdef ENABLE_DPM
   if (cs->is_idle) {
-    uint32_t next_eff_arrival_time = find_next_effective_arrival_time(core_id);
-    power_management_set_dpm_interval(core_id, next_eff_arrival_time);
+    cs->stats.idle_ticks++;
   }
-#endif
-
-#ifdef ENABLE_PROCRASTINATION
-pmsp_skip:
-#endif
   update_core_summary(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_SUMMARY, phase_clock);
 
   log_core_state(core_id);
+  TICK_PROFILE_LAP(core_id, TICK_PHASE_LOG, phase_clock);
 }
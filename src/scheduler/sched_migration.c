@@ -4,8 +4,10 @@
 #include "task_alloc.h"
 #include "task_management.h"
 
+#include "scheduler/sched_calendar.h"
 #include "scheduler/sched_core.h"
 #include "scheduler/sched_migration.h"
+#include "scheduler/sched_slack.h"
 #include "scheduler/sched_util.h"
 
 #include <math.h>
@@ -90,6 +92,12 @@ void update_delegations(uint8_t core_id) {
       if (dj->task_id == ack.task_id && dj->arrival_tick == ack.arrival_tick) {
         if (ack.accepted) {
           dj->owned_by_remote = true;
+          if (release_calendar_skip(core_id, dj->task_id, dj->arrival_tick)) {
+            LOG(LOG_LEVEL_DEBUG,
+                "Skipping delegated arrival for Task %u (delegated at tick "
+                "%u)",
+                dj->task_id, dj->arrival_tick);
+          }
         }
         break;
       }
@@ -121,35 +129,44 @@ static inline void double_rq_unlock(uint8_t a, uint8_t b) {
   }
 }
 
-static inline uint8_t find_best_core_for_migration(job_struct *job,
-                                                   uint8_t core_id) {
+// Picks from one snapshot for a whole selection pass. The slack a chosen
+// core gives up to the job is taken off its copy, so later candidates of the
+// pass do not pile onto the same core.
+static inline uint8_t
+find_best_core_for_migration(job_struct *job, uint8_t core_id,
+                             core_summary_snapshot *snap) {
   uint8_t best_core = core_id;
   float max_util = LIGHT_DONOR_UTIL_THRESHOLD;
 
   float demand = job->wcet - job->executed_time;
   for (uint8_t i = 0; i < NUM_CORES_PER_PROC; i++) {
-    core_summary *summary = &core_summaries[i];
-    pthread_mutex_lock(&core_summary_locks[i]);
+    const core_summary_snapshot *summary = &snap[i];
     if (summary->is_idle) {
-      pthread_mutex_unlock(&core_summary_locks[i]);
       continue;
     }
     if (summary->slack >= demand && summary->util > max_util) {
       max_util = summary->util;
       best_core = i;
     }
-    pthread_mutex_unlock(&core_summary_locks[i]);
   }
 
+  if (best_core != core_id) {
+    snap[best_core].slack -= demand;
+  }
   return best_core;
 }
 
-static inline void try_offload_jobs_from_queue(struct list_head *queue,
-                                               uint8_t core_id) {
+static inline void try_offload_jobs_from_queue(job_queue *queue,
+                                               uint8_t core_id,
+                                               core_summary_snapshot *snap) {
 
-  job_struct *job;
+  // In key order, so the jobs that run first get the first pick of the other
+  // cores' slack.
+  job_struct *jobs[JOB_QUEUE_CAPACITY];
+  uint32_t count = job_queue_sorted(queue, jobs);
 
-  list_for_each_entry(job, queue, link) {
+  for (uint32_t i = 0; i < count; i++) {
+    job_struct *job = jobs[i];
 
     if (!is_migration_profitable(job, proc_state.system_time)) {
       continue;
@@ -159,7 +176,7 @@ static inline void try_offload_jobs_from_queue(struct list_head *queue,
       continue;
     }
 
-    uint8_t dest_core_id = find_best_core_for_migration(job, core_id);
+    uint8_t dest_core_id = find_best_core_for_migration(job, core_id, snap);
 
     if (dest_core_id == core_id) {
       atomic_store_explicit(&job->is_being_offered, false,
@@ -176,104 +193,99 @@ static inline void try_offload_jobs_from_queue(struct list_head *queue,
   }
 }
 
-static inline void attempt_rq_load_shedding(uint8_t core_id) {
+static inline void attempt_rq_load_shedding(uint8_t core_id,
+                                            core_summary_snapshot *snap) {
   core_state *cs = &core_states[core_id];
 
   LOCK_RQ(core_id);
-  try_offload_jobs_from_queue(&cs->ready_queue, core_id);
-  try_offload_jobs_from_queue(&cs->replica_queue, core_id);
+  try_offload_jobs_from_queue(&cs->ready_queue, core_id, snap);
+  try_offload_jobs_from_queue(&cs->replica_queue, core_id, snap);
   UNLOCK_RQ(core_id);
 }
 
-static inline void attempt_future_load_shedding(uint8_t core_id) {
+static inline void attempt_future_load_shedding(uint8_t core_id,
+                                                core_summary_snapshot *snap) {
   core_state *cs = &core_states[core_id];
-  for (uint32_t i = 0; i < ALLOCATION_MAP_SIZE; i++) {
-    const task_alloc_map *instance = &allocation_map[i];
+  const core_task_index *idx = &cs->task_index;
+  for (uint32_t i = 0; i < idx->count; i++) {
+    const task_struct *task = idx->task[i];
 
-    if (instance->proc_id == cs->proc_id && instance->core_id == cs->core_id) {
-      const task_struct *task = find_task_by_id(instance->task_id);
+    if ((float)task->wcet[cs->local_criticality_level] <
+        MIN_MIGRATION_BENEFIT_THRESHOLD) {
+      continue;
+    }
 
-      if (task == NULL) {
-        continue;
-      }
+    uint32_t arrival_time =
+        ((proc_state.system_time / idx->period[i]) + 1) * idx->period[i];
 
-      if ((float)task->wcet[cs->local_criticality_level] <
-          MIN_MIGRATION_BENEFIT_THRESHOLD) {
-        continue;
-      }
-
-      uint32_t arrival_time =
-          ((proc_state.system_time / task->period) + 1) * task->period;
+    if (arrival_time >=
+        proc_state.system_time + DPM_MIGRATION_LOOKAHEAD_TICKS) {
+      continue;
+    }
 
-      if (arrival_time >=
-          proc_state.system_time + DPM_MIGRATION_LOOKAHEAD_TICKS) {
-        continue;
+    delegated_job *dj;
+    list_for_each_entry(dj, &cs->delegated_job_queue, link) {
+      if (dj->task_id == task->id && dj->arrival_tick == arrival_time) {
+        goto skip;
       }
-
-      delegated_job *dj;
-      list_for_each_entry(dj, &cs->delegated_job_queue, link) {
-        if (dj->task_id == task->id && dj->arrival_tick == arrival_time) {
-          goto skip;
-        }
-        if (dj->arrival_tick > arrival_time) {
-          break;
-        }
+      if (dj->arrival_tick > arrival_time) {
+        break;
       }
+    }
 
-      job_struct *new_job = create_job(task, core_id);
-      if (new_job == NULL) {
-        continue;
-      }
+    job_struct *new_job = create_job(task, core_id);
+    if (new_job == NULL) {
+      continue;
+    }
 
-      new_job->arrival_time = arrival_time;
+    new_job->arrival_time = arrival_time;
 
-      for (uint8_t level = 0; level < MAX_CRITICALITY_LEVELS; level++) {
-        new_job->relative_tuned_deadlines[level] =
-            instance->tuned_deadlines[level];
-      }
-      new_job->actual_deadline = arrival_time + new_job->parent_task->deadline;
-      new_job->virtual_deadline =
-          new_job->arrival_time +
-          new_job->relative_tuned_deadlines[cs->local_criticality_level];
-      new_job->acet = generate_acet(new_job);
-      new_job->wcet =
-          (float)new_job->parent_task->wcet[cs->local_criticality_level];
-      new_job->executed_time = 0;
-
-      new_job->is_replica = (instance->task_type == Replica);
-      new_job->state = JOB_STATE_IDLE;
-
-      uint8_t best_core_id = find_best_core_for_migration(new_job, core_id);
-      if (best_core_id == core_id) {
-        put_job_ref(new_job, core_id);
-        continue;
-      }
+    for (uint8_t level = 0; level < MAX_CRITICALITY_LEVELS; level++) {
+      new_job->relative_tuned_deadlines[level] =
+          idx->tuned_deadlines[level][i];
+    }
+    new_job->actual_deadline = arrival_time + new_job->parent_task->deadline;
+    new_job->virtual_deadline =
+        cs->policy->virtual_deadline(new_job, cs->local_criticality_level);
+    new_job->acet = generate_acet(new_job, core_id);
+    new_job->wcet =
+        (float)new_job->parent_task->wcet[cs->local_criticality_level];
+    new_job->executed_time = 0;
+
+    new_job->is_replica = idx->is_replica[i];
+    new_job->state = JOB_STATE_IDLE;
+
+    uint8_t best_core_id =
+        find_best_core_for_migration(new_job, core_id, snap);
+    if (best_core_id == core_id) {
+      put_job_ref(new_job, core_id);
+      continue;
+    }
 
-      delegated_job *new_dj = create_delegation(core_id);
-      if (new_dj == NULL) {
-        LOG(LOG_LEVEL_WARN,
-            "Failed to create delegation for future job %d, pool empty",
-            new_job->parent_task->id);
-        put_job_ref(new_job, core_id);
-        continue;
-      }
-      new_dj->task_id = task->id;
-      new_dj->arrival_tick = arrival_time;
-      new_dj->owned_by_remote = false;
+    delegated_job *new_dj = create_delegation(core_id);
+    if (new_dj == NULL) {
+      LOG(LOG_LEVEL_WARN,
+          "Failed to create delegation for future job %d, pool empty",
+          new_job->parent_task->id);
+      put_job_ref(new_job, core_id);
+      continue;
+    }
+    new_dj->task_id = task->id;
+    new_dj->arrival_tick = arrival_time;
+    new_dj->owned_by_remote = false;
 
-      add_delegation_sorted(new_dj, core_id);
+    add_delegation_sorted(new_dj, core_id);
 
-      migration_request mig_req = {.job = new_job, .from_core = core_id};
+    migration_request mig_req = {.job = new_job, .from_core = core_id};
 
-      ring_buffer_enqueue(&core_states[best_core_id].migration_request_queue,
-                          &mig_req);
+    ring_buffer_enqueue(&core_states[best_core_id].migration_request_queue,
+                        &mig_req);
 
-      cs->next_migration_eligible_tick =
-          proc_state.system_time + CORE_MIGRATION_COOLDOWN_TICKS;
+    cs->next_migration_eligible_tick =
+        proc_state.system_time + CORE_MIGRATION_COOLDOWN_TICKS;
 
-      LOG(LOG_LEVEL_INFO, "Offering future job %d arriving at %d",
-          new_job->parent_task->id, new_job->arrival_time);
-    }
+    LOG(LOG_LEVEL_INFO, "Offering future job %d arriving at %d",
+        new_job->parent_task->id, new_job->arrival_time);
   skip:
     continue;
   }
@@ -291,15 +303,19 @@ void attempt_migration_push(uint8_t core_id) {
     bool is_about_to_become_idle = false;
 
     LOCK_RQ(core_id);
-    if (list_empty(&cs->ready_queue) && list_empty(&cs->replica_queue)) {
+    if (job_queue_empty(&cs->ready_queue) &&
+        job_queue_empty(&cs->replica_queue)) {
       is_about_to_become_idle = true;
     }
     UNLOCK_RQ(core_id);
 
+    core_summary_snapshot snap[NUM_CORES_PER_PROC];
+    core_summaries_snapshot(snap);
+
     if (is_about_to_become_idle) {
-      attempt_future_load_shedding(core_id);
+      attempt_future_load_shedding(core_id, snap);
     } else {
-      attempt_rq_load_shedding(core_id);
+      attempt_rq_load_shedding(core_id, snap);
     }
     return;
   }
@@ -334,14 +350,14 @@ void process_migration_requests(uint8_t core_id) {
         job_to_migrate->arrival_time > proc_state.system_time) {
 
       add_to_queue_sorted_by_arrival(&cs->pending_jobs_queue, job_to_migrate);
+      slack_engine_invalidate(core_id);
 
       delegation_ack ack = {.task_id = job_to_migrate->parent_task->id,
                             .arrival_tick = job_to_migrate->arrival_time,
                             .accepted = true};
 
-      job_to_migrate->virtual_deadline =
-          job_to_migrate->arrival_time +
-          job_to_migrate->relative_tuned_deadlines[cs->local_criticality_level];
+      job_to_migrate->virtual_deadline = cs->policy->virtual_deadline(
+          job_to_migrate, cs->local_criticality_level);
       job_to_migrate->wcet =
           (float)job_to_migrate->parent_task->wcet[cs->local_criticality_level];
 
@@ -352,6 +368,7 @@ void process_migration_requests(uint8_t core_id) {
 
       LOG(LOG_LEVEL_INFO, "Migrated future job %d from core %d to core %d",
           job_to_migrate->parent_task->id, from_core, core_id);
+      cs->stats.migrations++;
       job_to_migrate->next_migration_eligible_tick =
           proc_state.system_time + JOB_MIGRATION_COOLDOWN_TICKS;
 
@@ -359,10 +376,11 @@ void process_migration_requests(uint8_t core_id) {
       continue;
     }
 
-    if (job_to_migrate->link.prev != NULL &&
-        job_to_migrate->link.next != NULL &&
+    if (job_to_migrate->queue != NULL &&
         job_to_migrate->state == JOB_STATE_READY) {
-      list_del(&job_to_migrate->link);
+      job_queue_remove(job_to_migrate->queue, job_to_migrate);
+      slack_engine_invalidate(from_core);
+      slack_engine_invalidate(core_id);
     } else {
       atomic_store_explicit(&job_to_migrate->is_being_offered, false,
                             memory_order_release);
@@ -372,18 +390,18 @@ void process_migration_requests(uint8_t core_id) {
       continue;
     }
 
-    job_to_migrate->virtual_deadline =
-        job_to_migrate->arrival_time +
-        job_to_migrate->relative_tuned_deadlines[cs->local_criticality_level];
+    job_to_migrate->virtual_deadline = cs->policy->virtual_deadline(
+        job_to_migrate, cs->local_criticality_level);
     job_to_migrate->wcet =
         (float)job_to_migrate->parent_task->wcet[cs->local_criticality_level];
 
-    if (job_to_migrate->parent_task->crit_level < cs->local_criticality_level) {
-      add_to_queue_sorted(&cs->discard_list, job_to_migrate);
+    if (!cs->policy->keeps_after_mode_change(job_to_migrate,
+                                             cs->local_criticality_level)) {
+      job_queue_push(&cs->discard_list, job_to_migrate);
     } else if (job_to_migrate->is_replica) {
-      add_to_queue_sorted(&cs->replica_queue, job_to_migrate);
+      job_queue_push(&cs->replica_queue, job_to_migrate);
     } else {
-      add_to_queue_sorted(&cs->ready_queue, job_to_migrate);
+      job_queue_push(&cs->ready_queue, job_to_migrate);
     }
 
     double_rq_unlock(core_id, from_core);
@@ -395,7 +413,18 @@ void process_migration_requests(uint8_t core_id) {
 
     LOG(LOG_LEVEL_INFO, "Migrated job %d from core %d to core %d",
         job_to_migrate->parent_task->id, from_core, core_id);
+    cs->stats.migrations++;
     job_to_migrate->next_migration_eligible_tick =
         proc_state.system_time + JOB_MIGRATION_COOLDOWN_TICKS;
   }
 }
+
+void reject_migration_requests(uint8_t core_id) {
+  migration_request mig_req;
+  while (ring_buffer_try_dequeue(&core_states[core_id].migration_request_queue,
+                                 &mig_req) == 0) {
+    atomic_store_explicit(&mig_req.job->is_being_offered, false,
+                          memory_order_release);
+    put_job_ref(mig_req.job, core_id);
+  }
+}
@@ -0,0 +1,116 @@
+#include "scheduler/sched_policy.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// Fixed-point steps per tick when remaining budget is folded into a key.
+#define LAXITY_KEY_SCALE 256.0f
+
+const sched_policy *scheduler_policy = &sched_policy_edf_vd;
+
+static uint32_t tuned_virtual_deadline(const job_struct *job,
+                                       criticality_level level) {
+  return job->arrival_time + job->relative_tuned_deadlines[level];
+}
+
+static uint32_t actual_deadline(const job_struct *job,
+                                criticality_level level) {
+  (void)level;
+  return job->arrival_time + job->parent_task->deadline;
+}
+
+static job_struct *select_lowest_key(job_struct *ready, job_struct *replica) {
+  if (ready == NULL) {
+    return replica;
+  }
+  if (replica == NULL || ready->queue_key <= replica->queue_key) {
+    return ready;
+  }
+  return replica;
+}
+
+static bool keeps_current_criticality(const job_struct *job,
+                                      criticality_level level) {
+  return job->parent_task->crit_level >= level;
+}
+
+static bool earlier_virtual_deadline(const job_struct *candidate,
+                                     const job_struct *running) {
+  return candidate->virtual_deadline < running->virtual_deadline;
+}
+
+static uint64_t edf_vd_key(const job_struct *job) {
+  return job->virtual_deadline;
+}
+
+const sched_policy sched_policy_edf_vd = {
+    .name = "edf-vd",
+    .virtual_deadline = tuned_virtual_deadline,
+    .job_key = edf_vd_key,
+    .select = select_lowest_key,
+    .preempts = earlier_virtual_deadline,
+    .keeps_after_mode_change = keeps_current_criticality,
+};
+
+// Deadline monotonic priority, task id breaking ties, so a task's jobs and
+// replicas always share one priority.
+static uint64_t fp_key(const job_struct *job) {
+  return (uint64_t)job->parent_task->deadline << 32 | job->parent_task->id;
+}
+
+static bool higher_priority(const job_struct *candidate,
+                            const job_struct *running) {
+  return fp_key(candidate) < fp_key(running);
+}
+
+const sched_policy sched_policy_fp_amc = {
+    .name = "fp-amc",
+    .virtual_deadline = actual_deadline,
+    .job_key = fp_key,
+    .select = select_lowest_key,
+    .preempts = higher_priority,
+    .keeps_after_mode_change = keeps_current_criticality,
+    .unsupported_features =
+        FEATURE_DVFS | FEATURE_PROCRASTINATION | FEATURE_MIGRATION,
+};
+
+// Among equal virtual deadlines the job with more budget left has the least
+// laxity. Laxity alone never preempts, so equal deadlines do not thrash.
+static uint64_t edf_llf_key(const job_struct *job) {
+  float remaining = job->wcet - job->executed_time;
+  uint32_t budget = 0;
+  if (remaining > 0.0f) {
+    float scaled = remaining * LAXITY_KEY_SCALE;
+    budget = scaled < (float)UINT32_MAX ? (uint32_t)scaled : UINT32_MAX;
+  }
+  return (uint64_t)job->virtual_deadline << 32 | (UINT32_MAX - budget);
+}
+
+const sched_policy sched_policy_edf_llf = {
+    .name = "edf-llf",
+    .virtual_deadline = tuned_virtual_deadline,
+    .job_key = edf_llf_key,
+    .select = select_lowest_key,
+    .preempts = earlier_virtual_deadline,
+    .keeps_after_mode_change = keeps_current_criticality,
+};
+
+const sched_policy *sched_policy_find(const char *name) {
+  static const sched_policy *policies[] = {
+      &sched_policy_edf_vd,
+      &sched_policy_fp_amc,
+      &sched_policy_edf_llf,
+  };
+
+  for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+    if (strcmp(policies[i]->name, name) == 0) {
+      return policies[i];
+    }
+  }
+  return NULL;
+}
+
+uint32_t sched_policy_unsupported(const sched_policy *policy,
+                                  uint32_t features) {
+  return features & policy->unsupported_features;
+}
@@ -0,0 +1,321 @@
+#include "power_management.h"
+#include "processor.h"
+#include "sys_config.h"
+#include "task_management.h"
+
+#include "lib/list.h"
+
+#include "scheduler/sched_core.h"
+#include "scheduler/sched_slack.h"
+#include "scheduler/sched_util.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define SLACK_MAX_EVENTS (MAX_DEADLINES * 2)
+#define SLACK_NO_POINT INT32_MAX
+
+// A job or periodic release contributing demand at `deadline`. Only events
+// with is_point set are deadlines at which slack is evaluated; the others
+// (jobs already past their virtual deadline, periodic releases beyond the
+// horizon) only add to the demand of later points.
+typedef struct {
+  uint32_t deadline;
+  float remaining;
+  bool is_point;
+} slack_event;
+
+// Cumulative demand at each key of a timeline for one DVFS level, plus prefix
+// and suffix minima of (key - demand) over the keys that are points.
+typedef struct {
+  int32_t demand[MAX_DEADLINES];
+  int32_t prefix_min[MAX_DEADLINES];
+  int32_t suffix_min[MAX_DEADLINES];
+  bool built;
+} slack_table;
+
+typedef struct {
+  slack_event events[SLACK_MAX_EVENTS];
+  uint32_t num_events;
+
+  uint32_t keys[MAX_DEADLINES];
+  bool is_point[MAX_DEADLINES];
+  uint32_t num_keys;
+
+  // Periodic releases are only counted up to here.
+  uint32_t demand_limit;
+
+  bool built;
+  bool overflow;
+
+  slack_table tables[NUM_DVFS_LEVELS];
+} slack_timeline;
+
+// Other cores mark the engine stale when they move its core's jobs, so the
+// flag has a line to itself.
+typedef struct {
+  _Atomic bool stale;
+  uint32_t built_tick __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
+  slack_timeline timelines[MAX_CRITICALITY_LEVELS];
+} slack_engine;
+
+static slack_engine slack_engines[NUM_CORES_PER_PROC];
+
+static int cmp_slack_event(const void *a, const void *b) {
+  uint32_t x = ((const slack_event *)a)->deadline;
+  uint32_t y = ((const slack_event *)b)->deadline;
+  return (x > y) - (x < y);
+}
+
+static inline int32_t scaled_demand(float remaining, float scaling_factor) {
+  return (int32_t)fmaxf(0.0f, ceilf(remaining / scaling_factor));
+}
+
+static inline uint8_t dvfs_level_of(float scaling_factor) {
+  for (uint8_t i = 0; i < NUM_DVFS_LEVELS; i++) {
+    if (fabsf(dvfs_levels[i].scaling_factor - scaling_factor) < FLT_EPSILON) {
+      return i;
+    }
+  }
+  return NUM_DVFS_LEVELS;
+}
+
+static inline uint32_t lower_bound(const uint32_t *keys, uint32_t n,
+                                   uint32_t value) {
+  uint32_t lo = 0;
+  uint32_t hi = n;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (keys[mid] < value) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static inline void push_event(slack_timeline *tl, uint32_t deadline,
+                              float remaining, bool is_point) {
+  if (tl->num_events >= SLACK_MAX_EVENTS) {
+    tl->overflow = true;
+    return;
+  }
+  tl->events[tl->num_events++] = (slack_event){
+      .deadline = deadline, .remaining = remaining, .is_point = is_point};
+}
+
+static inline void push_job_event(slack_timeline *tl, const job_struct *job,
+                                  criticality_level crit_lvl, uint32_t tstart) {
+  uint32_t d = job->arrival_time + job->relative_tuned_deadlines[crit_lvl];
+  float remaining =
+      (float)job->parent_task->wcet[crit_lvl] - job->executed_time;
+  push_event(tl, d, remaining, d > tstart);
+}
+
+static void build_timeline(uint8_t core_id, criticality_level crit_lvl,
+                           slack_timeline *tl, uint32_t tstart) {
+  core_state *cs = &core_states[core_id];
+
+  tl->num_events = 0;
+  tl->num_keys = 0;
+  tl->overflow = false;
+  tl->built = true;
+  for (uint8_t k = 0; k < NUM_DVFS_LEVELS; k++) {
+    tl->tables[k].built = false;
+  }
+
+  uint32_t limit = tstart + calculate_horizon(core_id);
+
+  job_struct *job;
+  if (cs->running_job) {
+    push_job_event(tl, cs->running_job, crit_lvl, tstart);
+  }
+  job_queue_for_each(job, &cs->ready_queue) {
+    push_job_event(tl, job, crit_lvl, tstart);
+  }
+  job_queue_for_each(job, &cs->replica_queue) {
+    push_job_event(tl, job, crit_lvl, tstart);
+  }
+  list_for_each_entry(job, &cs->pending_jobs_queue, link) {
+    push_job_event(tl, job, crit_lvl, tstart);
+  }
+
+  // Job deadlines past the horizon are still evaluated, so periodic releases
+  // up to the latest of them must be counted in their demand.
+  uint32_t demand_limit = limit;
+  for (uint32_t i = 0; i < tl->num_events; i++) {
+    if (tl->events[i].deadline > demand_limit) {
+      demand_limit = tl->events[i].deadline;
+    }
+  }
+  tl->demand_limit = demand_limit;
+
+  const core_task_index *idx = &cs->task_index;
+  for (uint32_t i = 0; i < idx->count && !tl->overflow; i++) {
+    const task_struct *task = idx->task[i];
+    if (task->crit_level < crit_lvl)
+      continue;
+
+    uint32_t period = idx->period[i];
+    uint32_t tuned_dl = idx->tuned_deadlines[crit_lvl][i];
+    float wcet = (float)task->wcet[crit_lvl];
+
+    for (uint32_t arrival = (tstart / period + 1) * period;
+         arrival + tuned_dl <= demand_limit && !tl->overflow;
+         arrival += period) {
+      push_event(tl, arrival + tuned_dl, wcet, arrival + tuned_dl <= limit);
+    }
+  }
+
+  if (tl->overflow)
+    return;
+
+  qsort(tl->events, tl->num_events, sizeof(slack_event), cmp_slack_event);
+
+  for (uint32_t i = 0; i < tl->num_events; i++) {
+    const slack_event *ev = &tl->events[i];
+    if (tl->num_keys == 0 || tl->keys[tl->num_keys - 1] != ev->deadline) {
+      if (tl->num_keys >= MAX_DEADLINES) {
+        tl->overflow = true;
+        return;
+      }
+      tl->keys[tl->num_keys] = ev->deadline;
+      tl->is_point[tl->num_keys] = false;
+      tl->num_keys++;
+    }
+    if (ev->is_point) {
+      tl->is_point[tl->num_keys - 1] = true;
+    }
+  }
+}
+
+static void build_table(const slack_timeline *tl, slack_table *tbl,
+                        float scaling_factor) {
+  int32_t demand = 0;
+  uint32_t key = 0;
+
+  for (uint32_t i = 0; i < tl->num_events; i++) {
+    demand += scaled_demand(tl->events[i].remaining, scaling_factor);
+    if (i + 1 == tl->num_events ||
+        tl->events[i + 1].deadline != tl->events[i].deadline) {
+      tbl->demand[key++] = demand;
+    }
+  }
+
+  int32_t running_min = SLACK_NO_POINT;
+  for (uint32_t i = 0; i < tl->num_keys; i++) {
+    if (tl->is_point[i]) {
+      int32_t value = (int32_t)tl->keys[i] - tbl->demand[i];
+      if (value < running_min)
+        running_min = value;
+    }
+    tbl->prefix_min[i] = running_min;
+  }
+
+  running_min = SLACK_NO_POINT;
+  for (uint32_t i = tl->num_keys; i-- > 0;) {
+    if (tl->is_point[i]) {
+      int32_t value = (int32_t)tl->keys[i] - tbl->demand[i];
+      if (value < running_min)
+        running_min = value;
+    }
+    tbl->suffix_min[i] = running_min;
+  }
+
+  tbl->built = true;
+}
+
+void slack_engine_init(uint8_t core_id) {
+  slack_engine *engine = &slack_engines[core_id];
+
+  atomic_store(&engine->stale, true);
+  engine->built_tick = 0;
+  for (uint8_t c = 0; c < MAX_CRITICALITY_LEVELS; c++) {
+    engine->timelines[c].built = false;
+  }
+}
+
+void slack_engine_invalidate(uint8_t core_id) {
+  atomic_store_explicit(&slack_engines[core_id].stale, true,
+                        memory_order_release);
+}
+
+bool slack_engine_query(uint8_t core_id, criticality_level crit_lvl,
+                        uint32_t tstart, float scaling_factor,
+                        const job_struct *extra_job, float *slack) {
+  uint8_t dvfs_idx = dvfs_level_of(scaling_factor);
+  if (dvfs_idx >= NUM_DVFS_LEVELS || tstart != proc_state.system_time) {
+    return false;
+  }
+
+  slack_engine *engine = &slack_engines[core_id];
+
+  if (atomic_exchange_explicit(&engine->stale, false, memory_order_acq_rel) ||
+      engine->built_tick != tstart) {
+    engine->built_tick = tstart;
+    for (uint8_t c = 0; c < MAX_CRITICALITY_LEVELS; c++) {
+      engine->timelines[c].built = false;
+    }
+  }
+
+  slack_timeline *tl = &engine->timelines[crit_lvl];
+  if (!tl->built) {
+    build_timeline(core_id, crit_lvl, tl, tstart);
+  }
+  if (tl->overflow) {
+    return false;
+  }
+
+  slack_table *tbl = &tl->tables[dvfs_idx];
+  if (!tbl->built) {
+    build_table(tl, tbl, dvfs_levels[dvfs_idx].scaling_factor);
+  }
+
+  uint32_t n = tl->num_keys;
+  int64_t min_value = INT64_MAX;
+
+  if (extra_job == NULL) {
+    if (n > 0 && tbl->suffix_min[0] != SLACK_NO_POINT) {
+      min_value = tbl->suffix_min[0];
+    }
+  } else {
+    uint32_t dx =
+        extra_job->arrival_time + extra_job->relative_tuned_deadlines[crit_lvl];
+    // The timeline misses the releases due between its limit and dx.
+    if (dx > tl->demand_limit) {
+      return false;
+    }
+    int64_t rx = scaled_demand((float)extra_job->parent_task->wcet[crit_lvl] -
+                                   extra_job->executed_time,
+                               dvfs_levels[dvfs_idx].scaling_factor);
+    uint32_t split = lower_bound(tl->keys, n, dx);
+
+    if (split > 0 && tbl->prefix_min[split - 1] != SLACK_NO_POINT) {
+      min_value = tbl->prefix_min[split - 1];
+    }
+    if (split < n && tbl->suffix_min[split] != SLACK_NO_POINT &&
+        tbl->suffix_min[split] - rx < min_value) {
+      min_value = tbl->suffix_min[split] - rx;
+    }
+    if (dx > tstart) {
+      uint32_t upto = (split < n && tl->keys[split] == dx) ? split + 1 : split;
+      int64_t before = upto > 0 ? tbl->demand[upto - 1] : 0;
+      if ((int64_t)dx - before - rx < min_value) {
+        min_value = (int64_t)dx - before - rx;
+      }
+    }
+  }
+
+  if (min_value == INT64_MAX) {
+    *slack = FLT_MAX;
+  } else {
+    int64_t s = min_value - (int64_t)tstart;
+    *slack = s < 0 ? 0.0f : (float)s;
+  }
+
+  return true;
+}
@@ -1,79 +1,112 @@
 #include "processor.h"
+#include "replay.h"
 #include "sys_config.h"
 #include "task_alloc.h"
 #include "task_management.h"
 
 #include "lib/math.h"
+#include "lib/rng.h"
 
+#include "scheduler/sched_calendar.h"
 #include "scheduler/sched_core.h"
 #include "scheduler/sched_migration.h"
+#include "scheduler/sched_slack.h"
 #include "scheduler/sched_util.h"
 
 #include <float.h>
 #include <math.h>
 
-float generate_acet(job_struct *job) {
+// Draws from a generator seeded by the job's identity and the core releasing
+// it rather than from a shared stream, so the order in which threads release
+// jobs does not change their ACETs.
+static float draw_acet(const job_struct *job, uint8_t core_id) {
   const float bias_factor = 2.0f; // >1 biases toward lower criticalities
   uint8_t max_lvl = MAX_CRITICALITY_LEVELS - 1;
 
-  float r = rand_between(0.0f, 1.0f);
+  rng gen;
+  uint64_t place = (uint64_t)proc_state.processor_id << 8 | core_id;
+  uint64_t job_key = (uint64_t)job->parent_task->id << 32 | job->arrival_time;
+  rng_init(&gen, rng_mix(rng_mix(sim_seed, place), job_key));
+
+  float r = rng_float(&gen);
 
   uint8_t crit = (uint8_t)((float)max_lvl * powf(r, bias_factor));
 
   if (crit < proc_state.system_criticality_level)
     crit = proc_state.system_criticality_level;
 
-  float acet_fraction = rand_between(0.1f, 1.0f);
+  float acet_fraction = rng_between(&gen, 0.1f, 1.0f);
 
   float acet = acet_fraction * (float)job->parent_task->wcet[crit];
 
   return acet;
 }
 
-uint32_t calculate_allocated_horizon(uint8_t core_id) {
-  core_state *core_state = &core_states[core_id];
+float generate_acet(const job_struct *job, uint8_t core_id) {
+  float acet;
 
-  uint32_t horizon = 1;
+  if (replay_mode == REPLAY_PLAY && replay_acet(core_id, job, &acet)) {
+    return acet;
+  }
 
-  for (uint32_t i = 0; i < ALLOCATION_MAP_SIZE; i++) {
-    const task_alloc_map *m = &allocation_map[i];
-    if (m->proc_id == core_state->proc_id &&
-        m->core_id == core_state->core_id) {
+  acet = draw_acet(job, core_id);
+  if (replay_mode == REPLAY_RECORD) {
+    replay_record_acet(core_id, job, acet);
+  }
+  return acet;
+}
 
-      const task_struct *t = find_task_by_id(m->task_id);
+uint32_t calculate_allocated_horizon(uint8_t core_id) {
+  core_state *core_state = &core_states[core_id];
 
-      if (!t || t->period == 0)
-        continue;
+  const core_task_index *idx = &core_state->task_index;
+  uint32_t horizon = 1;
 
-      horizon = safe_lcm(horizon, t->period, SLACK_CALC_HORIZON_TICKS_CAP);
-      if (horizon >= SLACK_CALC_HORIZON_TICKS_CAP) {
-        horizon = SLACK_CALC_HORIZON_TICKS_CAP;
-        break;
-      }
+  for (uint32_t i = 0; i < idx->count; i++) {
+    horizon = safe_lcm(horizon, idx->period[i], SLACK_CALC_HORIZON_TICKS_CAP);
+    if (horizon >= SLACK_CALC_HORIZON_TICKS_CAP) {
+      horizon = SLACK_CALC_HORIZON_TICKS_CAP;
+      break;
     }
   }
 
   return horizon;
 }
 
-static inline void calculate_queue_horizon(struct list_head *queue,
+static inline bool update_job_horizon(const job_struct *job,
+                                      uint32_t *horizon) {
+  if (*horizon == 0) {
+    *horizon = job->parent_task->period;
+  } else {
+    *horizon = safe_lcm(*horizon, job->parent_task->period,
+                        SLACK_CALC_HORIZON_TICKS_CAP);
+    if (*horizon >= SLACK_CALC_HORIZON_TICKS_CAP) {
+      *horizon = SLACK_CALC_HORIZON_TICKS_CAP;
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline void calculate_queue_horizon(const job_queue *queue,
                                            uint32_t *horizon) {
   job_struct *job;
+  job_queue_for_each(job, queue) {
+    if (!update_job_horizon(job, horizon))
+      return;
+  }
+}
+
+static inline void calculate_list_horizon(struct list_head *queue,
+                                          uint32_t *horizon) {
+  job_struct *job;
   list_for_each_entry(job, queue, link) {
-    if (*horizon == 0) {
-      *horizon = job->parent_task->period;
-    } else {
-      *horizon = safe_lcm(*horizon, job->parent_task->period,
-                          SLACK_CALC_HORIZON_TICKS_CAP);
-      if (*horizon >= SLACK_CALC_HORIZON_TICKS_CAP) {
-        *horizon = SLACK_CALC_HORIZON_TICKS_CAP;
-        return;
-      }
-    }
+    if (!update_job_horizon(job, horizon))
+      return;
   }
 }
 
-static uint32_t calculate_horizon(uint8_t core_id) {
+uint32_t calculate_horizon(uint8_t core_id) {
   core_state *core_state = &core_states[core_id];
 
   uint32_t horizon = core_state->cached_slack_horizon;
@@ -84,7 +117,7 @@ static uint32_t calculate_horizon(uint8_t core_id) {
   }
   calculate_queue_horizon(&core_state->ready_queue, &horizon);
   calculate_queue_horizon(&core_state->replica_queue, &horizon);
-  calculate_queue_horizon(&core_state->pending_jobs_queue, &horizon);
+  calculate_list_horizon(&core_state->pending_jobs_queue, &horizon);
 
   return horizon;
 }
@@ -113,12 +146,24 @@ static inline void process_job_deadline(const job_struct *job,
   }
 }
 
-static inline void process_queue_deadlines(struct list_head *queue,
+static inline void process_queue_deadlines(const job_queue *queue,
                                            criticality_level crit_lvl,
                                            uint32_t tstart, uint32_t *deadlines,
                                            uint32_t *count,
                                            uint32_t max_deadlines) {
   job_struct *job;
+  job_queue_for_each(job, queue) {
+    process_job_deadline(job, crit_lvl, tstart, deadlines, count,
+                         max_deadlines);
+  }
+}
+
+static inline void process_list_deadlines(struct list_head *queue,
+                                          criticality_level crit_lvl,
+                                          uint32_t tstart, uint32_t *deadlines,
+                                          uint32_t *count,
+                                          uint32_t max_deadlines) {
+  job_struct *job;
   list_for_each_entry(job, queue, link) {
     process_job_deadline(job, crit_lvl, tstart, deadlines, count,
                          max_deadlines);
@@ -146,21 +191,16 @@ static uint32_t collect_active_and_future_deadlines(
                           &count, max_deadlines);
   process_queue_deadlines(&core_state->replica_queue, crit_lvl, tstart,
                           deadlines, &count, max_deadlines);
-  process_queue_deadlines(&core_state->pending_jobs_queue, crit_lvl, tstart,
-                          deadlines, &count, max_deadlines);
-
-  for (uint32_t i = 0; i < ALLOCATION_MAP_SIZE; i++) {
-    const task_alloc_map *m = &allocation_map[i];
-
-    if (m->proc_id != core_state->proc_id || m->core_id != core_state->core_id)
-      continue;
+  process_list_deadlines(&core_state->pending_jobs_queue, crit_lvl, tstart,
+                         deadlines, &count, max_deadlines);
 
-    const task_struct *task = find_task_by_id(m->task_id);
-    if (task->crit_level < crit_lvl)
+  const core_task_index *idx = &core_state->task_index;
+  for (uint32_t i = 0; i < idx->count; i++) {
+    if (idx->task[i]->crit_level < crit_lvl)
       continue;
 
-    uint32_t period = task->period;
-    uint32_t deadline = m->tuned_deadlines[crit_lvl];
+    uint32_t period = idx->period[i];
+    uint32_t deadline = idx->tuned_deadlines[crit_lvl][i];
     uint32_t arrival = (tstart / period + 1) * period;
 
     while (arrival + deadline > tstart &&
@@ -207,10 +247,23 @@ static float __find_slack(uint8_t core_id, criticality_level crit_lvl,
   if (scaling_factor <= 0.0f)
     scaling_factor = 1.0f;
 
-  core_state *core_state = &core_states[core_id];
   const uint32_t current_time = proc_state.system_time;
   tstart = tstart > current_time ? tstart : current_time;
 
+  float engine_slack;
+  if (slack_engine_query(core_id, crit_lvl, tstart, scaling_factor, extra_job,
+                         &engine_slack)) {
+    return engine_slack;
+  }
+  return find_slack_full_locked(core_id, crit_lvl, tstart, scaling_factor,
+                                extra_job);
+}
+
+float find_slack_full_locked(uint8_t core_id, criticality_level crit_lvl,
+                             uint32_t tstart, float scaling_factor,
+                             const job_struct *extra_job) {
+  core_state *core_state = &core_states[core_id];
+
   uint32_t deadlines[MAX_DEADLINES];
   uint32_t dcount = collect_active_and_future_deadlines(
       core_id, crit_lvl, tstart, deadlines, MAX_DEADLINES, extra_job);
@@ -230,11 +283,11 @@ static float __find_slack(uint8_t core_id, criticality_level crit_lvl,
                                      scaling_factor);
     }
 
-    list_for_each_entry(job, &core_state->ready_queue, link) {
+    job_queue_for_each(job, &core_state->ready_queue) {
       demand += calculate_job_demand(job, crit_lvl, d, scaling_factor);
     }
 
-    list_for_each_entry(job, &core_state->replica_queue, link) {
+    job_queue_for_each(job, &core_state->replica_queue) {
       demand += calculate_job_demand(job, crit_lvl, d, scaling_factor);
     }
 
@@ -246,19 +299,15 @@ static float __find_slack(uint8_t core_id, criticality_level crit_lvl,
       demand += calculate_job_demand(extra_job, crit_lvl, d, scaling_factor);
     }
 
-    for (uint32_t k = 0; k < ALLOCATION_MAP_SIZE; k++) {
-      const task_alloc_map *m = &allocation_map[k];
-      if (m->proc_id != core_state->proc_id ||
-          m->core_id != core_state->core_id)
-        continue;
-
-      const task_struct *task = find_task_by_id(m->task_id);
-      if (!task || task->crit_level < crit_lvl)
+    const core_task_index *idx = &core_state->task_index;
+    for (uint32_t k = 0; k < idx->count; k++) {
+      const task_struct *task = idx->task[k];
+      if (task->crit_level < crit_lvl)
         continue;
 
       uint32_t wcet = task->wcet[crit_lvl];
-      uint32_t period = task->period;
-      uint32_t tuned_dl = m->tuned_deadlines[crit_lvl];
+      uint32_t period = idx->period[k];
+      uint32_t tuned_dl = idx->tuned_deadlines[crit_lvl][k];
       uint32_t arrival = (tstart / period + 1) * period;
 
       while (arrival + tuned_dl <= d) {
@@ -340,48 +389,8 @@ bool is_admissible_locked(uint8_t core_id, job_struct *candidate_job,
 }
 
 uint32_t find_next_effective_arrival_time(uint8_t core_id) {
-  core_state *core_state = &core_states[core_id];
-  uint32_t min_arrival_time = UINT32_MAX;
-
-  job_struct *pending;
-  list_for_each_entry(pending, &core_state->pending_jobs_queue, link) {
-    if (pending->arrival_time > proc_state.system_time &&
-        pending->arrival_time < min_arrival_time) {
-      min_arrival_time = pending->arrival_time;
-    }
-  }
-
-  for (uint32_t i = 0; i < ALLOCATION_MAP_SIZE; i++) {
-    const task_alloc_map *instance = &allocation_map[i];
-
-    if (instance->proc_id != core_state->proc_id ||
-        instance->core_id != core_state->core_id)
-      continue;
-
-    const task_struct *task = find_task_by_id(instance->task_id);
-    if (!task || task->period == 0 ||
-        task->crit_level < core_state->local_criticality_level)
-      continue;
-
-    uint32_t current_time = proc_state.system_time;
-    uint32_t remainder = current_time % task->period;
-    uint32_t next_arrival = current_time + (task->period - remainder);
-
-    struct list_head *deleg_list = &core_state->delegated_job_queue;
-    delegated_job *dj;
-
-    list_for_each_entry(dj, deleg_list, link) {
-      if (dj->arrival_tick == next_arrival && dj->task_id == task->id &&
-          dj->owned_by_remote) {
-        next_arrival += task->period;
-      }
-    }
-
-    if (next_arrival < min_arrival_time)
-      min_arrival_time = next_arrival;
-  }
-
-  return min_arrival_time;
+  return release_calendar_next(core_id,
+                               core_states[core_id].local_criticality_level);
 }
 
 float get_util(uint8_t core_id) {
@@ -397,12 +406,12 @@ float get_util(uint8_t core_id) {
   }
 
   job_struct *cur;
-  list_for_each_entry(cur, &core_state->ready_queue, link) {
+  job_queue_for_each(cur, &core_state->ready_queue) {
     float remaining = fmaxf(0.0f, cur->wcet - cur->executed_time);
     util += remaining / (float)cur->parent_task->period;
   }
 
-  list_for_each_entry(cur, &core_state->replica_queue, link) {
+  job_queue_for_each(cur, &core_state->replica_queue) {
     float remaining = fmaxf(0.0f, cur->wcet - cur->executed_time);
     util += remaining / (float)cur->parent_task->period;
   }
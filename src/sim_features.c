@@ -0,0 +1,67 @@
+#include "sim_features.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *feature_names[FEATURE_COUNT] = {
+    "dvfs", "dpm", "ecc", "procrastination", "migration",
+};
+
+uint32_t sim_features = FEATURE_ALL;
+
+int features_parse(const char *spec, uint32_t *mask) {
+  if (strcmp(spec, "all") == 0) {
+    *mask = FEATURE_ALL;
+    return 0;
+  }
+  if (strcmp(spec, "none") == 0) {
+    *mask = 0;
+    return 0;
+  }
+
+  uint32_t parsed = 0;
+  const char *p = spec;
+  while (*p != '\0') {
+    size_t len = strcspn(p, ",");
+    int found = -1;
+    for (int i = 0; i < FEATURE_COUNT; i++) {
+      if (strlen(feature_names[i]) == len &&
+          strncmp(p, feature_names[i], len) == 0) {
+        found = i;
+        break;
+      }
+    }
+    if (found < 0) {
+      return -1;
+    }
+    parsed |= 1u << found;
+    p += len;
+    if (*p == ',') {
+      p++;
+    }
+  }
+
+  *mask = parsed;
+  return 0;
+}
+
+void features_format(uint32_t mask, char *buf, size_t len) {
+  size_t used = 0;
+  buf[0] = '\0';
+
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    if (!(mask & (1u << i))) {
+      continue;
+    }
+    int n = snprintf(buf + used, len - used, "%s%s", used ? "," : "",
+                     feature_names[i]);
+    if (n < 0 || (size_t)n >= len - used) {
+      return;
+    }
+    used += (size_t)n;
+  }
+
+  if (used == 0) {
+    snprintf(buf, len, "none");
+  }
+}
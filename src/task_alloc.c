@@ -0,0 +1,246 @@
+#include "task_alloc.h"
+#include "sys_config.h"
+#include "task_management.h"
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Allocations cover every processor, including those that NUM_FAULTS takes
+// out of the run.
+#ifdef NUM_FAULTS
+#define PLATFORM_PROCS (NUM_PROC + NUM_FAULTS)
+#else
+#define PLATFORM_PROCS NUM_PROC
+#endif
+
+#define TASK_RECORD_WORDS (5 + MAX_CRITICALITY_LEVELS)
+#define ALLOC_RECORD_WORDS (4 + MAX_CRITICALITY_LEVELS)
+
+const task_struct *system_tasks = NULL;
+uint32_t system_tasks_size = 0;
+
+const task_alloc_map *allocation_map = NULL;
+uint32_t allocation_map_size = 0;
+
+const task_struct **task_lookup = NULL;
+uint32_t task_lookup_size = 0;
+
+static inline uint32_t read_u32(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static int read_header(const unsigned char *data, size_t size,
+                       task_alloc_header *hdr) {
+  if (size < sizeof(*hdr)) {
+    fprintf(stderr, "Allocation file is truncated\n");
+    return -1;
+  }
+
+  memcpy(hdr->magic, data, sizeof(hdr->magic));
+  const unsigned char *p = data + offsetof(task_alloc_header, version);
+  hdr->version = read_u32(p);
+  hdr->num_proc = read_u32(p + 4);
+  hdr->num_cores_per_proc = read_u32(p + 8);
+  hdr->max_crit_levels = read_u32(p + 12);
+  hdr->num_tasks = read_u32(p + 16);
+  hdr->num_allocs = read_u32(p + 20);
+
+  if (memcmp(hdr->magic, TASK_ALLOC_MAGIC, sizeof(hdr->magic)) != 0 ||
+      hdr->version != TASK_ALLOC_VERSION) {
+    fprintf(stderr, "Not a version %d allocation file\n", TASK_ALLOC_VERSION);
+    return -1;
+  }
+
+  if (hdr->num_proc != PLATFORM_PROCS ||
+      hdr->num_cores_per_proc != NUM_CORES_PER_PROC ||
+      hdr->max_crit_levels != MAX_CRITICALITY_LEVELS) {
+    fprintf(stderr,
+            "Allocation is for %u processors, %u cores, %u levels; this "
+            "build has %d, %d, %d\n",
+            hdr->num_proc, hdr->num_cores_per_proc, hdr->max_crit_levels,
+            PLATFORM_PROCS, NUM_CORES_PER_PROC, MAX_CRITICALITY_LEVELS);
+    return -1;
+  }
+
+  uint64_t expected = sizeof(*hdr) +
+                      (uint64_t)hdr->num_tasks * TASK_RECORD_WORDS * 4 +
+                      (uint64_t)hdr->num_allocs * ALLOC_RECORD_WORDS * 4;
+  if (size != expected) {
+    fprintf(stderr, "Allocation file is %zu bytes, expected %llu\n", size,
+            (unsigned long long)expected);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int read_tasks(const unsigned char *p, uint32_t count,
+                      task_struct *tasks, uint32_t *max_id) {
+  *max_id = 0;
+
+  for (uint32_t i = 0; i < count; i++, p += TASK_RECORD_WORDS * 4) {
+    task_struct *t = &tasks[i];
+    t->id = read_u32(p);
+    t->period = read_u32(p + 4);
+    t->deadline = read_u32(p + 8);
+    for (int l = 0; l < MAX_CRITICALITY_LEVELS; l++) {
+      t->wcet[l] = read_u32(p + 12 + 4 * l);
+    }
+    uint32_t crit = read_u32(p + 12 + 4 * MAX_CRITICALITY_LEVELS);
+    uint32_t replicas = read_u32(p + 16 + 4 * MAX_CRITICALITY_LEVELS);
+
+    if (t->id > TASK_ALLOC_MAX_TASK_ID || crit >= MAX_CRITICALITY_LEVELS ||
+        replicas > UINT8_MAX) {
+      fprintf(stderr, "Task record %u is invalid\n", i);
+      return -1;
+    }
+    t->crit_level = (criticality_level)crit;
+    t->num_replicas = (uint8_t)replicas;
+
+    if (t->id > *max_id) {
+      *max_id = t->id;
+    }
+  }
+
+  return 0;
+}
+
+static int read_allocs(const unsigned char *p, uint32_t count,
+                       task_alloc_map *allocs) {
+  uint32_t per_core[PLATFORM_PROCS][NUM_CORES_PER_PROC] = {{0}};
+
+  for (uint32_t i = 0; i < count; i++, p += ALLOC_RECORD_WORDS * 4) {
+    task_alloc_map *a = &allocs[i];
+    a->task_id = read_u32(p);
+    uint32_t type = read_u32(p + 4);
+    uint32_t proc = read_u32(p + 8);
+    uint32_t core = read_u32(p + 12);
+    for (int l = 0; l < MAX_CRITICALITY_LEVELS; l++) {
+      a->tuned_deadlines[l] = read_u32(p + 16 + 4 * l);
+    }
+
+    if (a->task_id >= task_lookup_size || task_lookup[a->task_id] == NULL ||
+        type > Replica || proc >= PLATFORM_PROCS ||
+        core >= NUM_CORES_PER_PROC) {
+      fprintf(stderr, "Allocation record %u is invalid\n", i);
+      return -1;
+    }
+    a->task_type = (TaskType)type;
+    a->proc_id = (uint8_t)proc;
+    a->core_id = (uint8_t)core;
+
+    // The slack engine's deadline tables are still sized by MAX_TASKS.
+    if (++per_core[proc][core] > MAX_TASKS) {
+      fprintf(stderr, "More than %d tasks allocated to P%u core %u\n",
+              MAX_TASKS, proc, core);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+static int build_tables(const unsigned char *data,
+                        const task_alloc_header *hdr) {
+  const unsigned char *task_records = data + sizeof(*hdr);
+  const unsigned char *alloc_records =
+      task_records + (size_t)hdr->num_tasks * TASK_RECORD_WORDS * 4;
+
+  task_struct *tasks = calloc(hdr->num_tasks ? hdr->num_tasks : 1,
+                              sizeof(task_struct));
+  task_alloc_map *allocs = calloc(hdr->num_allocs ? hdr->num_allocs : 1,
+                                  sizeof(task_alloc_map));
+  if (tasks == NULL || allocs == NULL) {
+    goto fail;
+  }
+
+  uint32_t max_id;
+  if (read_tasks(task_records, hdr->num_tasks, tasks, &max_id) != 0) {
+    goto fail;
+  }
+
+  task_lookup = calloc((size_t)max_id + 1, sizeof(*task_lookup));
+  if (task_lookup == NULL) {
+    goto fail;
+  }
+  task_lookup_size = max_id + 1;
+  for (uint32_t i = 0; i < hdr->num_tasks; i++) {
+    if (task_lookup[tasks[i].id] != NULL) {
+      fprintf(stderr, "Task %u is defined twice\n", tasks[i].id);
+      goto fail;
+    }
+    task_lookup[tasks[i].id] = &tasks[i];
+  }
+
+  if (read_allocs(alloc_records, hdr->num_allocs, allocs) != 0) {
+    goto fail;
+  }
+
+  system_tasks = tasks;
+  system_tasks_size = hdr->num_tasks;
+  allocation_map = allocs;
+  allocation_map_size = hdr->num_allocs;
+  return 0;
+
+fail:
+  free(tasks);
+  free(allocs);
+  free(task_lookup);
+  task_lookup = NULL;
+  task_lookup_size = 0;
+  return -1;
+}
+
+int task_alloc_load(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    fprintf(stderr, "%s: empty or unreadable allocation file\n", path);
+    close(fd);
+    return -1;
+  }
+
+  size_t size = (size_t)st.st_size;
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror("mmap failed");
+    return -1;
+  }
+
+  task_alloc_header hdr;
+  int ret = read_header(data, size, &hdr);
+  if (ret == 0) {
+    ret = build_tables(data, &hdr);
+  }
+
+  munmap(data, size);
+  return ret;
+}
+
+void task_alloc_unload(void) {
+  free((void *)system_tasks);
+  free((void *)allocation_map);
+  free(task_lookup);
+
+  system_tasks = NULL;
+  system_tasks_size = 0;
+  allocation_map = NULL;
+  allocation_map_size = 0;
+  task_lookup = NULL;
+  task_lookup_size = 0;
+}
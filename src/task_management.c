@@ -3,20 +3,25 @@
 
 #include "lib/list.h"
 #include "lib/log.h"
+#include "lib/ring_buffer.h"
 
+#include <assert.h>
 #include <pthread.h>
 #include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
-#define JOBS_PER_CORE 50
-
+// Other cores hand jobs back through remote_free_list, kept off the line of
+// the owner's free_list.
 typedef struct {
-  job_struct job_pool[JOBS_PER_CORE];
   void *free_list;
+  pthread_mutex_t remote_lock __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
   void *remote_free_list;
-  pthread_mutex_t remote_lock;
+  job_struct job_pool[JOBS_PER_CORE]
+      __attribute__((aligned(CACHE_LINE_SIZE_BYTES)));
 } core_job_pool;
 
 static core_job_pool core_pools[NUM_CORES_PER_PROC];
@@ -53,6 +58,7 @@ job_struct *create_job(const task_struct *parent_task, uint8_t core_id) {
     new_job->job_pool_id = core_id;
     new_job->next_migration_eligible_tick = 0;
     INIT_LIST_HEAD(&new_job->link);
+    new_job->queue = NULL;
 
     atomic_store_explicit(&new_job->refcount, 1, memory_order_release);
     atomic_store_explicit(&new_job->is_being_offered, false,
@@ -173,8 +179,8 @@ static void job_to_str(job_struct *job, char *buffer, size_t size) {
            job->virtual_deadline, job->acet - job->executed_time);
 }
 
-void log_job_queue(log_level level, const char *name,
-                   struct list_head *queue_head) {
+void log_job_list(log_level level, const char *name,
+                  struct list_head *queue_head) {
   if (level < current_log_level) {
     return;
   }
@@ -200,3 +206,258 @@ void log_job_queue(log_level level, const char *name,
 
   LOG(level, "%s", queue_str);
 }
+
+static inline uint32_t job_index_home(uint32_t task_id, uint32_t arrival_time) {
+  uint32_t h = task_id * 0x9E3779B1u ^ arrival_time * 0x85EBCA77u;
+  h ^= h >> 15;
+  return h % JOB_INDEX_SLOTS;
+}
+
+static inline uint32_t job_index_next(uint32_t slot) {
+  return slot + 1 == JOB_INDEX_SLOTS ? 0 : slot + 1;
+}
+
+void job_index_init(job_index *idx) {
+  memset(idx->slots, 0, sizeof(idx->slots));
+  idx->size = 0;
+}
+
+void job_index_insert(job_index *idx, job_struct *job) {
+  if (idx->size + 1 >= JOB_INDEX_SLOTS) {
+    LOG(LOG_LEVEL_ERROR, "Job index full, not indexing job %u",
+        job->parent_task->id);
+    return;
+  }
+
+  uint32_t slot = job_index_home(job->parent_task->id, job->arrival_time);
+  while (idx->slots[slot].job != NULL) {
+    slot = job_index_next(slot);
+  }
+
+  idx->slots[slot] = (job_index_entry){.job = job,
+                                       .task_id = job->parent_task->id,
+                                       .arrival_time = job->arrival_time};
+  idx->size++;
+}
+
+void job_index_remove(job_index *idx, const job_struct *job) {
+  uint32_t hole = job_index_home(job->parent_task->id, job->arrival_time);
+  while (idx->slots[hole].job != job) {
+    if (idx->slots[hole].job == NULL) {
+      return;
+    }
+    hole = job_index_next(hole);
+  }
+
+  // Shift later entries of the probe run back into the hole, unless their
+  // home slot lies cyclically in (hole, slot].
+  uint32_t slot = hole;
+  for (;;) {
+    slot = job_index_next(slot);
+    const job_index_entry *e = &idx->slots[slot];
+    if (e->job == NULL) {
+      break;
+    }
+
+    uint32_t home = job_index_home(e->task_id, e->arrival_time);
+    bool stays = hole <= slot ? (hole < home && home <= slot)
+                              : (hole < home || home <= slot);
+    if (!stays) {
+      idx->slots[hole] = *e;
+      hole = slot;
+    }
+  }
+
+  idx->slots[hole].job = NULL;
+  idx->size--;
+}
+
+uint32_t job_index_find(const job_index *idx, uint32_t task_id,
+                        uint32_t arrival_time, job_struct **matches,
+                        uint32_t max_matches) {
+  uint32_t num_matches = 0;
+
+  for (uint32_t slot = job_index_home(task_id, arrival_time);
+       idx->slots[slot].job != NULL && num_matches < max_matches;
+       slot = job_index_next(slot)) {
+    const job_index_entry *e = &idx->slots[slot];
+    if (e->task_id == task_id && e->arrival_time == arrival_time) {
+      matches[num_matches++] = e->job;
+    }
+  }
+
+  return num_matches;
+}
+
+#define JOB_QUEUE_ARITY 4
+
+static inline bool job_before(const job_struct *a, const job_struct *b) {
+  if (a->queue_key != b->queue_key) {
+    return a->queue_key < b->queue_key;
+  }
+  return a->queue_seq < b->queue_seq;
+}
+
+static uint64_t job_key_virtual_deadline(const job_struct *job) {
+  return job->virtual_deadline;
+}
+
+static inline void job_queue_place(job_queue *q, uint32_t pos,
+                                   job_struct *job) {
+  q->slots[pos] = job;
+  job->queue_pos = pos;
+}
+
+static void job_queue_sift_up(job_queue *q, uint32_t pos) {
+  job_struct *job = q->slots[pos];
+
+  while (pos > 0) {
+    uint32_t parent = (pos - 1) / JOB_QUEUE_ARITY;
+    if (!job_before(job, q->slots[parent])) {
+      break;
+    }
+    job_queue_place(q, pos, q->slots[parent]);
+    pos = parent;
+  }
+  job_queue_place(q, pos, job);
+}
+
+static void job_queue_sift_down(job_queue *q, uint32_t pos) {
+  job_struct *job = q->slots[pos];
+
+  for (;;) {
+    uint32_t first = pos * JOB_QUEUE_ARITY + 1;
+    if (first >= q->size) {
+      break;
+    }
+
+    uint32_t last = first + JOB_QUEUE_ARITY;
+    if (last > q->size) {
+      last = q->size;
+    }
+
+    uint32_t best = first;
+    for (uint32_t c = first + 1; c < last; c++) {
+      if (job_before(q->slots[c], q->slots[best])) {
+        best = c;
+      }
+    }
+
+    if (!job_before(q->slots[best], job)) {
+      break;
+    }
+    job_queue_place(q, pos, q->slots[best]);
+    pos = best;
+  }
+  job_queue_place(q, pos, job);
+}
+
+void job_queue_init(job_queue *q) {
+  q->size = 0;
+  q->next_seq = 0;
+  q->index = NULL;
+  q->key = job_key_virtual_deadline;
+}
+
+void job_queue_attach_index(job_queue *q, job_index *idx) { q->index = idx; }
+
+void job_queue_set_key(job_queue *q, job_key_fn key) { q->key = key; }
+
+void job_queue_push(job_queue *q, job_struct *job) {
+  if (q == NULL || job == NULL) {
+    LOG(LOG_LEVEL_ERROR, "Attempted to add job to a NULL queue\n");
+    return;
+  }
+  // A job sits in at most one queue, and the processor's pools hold
+  // JOB_QUEUE_CAPACITY jobs, so a full queue means a job was queued twice.
+  assert(q->size < JOB_QUEUE_CAPACITY);
+
+  job->queue = q;
+  job->queue_key = q->key(job);
+  job->queue_seq = q->next_seq++;
+  job_queue_place(q, q->size++, job);
+  job_queue_sift_up(q, job->queue_pos);
+
+  if (q->index) {
+    job_index_insert(q->index, job);
+  }
+}
+
+job_struct *job_queue_peek(const job_queue *q) {
+  return q->size > 0 ? q->slots[0] : NULL;
+}
+
+job_struct *job_queue_pop(job_queue *q) {
+  job_struct *job = job_queue_peek(q);
+  if (job) {
+    job_queue_remove(q, job);
+  }
+  return job;
+}
+
+void job_queue_remove(job_queue *q, job_struct *job) {
+  if (job == NULL || job->queue != q) {
+    return;
+  }
+
+  if (q->index) {
+    job_index_remove(q->index, job);
+  }
+
+  uint32_t pos = job->queue_pos;
+  job_struct *last = q->slots[--q->size];
+  job->queue = NULL;
+
+  if (pos == q->size) {
+    return;
+  }
+
+  job_queue_place(q, pos, last);
+  if (pos > 0 && job_before(last, q->slots[(pos - 1) / JOB_QUEUE_ARITY])) {
+    job_queue_sift_up(q, pos);
+  } else {
+    job_queue_sift_down(q, pos);
+  }
+}
+
+static int cmp_queued_jobs(const void *a, const void *b) {
+  const job_struct *x = *(job_struct *const *)a;
+  const job_struct *y = *(job_struct *const *)b;
+  return job_before(x, y) ? -1 : (job_before(y, x) ? 1 : 0);
+}
+
+uint32_t job_queue_sorted(const job_queue *q,
+                          job_struct *out[JOB_QUEUE_CAPACITY]) {
+  memcpy(out, q->slots, q->size * sizeof(job_struct *));
+  qsort(out, q->size, sizeof(job_struct *), cmp_queued_jobs);
+  return q->size;
+}
+
+void log_job_queue(log_level level, const char *name, const job_queue *q) {
+  if (level < current_log_level) {
+    return;
+  }
+
+  job_struct *sorted[JOB_QUEUE_CAPACITY];
+  job_queue_sorted(q, sorted);
+
+  char queue_str[256];
+  snprintf(queue_str, sizeof(queue_str), "Queue '%s': ", name);
+
+  if (q->size == 0) {
+    snprintf(queue_str + strlen(queue_str),
+             sizeof(queue_str) - strlen(queue_str), "%s", "(Empty)");
+  }
+
+  for (uint32_t i = 0; i < q->size; i++) {
+    char job_info[64];
+    job_to_str(sorted[i], job_info, sizeof(job_info));
+    snprintf(queue_str + strlen(queue_str),
+             sizeof(queue_str) - strlen(queue_str), "%s", job_info);
+    if (i + 1 < q->size) {
+      strncat(queue_str, " -> ", sizeof(queue_str) - strlen(queue_str) - 1);
+    }
+  }
+
+  LOG(level, "%s", queue_str);
+}
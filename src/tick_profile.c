@@ -0,0 +1,162 @@
+#include "tick_profile.h"
+
+#ifdef ENABLE_TICK_PROFILE
+
+#include "lib/histogram.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#define TICK_PROFILE_DIR "target/profile"
+#define TICK_PROFILE_THREADS (NUM_CORES_PER_PROC + 1)
+
+static const char *phase_names[TICK_PHASE_COUNT] = {
+    "ecc",
+    "mode_change",
+    "running_job",
+    "arrivals",
+    "reclaim",
+    "migration",
+    "select",
+    "procrastination",
+    "dvfs",
+    "dpm",
+    "summary",
+    "log",
+    "tick",
+    "core_barrier",
+    "time_sync",
+    "ipc_receive",
+    "discard_release",
+    "ipc_send",
+    "peer_sync",
+    "proc_barrier",
+};
+
+static histogram histograms[TICK_PROFILE_THREADS][TICK_PHASE_COUNT];
+
+static const double percentiles[] = {50.0, 90.0, 99.0, 99.9};
+#define NUM_PERCENTILES (sizeof(percentiles) / sizeof(percentiles[0]))
+
+void tick_profile_init(void) {
+  for (int t = 0; t < TICK_PROFILE_THREADS; t++) {
+    for (int p = 0; p < TICK_PHASE_COUNT; p++) {
+      histogram_init(&histograms[t][p]);
+    }
+  }
+}
+
+void tick_profile_record(uint8_t thread, tick_phase phase, uint64_t ns) {
+  histogram_record(&histograms[thread][phase], ns);
+}
+
+static void thread_name(int thread, char *buf, size_t len) {
+  if (thread == TICK_PROFILE_TIMER) {
+    snprintf(buf, len, "timer");
+  } else {
+    snprintf(buf, len, "core%d", thread);
+  }
+}
+
+static FILE *open_output(uint8_t proc_id, const char *ext) {
+  char path[64];
+  snprintf(path, sizeof(path), TICK_PROFILE_DIR "/tick_profile_p%u.%s",
+           proc_id, ext);
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+  }
+  return f;
+}
+
+static void write_csv(FILE *f, uint8_t proc_id) {
+  fputs("proc,thread,phase,count,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,"
+        "p999_ns,max_ns,total_ns\n",
+        f);
+
+  for (int t = 0; t < TICK_PROFILE_THREADS; t++) {
+    char name[16];
+    thread_name(t, name, sizeof(name));
+    for (int p = 0; p < TICK_PHASE_COUNT; p++) {
+      const histogram *h = &histograms[t][p];
+      if (h->total == 0) {
+        continue;
+      }
+      fprintf(f, "%u,%s,%s,%llu,%llu,%.1f", proc_id, name, phase_names[p],
+              (unsigned long long)h->total, (unsigned long long)h->min,
+              (double)h->sum / (double)h->total);
+      for (size_t i = 0; i < NUM_PERCENTILES; i++) {
+        fprintf(f, ",%llu",
+                (unsigned long long)histogram_percentile(h, percentiles[i]));
+      }
+      fprintf(f, ",%llu,%llu\n", (unsigned long long)h->max,
+              (unsigned long long)h->sum);
+    }
+  }
+}
+
+// Same summary as the CSV, plus the non-empty buckets as [lowest value,
+// count] pairs.
+static void write_json(FILE *f, uint8_t proc_id) {
+  fprintf(f, "{\"proc\": %u, \"unit\": \"ns\", \"histograms\": [", proc_id);
+
+  const char *sep = "";
+  for (int t = 0; t < TICK_PROFILE_THREADS; t++) {
+    char name[16];
+    thread_name(t, name, sizeof(name));
+    for (int p = 0; p < TICK_PHASE_COUNT; p++) {
+      const histogram *h = &histograms[t][p];
+      if (h->total == 0) {
+        continue;
+      }
+      fprintf(f,
+              "%s\n  {\"thread\": \"%s\", \"phase\": \"%s\", \"count\": %llu, "
+              "\"min\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, "
+              "\"p99\": %llu, \"p999\": %llu, \"max\": %llu, \"buckets\": [",
+              sep, name, phase_names[p], (unsigned long long)h->total,
+              (unsigned long long)h->min, (double)h->sum / (double)h->total,
+              (unsigned long long)histogram_percentile(h, 50.0),
+              (unsigned long long)histogram_percentile(h, 90.0),
+              (unsigned long long)histogram_percentile(h, 99.0),
+              (unsigned long long)histogram_percentile(h, 99.9),
+              (unsigned long long)h->max);
+
+      const char *bucket_sep = "";
+      for (uint32_t b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        if (h->counts[b] == 0) {
+          continue;
+        }
+        fprintf(f, "%s[%llu, %llu]", bucket_sep,
+                (unsigned long long)histogram_bucket_value(b),
+                (unsigned long long)h->counts[b]);
+        bucket_sep = ", ";
+      }
+      fputs("]}", f);
+      sep = ",";
+    }
+  }
+  fputs("\n]}\n", f);
+}
+
+int tick_profile_dump(uint8_t proc_id) {
+  if ((mkdir("target", 0755) != 0 && errno != EEXIST) ||
+      (mkdir(TICK_PROFILE_DIR, 0755) != 0 && errno != EEXIST)) {
+    perror(TICK_PROFILE_DIR);
+    return -1;
+  }
+
+  FILE *csv = open_output(proc_id, "csv");
+  FILE *json = open_output(proc_id, "json");
+  if (csv != NULL) {
+    write_csv(csv, proc_id);
+    fclose(csv);
+  }
+  if (json != NULL) {
+    write_json(json, proc_id);
+    fclose(json);
+  }
+  return csv != NULL && json != NULL ? 0 : -1;
+}
+
+#endif
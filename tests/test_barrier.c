@@ -1,13 +1,21 @@
 #include "tests/test_assert.h"
 #include "tests/test_core.h"
+#include "tests/test_log.h"
 
 #include "lib/barrier.h"
 
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
 
 #define THREAD_COUNT 4
+#define SPIN_ROUNDS 2000
+#define BENCH_ROUNDS 20000
 
 typedef struct {
   barrier b;
@@ -124,11 +132,143 @@ static void test_barrier_single_thread(test_ctx *ctx) {
   EXPECT_EQ(ctx, barrier_destroy(&b), 0);
 }
 
+typedef struct {
+  barrier *b;
+  _Atomic int *arrivals;
+  _Atomic int *serials;
+  int rounds;
+  int mismatches;
+} round_worker_t;
+
+static void *round_worker_func(void *arg) {
+  round_worker_t *w = arg;
+  for (int r = 0; r < w->rounds; r++) {
+    atomic_fetch_add(w->arrivals, 1);
+    if (barrier_wait(w->b) == BARRIER_SERIAL_THREAD)
+      atomic_fetch_add(w->serials, 1);
+    if (atomic_load(w->arrivals) < (r + 1) * THREAD_COUNT)
+      w->mismatches++;
+    barrier_wait(w->b);
+  }
+  return NULL;
+}
+
+static void test_spin_barrier_rounds(test_ctx *ctx) {
+  barrier b;
+  _Atomic int arrivals = 0;
+  _Atomic int serials = 0;
+  pthread_t threads[THREAD_COUNT];
+  round_worker_t workers[THREAD_COUNT];
+
+  ASSERT_OK(ctx, barrier_init(&b, THREAD_COUNT, BARRIER_SPIN));
+
+  for (int i = 0; i < THREAD_COUNT; i++) {
+    workers[i] = (round_worker_t){.b = &b,
+                                  .arrivals = &arrivals,
+                                  .serials = &serials,
+                                  .rounds = SPIN_ROUNDS};
+    pthread_create(&threads[i], NULL, round_worker_func, &workers[i]);
+  }
+  for (int i = 0; i < THREAD_COUNT; i++)
+    pthread_join(threads[i], NULL);
+
+  for (int i = 0; i < THREAD_COUNT; i++)
+    EXPECT_EQ(ctx, workers[i].mismatches, 0);
+  EXPECT_EQ(ctx, atomic_load(&arrivals), SPIN_ROUNDS * THREAD_COUNT);
+  EXPECT_EQ(ctx, atomic_load(&serials), SPIN_ROUNDS);
+  EXPECT_EQ(ctx, barrier_destroy(&b), 0);
+}
+
+static void test_spin_barrier_process_shared(test_ctx *ctx) {
+  typedef struct {
+    barrier b;
+    _Atomic int counter;
+  } shared_t;
+
+  shared_t *shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  ASSERT(ctx, shared != MAP_FAILED);
+  ASSERT_OK(ctx, barrier_init(&shared->b, 2,
+                              BARRIER_PROCESS_SHARED | BARRIER_SPIN));
+  atomic_init(&shared->counter, 0);
+
+  pid_t pid = fork();
+  ASSERT(ctx, pid >= 0);
+
+  int mismatches = 0;
+  for (int r = 0; r < SPIN_ROUNDS; r++) {
+    atomic_fetch_add(&shared->counter, 1);
+    barrier_wait(&shared->b);
+    if (atomic_load(&shared->counter) != (r + 1) * 2)
+      mismatches++;
+    barrier_wait(&shared->b);
+  }
+
+  if (pid == 0)
+    _exit(mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+
+  int status;
+  waitpid(pid, &status, 0);
+  EXPECT(ctx, WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+  EXPECT_EQ(ctx, mismatches, 0);
+  EXPECT_EQ(ctx, barrier_destroy(&shared->b), 0);
+  munmap(shared, sizeof(shared_t));
+}
+
+typedef struct {
+  barrier *b;
+} bench_worker_t;
+
+static void *bench_worker_func(void *arg) {
+  bench_worker_t *w = arg;
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    barrier_wait(w->b);
+  return NULL;
+}
+
+static double bench_barrier(int flags) {
+  barrier b;
+  pthread_t threads[THREAD_COUNT];
+  bench_worker_t worker = {.b = &b};
+  struct timespec start, end;
+
+  if (barrier_init(&b, THREAD_COUNT, flags) != 0)
+    return -1.0;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (int i = 0; i < THREAD_COUNT; i++)
+    pthread_create(&threads[i], NULL, bench_worker_func, &worker);
+  for (int i = 0; i < THREAD_COUNT; i++)
+    pthread_join(threads[i], NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  barrier_destroy(&b);
+
+  double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 +
+              (double)(end.tv_nsec - start.tv_nsec);
+  return ns / BENCH_ROUNDS;
+}
+
+// Not a pass/fail check: logs the per-round cost of both implementations.
+static void test_barrier_benchmark(test_ctx *ctx) {
+  double mutex_ns = bench_barrier(0);
+  double spin_ns = bench_barrier(BARRIER_SPIN);
+
+  EXPECT(ctx, mutex_ns > 0.0);
+  EXPECT(ctx, spin_ns > 0.0);
+  test_log(ctx,
+           "%d threads, %d rounds: mutex %.0f ns/round, spin %.0f ns/round\n",
+           THREAD_COUNT, BENCH_ROUNDS, mutex_ns, spin_ns);
+}
+
 static test_case barrier_cases[] = {
     TEST_CASE(test_barrier_init_valid_invalid),
     TEST_CASE(test_barrier_basic_sync),
     TEST_CASE(test_barrier_destroy_unused_busy),
     TEST_CASE(test_barrier_single_thread),
+    TEST_CASE(test_spin_barrier_rounds),
+    TEST_CASE(test_spin_barrier_process_shared),
+    TEST_CASE(test_barrier_benchmark),
     {NULL, NULL},
 };
 
@@ -0,0 +1,129 @@
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+#include "tests/test_sched.h"
+
+#include "task_alloc.h"
+#include "task_management.h"
+
+#include "scheduler/sched_calendar.h"
+#include "scheduler/sched_core.h"
+
+#define CALENDAR_TEST_TASKS 4
+
+#define TOP_LEVEL ((criticality_level)(MAX_CRITICALITY_LEVELS - 1))
+
+static task_struct tasks[CALENDAR_TEST_TASKS];
+static task_alloc_map allocs[CALENDAR_TEST_TASKS];
+
+// Core 0 gets every task, so task index i is task id i + 1. Only the last
+// task is at the top criticality level, unless there is just one level.
+static int load(uint32_t now) {
+  static const uint32_t periods[CALENDAR_TEST_TASKS] = {5, 10, 4, 20};
+
+  for (uint32_t i = 0; i < CALENDAR_TEST_TASKS; i++) {
+    tasks[i] = (task_struct){
+        .id = i + 1,
+        .period = periods[i],
+        .deadline = periods[i],
+        .crit_level = i + 1 == CALENDAR_TEST_TASKS ? TOP_LEVEL : 0,
+    };
+    allocs[i] = (task_alloc_map){
+        .task_id = i + 1, .task_type = Primary, .proc_id = 0, .core_id = 0};
+    for (uint8_t l = 0; l < MAX_CRITICALITY_LEVELS; l++) {
+      tasks[i].wcet[l] = 1;
+      allocs[i].tuned_deadlines[l] = periods[i];
+    }
+  }
+  return test_sched_load(tasks, CALENDAR_TEST_TASKS, allocs,
+                         CALENDAR_TEST_TASKS, now);
+}
+
+static void test_calendar_pops_in_tick_and_index_order(test_ctx *ctx) {
+  ASSERT_EQ(ctx, load(0), 0);
+
+  // Everything is due at 0, in task index order across the heaps.
+  for (uint32_t i = 0; i < CALENDAR_TEST_TASKS; i++) {
+    EXPECT_EQ(ctx, release_calendar_pop_due(0, 0), i);
+  }
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 0), RELEASE_CALENDAR_NONE);
+
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 3), RELEASE_CALENDAR_NONE);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 4), 2u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 4), RELEASE_CALENDAR_NONE);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 5), 0u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 5), RELEASE_CALENDAR_NONE);
+
+  test_sched_unload();
+}
+
+static void test_calendar_catches_up_to_next_multiple(test_ctx *ctx) {
+  ASSERT_EQ(ctx, load(0), 0);
+  while (release_calendar_pop_due(0, 0) != RELEASE_CALENDAR_NONE)
+    ;
+
+  // Missed releases are dropped: at 40 only the periods dividing 40 are due,
+  // and the rest move to their next multiple after it.
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 40), 0u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 40), 1u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 40), 2u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 40), 3u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 40), RELEASE_CALENDAR_NONE);
+
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 57), RELEASE_CALENDAR_NONE);
+  atomic_store(&proc_state.system_time, 57);
+  EXPECT_EQ(ctx, release_calendar_next(0, 0), 60u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 60), 0u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 60), 1u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 60), 2u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 60), 3u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 60), RELEASE_CALENDAR_NONE);
+
+  test_sched_unload();
+}
+
+static void test_calendar_next_by_criticality(test_ctx *ctx) {
+  ASSERT_EQ(ctx, load(1), 0);
+
+  // Calendars built mid-run start at the next multiple of each period.
+  EXPECT_EQ(ctx, release_calendar_next(0, 0), 4u);
+  EXPECT_EQ(ctx, release_calendar_next(0, TOP_LEVEL),
+            MAX_CRITICALITY_LEVELS > 1 ? 20u : 4u);
+
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 4), 2u);
+  EXPECT_EQ(ctx, release_calendar_next(0, 0), 5u);
+
+  test_sched_unload();
+}
+
+static void test_calendar_skips_only_the_delegated_tick(test_ctx *ctx) {
+  ASSERT_EQ(ctx, load(1), 0);
+
+  // Task 2 (period 10) releases next at 10.
+  EXPECT_FALSE(ctx, release_calendar_skip(0, 2, 20));
+  EXPECT_FALSE(ctx, release_calendar_skip(0, 2, 0));
+  EXPECT_FALSE(ctx, release_calendar_skip(0, 99, 10));
+  EXPECT_TRUE(ctx, release_calendar_skip(0, 2, 10));
+  EXPECT_FALSE(ctx, release_calendar_skip(0, 2, 10));
+
+  // At 10 only task 1 is due; task 2 is back at 20.
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 10), 0u);
+  EXPECT_EQ(ctx, release_calendar_pop_due(0, 10), RELEASE_CALENDAR_NONE);
+  EXPECT_TRUE(ctx, release_calendar_skip(0, 2, 20));
+
+  test_sched_unload();
+}
+
+static test_case calendar_cases[] = {
+    TEST_CASE(test_calendar_pops_in_tick_and_index_order),
+    TEST_CASE(test_calendar_catches_up_to_next_multiple),
+    TEST_CASE(test_calendar_next_by_criticality),
+    TEST_CASE(test_calendar_skips_only_the_delegated_tick),
+    {NULL, NULL},
+};
+
+test_suite calendar_suite = {
+    .name = "calendar_suite",
+    .cases = calendar_cases,
+};
+
+REGISTER_SUITE(calendar_suite);
@@ -0,0 +1,84 @@
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+
+#include "lib/histogram.h"
+
+#include <stdint.h>
+
+static void test_histogram_exact_small_values(test_ctx *ctx) {
+  for (uint64_t v = 0; v < 2 * HISTOGRAM_SUB_BUCKETS; v++) {
+    EXPECT_EQ(ctx, histogram_bucket(v), (uint32_t)v);
+    EXPECT_EQ(ctx, histogram_bucket_value((uint32_t)v), v);
+  }
+}
+
+static void test_histogram_bucket_bounds(test_ctx *ctx) {
+  uint32_t last = 0;
+  for (uint64_t v = 1; v < (1ull << 20); v = v * 3 / 2 + 1) {
+    uint32_t b = histogram_bucket(v);
+    uint64_t low = histogram_bucket_value(b);
+    EXPECT(ctx, b >= last);
+    EXPECT(ctx, low <= v);
+    EXPECT(ctx, v - low <= low / HISTOGRAM_SUB_BUCKETS);
+    EXPECT(ctx, histogram_bucket(low) == b);
+    last = b;
+  }
+
+  EXPECT_EQ(ctx, histogram_bucket(UINT64_MAX), HISTOGRAM_BUCKETS - 1);
+  EXPECT_EQ(ctx, histogram_bucket((1ull << HISTOGRAM_MAX_BITS) - 1),
+            HISTOGRAM_BUCKETS - 1);
+}
+
+static void test_histogram_percentiles(test_ctx *ctx) {
+  static histogram h;
+  histogram_init(&h);
+  EXPECT_EQ(ctx, histogram_percentile(&h, 50.0), 0ull);
+
+  for (uint64_t v = 1; v <= 1000; v++) {
+    histogram_record(&h, v);
+  }
+  EXPECT_EQ(ctx, h.total, 1000ull);
+  EXPECT_EQ(ctx, h.sum, 500500ull);
+  EXPECT_EQ(ctx, h.min, 1ull);
+  EXPECT_EQ(ctx, h.max, 1000ull);
+  EXPECT_EQ(ctx, histogram_percentile(&h, 0.0), 1ull);
+  EXPECT_EQ(ctx, histogram_percentile(&h, 100.0), 1000ull);
+
+  uint64_t p50 = histogram_percentile(&h, 50.0);
+  uint64_t p99 = histogram_percentile(&h, 99.0);
+  EXPECT(ctx, p50 >= 500 - 500 / HISTOGRAM_SUB_BUCKETS && p50 <= 500);
+  EXPECT(ctx, p99 >= 990 - 990 / HISTOGRAM_SUB_BUCKETS && p99 <= 990);
+}
+
+static void test_histogram_merge(test_ctx *ctx) {
+  static histogram a, b;
+  histogram_init(&a);
+  histogram_init(&b);
+
+  histogram_record(&a, 10);
+  histogram_record(&a, 20);
+  histogram_record(&b, 5);
+  histogram_record(&b, 4000);
+  histogram_merge(&a, &b);
+
+  EXPECT_EQ(ctx, a.total, 4ull);
+  EXPECT_EQ(ctx, a.sum, 4035ull);
+  EXPECT_EQ(ctx, a.min, 5ull);
+  EXPECT_EQ(ctx, a.max, 4000ull);
+  EXPECT_EQ(ctx, a.counts[histogram_bucket(4000)], 1ull);
+}
+
+static test_case histogram_cases[] = {
+    TEST_CASE(test_histogram_exact_small_values),
+    TEST_CASE(test_histogram_bucket_bounds),
+    TEST_CASE(test_histogram_percentiles),
+    TEST_CASE(test_histogram_merge),
+    {NULL, NULL},
+};
+
+test_suite histogram_suite = {
+    .name = "histogram_suite",
+    .cases = histogram_cases,
+};
+
+REGISTER_SUITE(histogram_suite);
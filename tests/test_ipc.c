@@ -0,0 +1,140 @@
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+
+#include "ipc.h"
+
+#include <stdint.h>
+
+// Accepts `seq` with the counters of this packet alone. Returns the result
+// as an int to compare with the enumerators.
+static int receive(ipc_seq_window *w, uint32_t seq, uint64_t *lost,
+                   uint64_t *unrecovered) {
+  *lost = 0;
+  *unrecovered = 0;
+  return (int)ipc_window_accept(w, seq, lost, unrecovered);
+}
+
+static void test_ipc_window_in_order(test_ctx *ctx) {
+  ipc_seq_window w = {0};
+  uint64_t lost, unrecovered;
+
+  for (uint32_t seq = 0; seq < 3; seq++) {
+    EXPECT_EQ(ctx, receive(&w, seq, &lost, &unrecovered), IPC_SEQ_NEW);
+    EXPECT_EQ(ctx, lost, 0ull);
+    EXPECT_EQ(ctx, unrecovered, 0ull);
+  }
+  EXPECT_EQ(ctx, w.next_seq, 3u);
+  EXPECT_EQ(ctx, w.missing, 0ull);
+}
+
+static void test_ipc_window_gap_and_recovery(test_ctx *ctx) {
+  ipc_seq_window w = {0};
+  uint64_t lost, unrecovered;
+
+  receive(&w, 0, &lost, &unrecovered);
+  EXPECT_EQ(ctx, receive(&w, 3, &lost, &unrecovered), IPC_SEQ_NEW);
+  EXPECT_EQ(ctx, lost, 2ull);
+  EXPECT_EQ(ctx, unrecovered, 0ull);
+  EXPECT_EQ(ctx, w.missing, 0x6ull);
+
+  // The sender reads the NACK back into exactly the missing packets.
+  nack_message nack = ipc_window_nack(&w, 1);
+  uint32_t seqs[IPC_HISTORY_SIZE];
+  EXPECT_EQ(ctx, nack.target, 1u);
+  ASSERT_EQ(ctx, ipc_nack_seqs(&nack, seqs), 2u);
+  EXPECT_EQ(ctx, seqs[0], 2u);
+  EXPECT_EQ(ctx, seqs[1], 1u);
+
+  EXPECT_EQ(ctx, receive(&w, 2, &lost, &unrecovered), IPC_SEQ_RECOVERED);
+  EXPECT_EQ(ctx, receive(&w, 1, &lost, &unrecovered), IPC_SEQ_RECOVERED);
+  EXPECT_EQ(ctx, w.missing, 0ull);
+  EXPECT_EQ(ctx, w.next_seq, 4u);
+  EXPECT_EQ(ctx, receive(&w, 1, &lost, &unrecovered), IPC_SEQ_DUPLICATE);
+}
+
+static void test_ipc_window_duplicate(test_ctx *ctx) {
+  ipc_seq_window w = {0};
+  uint64_t lost, unrecovered;
+
+  receive(&w, 0, &lost, &unrecovered);
+  receive(&w, 1, &lost, &unrecovered);
+  EXPECT_EQ(ctx, receive(&w, 1, &lost, &unrecovered), IPC_SEQ_DUPLICATE);
+  EXPECT_EQ(ctx, receive(&w, 0, &lost, &unrecovered), IPC_SEQ_DUPLICATE);
+  EXPECT_EQ(ctx, lost + unrecovered, 0ull);
+  EXPECT_EQ(ctx, w.next_seq, 2u);
+  EXPECT_EQ(ctx, w.missing, 0ull);
+}
+
+static void test_ipc_window_gap_past_history(test_ctx *ctx) {
+  ipc_seq_window w = {0};
+  uint64_t lost, unrecovered;
+  uint32_t seqs[IPC_HISTORY_SIZE];
+
+  // Only the newest IPC_HISTORY_SIZE - 1 packets of the gap can be asked for.
+  receive(&w, 0, &lost, &unrecovered);
+  EXPECT_EQ(ctx, receive(&w, 100, &lost, &unrecovered), IPC_SEQ_NEW);
+  EXPECT_EQ(ctx, lost, 99ull);
+  EXPECT_EQ(ctx, unrecovered, 99ull - (IPC_HISTORY_SIZE - 1));
+  EXPECT_EQ(ctx, w.missing, ~1ull);
+
+  nack_message nack = ipc_window_nack(&w, 0);
+  ASSERT_EQ(ctx, ipc_nack_seqs(&nack, seqs), IPC_HISTORY_SIZE - 1u);
+  EXPECT_EQ(ctx, seqs[0], 99u);
+  EXPECT_EQ(ctx, seqs[IPC_HISTORY_SIZE - 2], 100u - (IPC_HISTORY_SIZE - 1));
+  EXPECT_EQ(ctx, receive(&w, 36, &lost, &unrecovered), IPC_SEQ_DUPLICATE);
+
+  // A packet still missing when it shifts out of the window is given up.
+  w = (ipc_seq_window){0};
+  receive(&w, 0, &lost, &unrecovered);
+  receive(&w, 2, &lost, &unrecovered);
+  EXPECT_EQ(ctx, receive(&w, IPC_HISTORY_SIZE, &lost, &unrecovered),
+            IPC_SEQ_NEW);
+  EXPECT_EQ(ctx, lost, IPC_HISTORY_SIZE - 3ull);
+  EXPECT_EQ(ctx, unrecovered, 0ull);
+  EXPECT_TRUE(ctx, w.missing >> (IPC_HISTORY_SIZE - 1));
+
+  EXPECT_EQ(ctx, receive(&w, IPC_HISTORY_SIZE + 1, &lost, &unrecovered),
+            IPC_SEQ_NEW);
+  EXPECT_EQ(ctx, unrecovered, 1ull);
+  EXPECT_EQ(ctx, receive(&w, 1, &lost, &unrecovered), IPC_SEQ_DUPLICATE);
+}
+
+static void test_ipc_window_wraps(test_ctx *ctx) {
+  ipc_seq_window w = {.next_seq = UINT32_MAX - 1};
+  uint64_t lost, unrecovered;
+  uint32_t seqs[IPC_HISTORY_SIZE];
+
+  EXPECT_EQ(ctx, receive(&w, UINT32_MAX - 1, &lost, &unrecovered),
+            IPC_SEQ_NEW);
+  EXPECT_EQ(ctx, receive(&w, 1, &lost, &unrecovered), IPC_SEQ_NEW);
+  EXPECT_EQ(ctx, lost, 2ull);
+  EXPECT_EQ(ctx, w.next_seq, 2u);
+
+  nack_message nack = ipc_window_nack(&w, 0);
+  ASSERT_EQ(ctx, ipc_nack_seqs(&nack, seqs), 2u);
+  EXPECT_EQ(ctx, seqs[0], 0u);
+  EXPECT_EQ(ctx, seqs[1], UINT32_MAX);
+
+  EXPECT_EQ(ctx, receive(&w, UINT32_MAX, &lost, &unrecovered),
+            IPC_SEQ_RECOVERED);
+  EXPECT_EQ(ctx, receive(&w, UINT32_MAX - 1, &lost, &unrecovered),
+            IPC_SEQ_DUPLICATE);
+  EXPECT_EQ(ctx, receive(&w, 0, &lost, &unrecovered), IPC_SEQ_RECOVERED);
+  EXPECT_EQ(ctx, w.missing, 0ull);
+}
+
+static test_case ipc_cases[] = {
+    TEST_CASE(test_ipc_window_in_order),
+    TEST_CASE(test_ipc_window_gap_and_recovery),
+    TEST_CASE(test_ipc_window_duplicate),
+    TEST_CASE(test_ipc_window_gap_past_history),
+    TEST_CASE(test_ipc_window_wraps),
+    {NULL, NULL},
+};
+
+test_suite ipc_suite = {
+    .name = "ipc_suite",
+    .cases = ipc_cases,
+};
+
+REGISTER_SUITE(ipc_suite);
@@ -0,0 +1,206 @@
+#include "lib/log.h"
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOG_TEST_PROC 101
+#define LOG_TEST_FILE "target/logs/log_p101.txt"
+
+// Logs a line and appends the line text mode would write for it to
+// `expected`. In trace mode the logger thread has to format the record back
+// into the same line.
+#define LOG_EXPECT(expected, fmt, ...)                                         \
+  do {                                                                         \
+    LOG(LOG_LEVEL_WARN, fmt, __VA_ARGS__);                                     \
+    char line[2 * MAX_LOG_MSG_SIZE];                                           \
+    snprintf(line, sizeof(line),                                               \
+             "[%u] [P%u: C%u] [WARN] [test_log.c:%d] " fmt "\n",               \
+             proc_state.system_time, log_thread_ctx.proc_id,                   \
+             log_thread_ctx.core_id, __LINE__, __VA_ARGS__);                   \
+    line[MAX_LOG_MSG_SIZE - 1] = '\0';                                         \
+    strncat(expected, line, sizeof(expected) - strlen(expected) - 1);          \
+  } while (0)
+
+static size_t read_log(char *buf, size_t size) {
+  FILE *f = fopen(LOG_TEST_FILE, "r");
+  if (f == NULL) {
+    return 0;
+  }
+  size_t n = fread(buf, 1, size - 1, f);
+  buf[n] = '\0';
+  fclose(f);
+  return n;
+}
+
+static void test_log_lines_match_text_format(test_ctx *ctx) {
+  static char expected[4096];
+  static char written[8192];
+  char long_str[300];
+  memset(long_str, 'x', sizeof(long_str) - 1);
+  long_str[sizeof(long_str) - 1] = '\0';
+
+  log_thread_context saved = log_thread_ctx;
+  log_thread_ctx = (log_thread_context){
+      .proc_id = 3, .core_id = 2, .is_set = true};
+  expected[0] = '\0';
+
+  log_system_init(LOG_TEST_PROC);
+
+  float ratio = 0.375f;
+  LOG_EXPECT(expected, "Job %d: %.3f of %.2f, %llu ticks", -7, 3.14159,
+             ratio, (unsigned long long)(1ull << 40) + 7);
+  LOG_EXPECT(expected, "%s and %s, %u%%", "first", "second", 42u);
+  LOG_EXPECT(expected, "Task %lu at %zu: %s", 9ul, (size_t)12,
+             "a string long enough to span two continuation records of "
+             "sixty-four bytes each");
+  LOG_EXPECT(expected, "Hex %#x, char %c, %5lld", 0xbeefu, 'q', -12ll);
+  LOG_EXPECT(expected, "Truncated: %s", long_str);
+
+  log_system_shutdown();
+  log_thread_ctx = saved;
+
+  // Lines logged by earlier suites before the logger started are flushed
+  // ahead of ours.
+  size_t n = read_log(written, sizeof(written));
+  ASSERT(ctx, n >= strlen(expected));
+  EXPECT_NOT_NULL(ctx, strstr(written, expected));
+}
+
+// More entries than a 4096-record ring holds in either mode.
+#define LOG_TEST_FLOOD 8192
+
+typedef struct {
+  unsigned long long written;
+  unsigned long long spilled;
+  unsigned long long retried;
+  unsigned long long blocked;
+  unsigned long long dropped[LOG_LEVEL_FATAL + 1];
+} log_report;
+
+static char flood_log[1 << 20];
+
+// Runs the logger once, which writes out every pending entry of this thread's
+// ring and then the counters summed over the whole run.
+static bool log_cycle(log_report *r) {
+  log_system_init(LOG_TEST_PROC);
+  log_system_shutdown();
+  if (read_log(flood_log, sizeof(flood_log)) == 0) {
+    return false;
+  }
+
+  const char *line = strstr(flood_log, "Log policy ");
+  return line != NULL &&
+         sscanf(line,
+                "Log policy %*s %llu written, %llu spilled, %llu retries, "
+                "%llu blocked, dropped DEBUG %llu, INFO %llu, WARN %llu, "
+                "ERROR %llu, FATAL %llu",
+                &r->written, &r->spilled, &r->retried, &r->blocked,
+                &r->dropped[LOG_LEVEL_DEBUG], &r->dropped[LOG_LEVEL_INFO],
+                &r->dropped[LOG_LEVEL_WARN], &r->dropped[LOG_LEVEL_ERROR],
+                &r->dropped[LOG_LEVEL_FATAL]) == 9;
+}
+
+// The logger is down between cycles, so the ring fills up.
+static void test_log_drop_counts_each_level(test_ctx *ctx) {
+  log_report before, after;
+  ASSERT(ctx, log_cycle(&before));
+
+  log_overflow = LOG_OVERFLOW_DROP;
+  for (int i = 0; i < LOG_TEST_FLOOD; i++) {
+    LOG(LOG_LEVEL_WARN, "Flood %d", i);
+  }
+  for (int i = 0; i < 3; i++) {
+    LOG(LOG_LEVEL_ERROR, "Full %d", i);
+  }
+  LOG(LOG_LEVEL_INFO, "Full");
+  LOG(LOG_LEVEL_DEBUG, "Filtered");
+  ASSERT(ctx, log_cycle(&after));
+
+  unsigned long long warn =
+      after.dropped[LOG_LEVEL_WARN] - before.dropped[LOG_LEVEL_WARN];
+  EXPECT_GT(ctx, warn, 0ull);
+  EXPECT_LT(ctx, warn, (unsigned long long)LOG_TEST_FLOOD);
+  EXPECT_EQ(ctx,
+            after.dropped[LOG_LEVEL_ERROR] - before.dropped[LOG_LEVEL_ERROR],
+            3ull);
+  EXPECT_EQ(ctx,
+            after.dropped[LOG_LEVEL_INFO] - before.dropped[LOG_LEVEL_INFO],
+            1ull);
+  EXPECT_EQ(ctx, after.dropped[LOG_LEVEL_DEBUG],
+            before.dropped[LOG_LEVEL_DEBUG]);
+  EXPECT_EQ(ctx, after.written - before.written + warn,
+            (unsigned long long)LOG_TEST_FLOOD);
+  EXPECT_EQ(ctx, after.spilled, before.spilled);
+}
+
+static void test_log_spill_keeps_order(test_ctx *ctx) {
+  log_report before, after;
+  ASSERT(ctx, log_cycle(&before));
+
+  log_overflow = LOG_OVERFLOW_SPILL;
+  for (int i = 0; i < LOG_TEST_FLOOD; i++) {
+    LOG(LOG_LEVEL_WARN, "Spill %d", i);
+  }
+  log_overflow = LOG_OVERFLOW_DROP;
+  ASSERT(ctx, log_cycle(&after));
+
+  EXPECT_GT(ctx, after.spilled, before.spilled);
+  EXPECT_EQ(ctx, after.written - before.written,
+            (unsigned long long)LOG_TEST_FLOOD);
+  EXPECT_EQ(ctx, after.dropped[LOG_LEVEL_WARN],
+            before.dropped[LOG_LEVEL_WARN]);
+
+  // The ring holds the oldest entries and the spill list the rest, and the
+  // drain has to merge them back into the order they were logged in.
+  int next = 0;
+  for (const char *p = strstr(flood_log, "] Spill "); p != NULL;
+       p = strstr(p + 1, "] Spill ")) {
+    int seq = -1;
+    sscanf(p, "] Spill %d", &seq);
+    if (seq != next) {
+      break;
+    }
+    next++;
+  }
+  EXPECT_EQ(ctx, next, LOG_TEST_FLOOD);
+}
+
+static void test_log_retry_gives_up(test_ctx *ctx) {
+  log_report before, after;
+  ASSERT(ctx, log_cycle(&before));
+
+  log_overflow = LOG_OVERFLOW_DROP;
+  for (int i = 0; i < LOG_TEST_FLOOD; i++) {
+    LOG(LOG_LEVEL_WARN, "Flood %d", i);
+  }
+  log_overflow = LOG_OVERFLOW_RETRY;
+  for (int i = 0; i < 3; i++) {
+    LOG(LOG_LEVEL_ERROR, "Retry %d", i);
+  }
+  log_overflow = LOG_OVERFLOW_DROP;
+  ASSERT(ctx, log_cycle(&after));
+
+  EXPECT_EQ(ctx,
+            after.dropped[LOG_LEVEL_ERROR] - before.dropped[LOG_LEVEL_ERROR],
+            3ull);
+  EXPECT_EQ(ctx, after.retried - before.retried, 3ull * LOG_RETRY_LIMIT);
+  EXPECT_NULL(ctx, strstr(flood_log, "Retry "));
+}
+
+static test_case log_cases[] = {
+    TEST_CASE(test_log_lines_match_text_format),
+    TEST_CASE(test_log_drop_counts_each_level),
+    TEST_CASE(test_log_spill_keeps_order),
+    TEST_CASE(test_log_retry_gives_up),
+    {NULL, NULL},
+};
+
+test_suite log_suite = {
+    .name = "log_suite",
+    .cases = log_cases,
+};
+
+REGISTER_SUITE(log_suite);
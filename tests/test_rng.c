@@ -0,0 +1,64 @@
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+
+#include "lib/rng.h"
+
+#include <stdint.h>
+
+static void test_splitmix64_reference(test_ctx *ctx) {
+  uint64_t state = 0;
+  EXPECT_EQ(ctx, splitmix64(&state), 0xE220A8397B1DCDAFull);
+  EXPECT_EQ(ctx, splitmix64(&state), 0x6E789E6AA1B965F4ull);
+}
+
+static void test_xoshiro_reference(test_ctx *ctx) {
+  rng r = {.s = {1, 2, 3, 4}};
+  EXPECT_EQ(ctx, rng_next(&r), 11520ull);
+  EXPECT_EQ(ctx, rng_next(&r), 0ull);
+  EXPECT_EQ(ctx, rng_next(&r), 1509978240ull);
+  EXPECT_EQ(ctx, rng_next(&r), 1215971899390074240ull);
+}
+
+static void test_rng_same_seed_same_stream(test_ctx *ctx) {
+  rng a, b, c;
+  rng_init(&a, 42);
+  rng_init(&b, 42);
+  rng_init(&c, rng_mix(42, 1));
+
+  uint32_t differs = 0;
+  for (int i = 0; i < 64; i++) {
+    uint64_t x = rng_next(&a);
+    EXPECT_EQ(ctx, x, rng_next(&b));
+    differs += x != rng_next(&c);
+  }
+  EXPECT(ctx, differs > 60);
+}
+
+static void test_rng_between_range(test_ctx *ctx) {
+  rng r;
+  rng_init(&r, 7);
+
+  float lo = 1.0f, hi = 0.0f;
+  for (int i = 0; i < 10000; i++) {
+    float f = rng_between(&r, 0.1f, 1.0f);
+    EXPECT(ctx, f >= 0.1f && f < 1.0f);
+    lo = f < lo ? f : lo;
+    hi = f > hi ? f : hi;
+  }
+  EXPECT(ctx, lo < 0.11f && hi > 0.99f);
+}
+
+static test_case rng_cases[] = {
+    TEST_CASE(test_splitmix64_reference),
+    TEST_CASE(test_xoshiro_reference),
+    TEST_CASE(test_rng_same_seed_same_stream),
+    TEST_CASE(test_rng_between_range),
+    {NULL, NULL},
+};
+
+test_suite rng_suite = {
+    .name = "rng_suite",
+    .cases = rng_cases,
+};
+
+REGISTER_SUITE(rng_suite);
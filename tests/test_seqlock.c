@@ -0,0 +1,101 @@
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+
+#include "lib/seqlock.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SEQLOCK_WRITES 200000
+
+// The writer keeps b == 2 * a, so a reader that ever sees otherwise read a
+// torn pair.
+typedef struct {
+  seqlock sl;
+  _Atomic uint64_t a;
+  _Atomic uint64_t b;
+  _Atomic bool done;
+} seqlock_pair;
+
+static void pair_write(seqlock_pair *p, uint64_t v) {
+  seqlock_write_begin(&p->sl);
+  atomic_store_explicit(&p->a, v, memory_order_release);
+  atomic_store_explicit(&p->b, 2 * v, memory_order_release);
+  seqlock_write_end(&p->sl);
+}
+
+static void pair_read(seqlock_pair *p, uint64_t *a, uint64_t *b) {
+  uint32_t seq;
+  do {
+    seq = seqlock_read_begin(&p->sl);
+    *a = atomic_load_explicit(&p->a, memory_order_acquire);
+    *b = atomic_load_explicit(&p->b, memory_order_acquire);
+  } while (seqlock_read_retry(&p->sl, seq));
+}
+
+static void test_seqlock_sequence(test_ctx *ctx) {
+  seqlock_pair p = {0};
+  seqlock_init(&p.sl);
+
+  uint32_t seq = seqlock_read_begin(&p.sl);
+  EXPECT_EQ(ctx, seq, 0u);
+  EXPECT(ctx, !seqlock_read_retry(&p.sl, seq));
+
+  pair_write(&p, 21);
+  EXPECT(ctx, seqlock_read_retry(&p.sl, seq));
+  EXPECT_EQ(ctx, seqlock_read_begin(&p.sl), 2u);
+
+  uint64_t a, b;
+  pair_read(&p, &a, &b);
+  EXPECT_EQ(ctx, a, 21ull);
+  EXPECT_EQ(ctx, b, 42ull);
+}
+
+static void *pair_writer(void *arg) {
+  seqlock_pair *p = arg;
+  for (uint64_t v = 1; v <= SEQLOCK_WRITES; v++) {
+    pair_write(p, v);
+  }
+  atomic_store(&p->done, true);
+  return NULL;
+}
+
+static void test_seqlock_reader_never_sees_torn_pair(test_ctx *ctx) {
+  seqlock_pair p = {0};
+  seqlock_init(&p.sl);
+
+  pthread_t writer;
+  pthread_create(&writer, NULL, pair_writer, &p);
+
+  uint64_t torn = 0, last = 0, backwards = 0;
+  while (!atomic_load(&p.done)) {
+    uint64_t a, b;
+    pair_read(&p, &a, &b);
+    torn += b != 2 * a;
+    backwards += a < last;
+    last = a;
+  }
+  pthread_join(writer, NULL);
+
+  EXPECT_EQ(ctx, torn, 0ull);
+  EXPECT_EQ(ctx, backwards, 0ull);
+
+  uint64_t a, b;
+  pair_read(&p, &a, &b);
+  EXPECT_EQ(ctx, a, (uint64_t)SEQLOCK_WRITES);
+}
+
+static test_case seqlock_cases[] = {
+    TEST_CASE(test_seqlock_sequence),
+    TEST_CASE(test_seqlock_reader_never_sees_torn_pair),
+    {NULL, NULL},
+};
+
+test_suite seqlock_suite = {
+    .name = "seqlock_suite",
+    .cases = seqlock_cases,
+};
+
+REGISTER_SUITE(seqlock_suite);
@@ -0,0 +1,214 @@
+#include "tests/test_assert.h"
+#include "tests/test_core.h"
+#include "tests/test_sched.h"
+
+#include "power_management.h"
+#include "task_alloc.h"
+#include "task_management.h"
+
+#include "lib/list.h"
+
+#include "scheduler/sched_core.h"
+#include "scheduler/sched_slack.h"
+#include "scheduler/sched_util.h"
+
+#include <math.h>
+
+#define SLACK_TEST_TASKS 6
+
+static task_struct tasks[SLACK_TEST_TASKS];
+static task_alloc_map allocs[SLACK_TEST_TASKS];
+
+// Six tasks spread over the criticality levels, the first four on core 0 and
+// the rest on the next core. Lower levels run to shortened virtual deadlines.
+static void build_allocation(void) {
+  static const uint32_t periods[SLACK_TEST_TASKS] = {10, 15, 20, 30, 40, 60};
+
+  for (uint32_t i = 0; i < SLACK_TEST_TASKS; i++) {
+    task_struct *t = &tasks[i];
+    t->id = i + 1;
+    t->period = periods[i];
+    t->deadline = periods[i];
+    t->crit_level = (criticality_level)(i % MAX_CRITICALITY_LEVELS);
+    t->num_replicas = 0;
+
+    task_alloc_map *a = &allocs[i];
+    a->task_id = t->id;
+    a->task_type = i == 3 ? Replica : Primary;
+    a->proc_id = 0;
+    a->core_id = i < 4 ? 0 : 1 % NUM_CORES_PER_PROC;
+    for (uint8_t l = 0; l < MAX_CRITICALITY_LEVELS; l++) {
+      t->wcet[l] = 1 + i % 3 + l;
+      a->tuned_deadlines[l] =
+          l < t->crit_level ? t->deadline * 2 / 3 : t->deadline;
+    }
+  }
+}
+
+static job_struct *make_job(uint32_t task, uint32_t arrival, float executed,
+                            uint8_t core_id) {
+  job_struct *job = create_job(&tasks[task], core_id);
+  if (job == NULL) {
+    return NULL;
+  }
+  job->arrival_time = arrival;
+  job->executed_time = executed;
+  job->is_replica = allocs[task].task_type == Replica;
+  job->wcet = (float)tasks[task].wcet[0];
+  job->actual_deadline = arrival + tasks[task].deadline;
+  for (uint8_t l = 0; l < MAX_CRITICALITY_LEVELS; l++) {
+    job->relative_tuned_deadlines[l] = allocs[task].tuned_deadlines[l];
+  }
+  job->virtual_deadline = arrival + job->relative_tuned_deadlines[0];
+  job->state = JOB_STATE_READY;
+  return job;
+}
+
+// Compares the engine with the full recomputation at every criticality and
+// DVFS level, with and without `extra`. Returns the number of disagreements.
+static uint32_t count_mismatches(test_ctx *ctx, uint8_t core_id,
+                                 const job_struct *extra) {
+  uint32_t now = proc_state.system_time;
+  uint32_t mismatches = 0;
+
+  for (uint8_t c = 0; c < MAX_CRITICALITY_LEVELS; c++) {
+    for (uint8_t k = 0; k < NUM_DVFS_LEVELS; k++) {
+      for (int with_extra = 0; with_extra < 2; with_extra++) {
+        const job_struct *x = with_extra ? extra : NULL;
+        float scale = dvfs_levels[k].scaling_factor;
+        float engine;
+        EXPECT(ctx, slack_engine_query(core_id, (criticality_level)c, now,
+                                       scale, x, &engine));
+        float full = find_slack_full_locked(core_id, (criticality_level)c,
+                                            now, scale, x);
+        mismatches += fabsf(engine - full) > 1e-3f;
+      }
+    }
+  }
+  return mismatches;
+}
+
+static void test_slack_engine_matches_recomputation(test_ctx *ctx) {
+  build_allocation();
+  ASSERT_EQ(ctx, test_sched_load(tasks, SLACK_TEST_TASKS, allocs,
+                                 SLACK_TEST_TASKS, 20),
+            0);
+  uint8_t other = 1 % NUM_CORES_PER_PROC;
+  core_state *cs = &core_states[0];
+
+  job_struct *running = make_job(0, 20, 1.0f, 0);
+  job_struct *late = make_job(1, 0, 0.0f, 0);
+  job_struct *ready = make_job(2, 20, 0.5f, 0);
+  job_struct *replica = make_job(3, 0, 2.0f, 0);
+  job_struct *pending = make_job(1, 30, 0.0f, 0);
+  job_struct *extra = make_job(2, 20, 0.0f, 0);
+  ASSERT_NOT_NULL(ctx, running);
+  ASSERT_NOT_NULL(ctx, late);
+  ASSERT_NOT_NULL(ctx, ready);
+  ASSERT_NOT_NULL(ctx, replica);
+  ASSERT_NOT_NULL(ctx, pending);
+  ASSERT_NOT_NULL(ctx, extra);
+
+  cs->running_job = running;
+  job_queue_push(&cs->ready_queue, late);
+  job_queue_push(&cs->ready_queue, ready);
+  job_queue_push(&cs->replica_queue, replica);
+  list_add_tail(&pending->link, &cs->pending_jobs_queue);
+  slack_engine_invalidate(0);
+  EXPECT_EQ(ctx, count_mismatches(ctx, 0, extra), 0u);
+
+  // Arrival.
+  job_struct *arrived = make_job(0, 20, 0.0f, 0);
+  ASSERT_NOT_NULL(ctx, arrived);
+  job_queue_push(&cs->ready_queue, arrived);
+  slack_engine_invalidate(0);
+  EXPECT_EQ(ctx, count_mismatches(ctx, 0, extra), 0u);
+
+  // Completion.
+  job_queue_remove(&cs->ready_queue, ready);
+  put_job_ref(ready, 0);
+  slack_engine_invalidate(0);
+  EXPECT_EQ(ctx, count_mismatches(ctx, 0, extra), 0u);
+
+  // A new tick rebuilds the engine without an invalidation.
+  atomic_store(&proc_state.system_time, 21);
+  running->executed_time += 1.0f;
+  EXPECT_EQ(ctx, count_mismatches(ctx, 0, extra), 0u);
+
+  // Mode change: jobs below the new level leave the queues.
+  criticality_level level = (criticality_level)(MAX_CRITICALITY_LEVELS - 1);
+  cs->local_criticality_level = level;
+  job_struct *queued[JOB_QUEUE_CAPACITY];
+  uint32_t n = job_queue_sorted(&cs->ready_queue, queued);
+  for (uint32_t i = 0; i < n; i++) {
+    if (queued[i]->parent_task->crit_level < level) {
+      job_queue_remove(&cs->ready_queue, queued[i]);
+      put_job_ref(queued[i], 0);
+    }
+  }
+  slack_engine_invalidate(0);
+  EXPECT_EQ(ctx, count_mismatches(ctx, 0, extra), 0u);
+
+  // Migration of the replica to the other core.
+  job_queue_remove(&cs->replica_queue, replica);
+  job_queue_push(&core_states[other].replica_queue, replica);
+  slack_engine_invalidate(0);
+  slack_engine_invalidate(other);
+  EXPECT_EQ(ctx, count_mismatches(ctx, 0, extra), 0u);
+  EXPECT_EQ(ctx, count_mismatches(ctx, other, extra), 0u);
+
+  test_sched_unload();
+}
+
+// A candidate due past the horizon still has to count the local releases
+// due before it.
+static void test_slack_engine_extra_past_horizon(test_ctx *ctx) {
+  static const uint32_t periods[2] = {10, 100};
+
+  for (uint32_t i = 0; i < 2; i++) {
+    tasks[i] = (task_struct){
+        .id = i + 1, .period = periods[i], .deadline = periods[i]};
+    allocs[i] = (task_alloc_map){
+        .task_id = i + 1,
+        .task_type = Primary,
+        .proc_id = 0,
+        .core_id = i == 0 ? 0 : 1 % NUM_CORES_PER_PROC,
+    };
+    for (uint8_t l = 0; l < MAX_CRITICALITY_LEVELS; l++) {
+      tasks[i].wcet[l] = 2 + l;
+      allocs[i].tuned_deadlines[l] = periods[i];
+    }
+  }
+  ASSERT_EQ(ctx, test_sched_load(tasks, 2, allocs, 2, 20), 0);
+
+  // Nothing is queued, so only the releases at 30..110 precede the extra
+  // job's deadline at 120, well past the horizon of 10.
+  job_struct *extra = make_job(1, 20, 0.0f, 0);
+  ASSERT_NOT_NULL(ctx, extra);
+
+  for (uint8_t c = 0; c < MAX_CRITICALITY_LEVELS; c++) {
+    for (uint8_t k = 0; k < NUM_DVFS_LEVELS; k++) {
+      float scale = dvfs_levels[k].scaling_factor;
+      criticality_level level = (criticality_level)c;
+      float slack = find_slack_locked(0, level, 20, scale, extra);
+      float full = find_slack_full_locked(0, level, 20, scale, extra);
+      EXPECT(ctx, fabsf(slack - full) <= 1e-3f);
+    }
+  }
+
+  put_job_ref(extra, 0);
+  test_sched_unload();
+}
+
+static test_case slack_cases[] = {
+    TEST_CASE(test_slack_engine_matches_recomputation),
+    TEST_CASE(test_slack_engine_extra_past_horizon),
+    {NULL, NULL},
+};
+
+test_suite slack_suite = {
+    .name = "slack_suite",
+    .cases = slack_cases,
+};
+
+REGISTER_SUITE(slack_suite);
@@ -202,6 +202,185 @@ static void test_remove_job_with_parent_task_id(test_ctx *ctx) {
     put_job_ref(p, 0);
 }
 
+static void test_job_queue_order_and_ties(test_ctx *ctx) {
+  static job_queue q;
+  static task_struct t = {.id = 5};
+  const uint32_t deadlines[] = {40, 10, 40, 30, 10, 50, 20, 40};
+  const size_t n = sizeof(deadlines) / sizeof(deadlines[0]);
+  job_struct *jobs[sizeof(deadlines) / sizeof(deadlines[0])];
+
+  job_queue_init(&q);
+  for (size_t i = 0; i < n; i++) {
+    jobs[i] = create_job(&t, 0);
+    ASSERT_NOT_NULL(ctx, jobs[i]);
+    jobs[i]->virtual_deadline = deadlines[i];
+    job_queue_push(&q, jobs[i]);
+  }
+  EXPECT_EQ(ctx, q.size, (uint32_t)n);
+
+  // Equal deadlines come out in insertion order, as with the sorted lists.
+  const size_t expected[] = {1, 4, 6, 3, 0, 2, 7, 5};
+  for (size_t i = 0; i < n; i++) {
+    job_struct *j = job_queue_pop(&q);
+    ASSERT_NOT_NULL(ctx, j);
+    EXPECT_EQ(ctx, j, jobs[expected[i]]);
+    EXPECT_NULL(ctx, j->queue);
+    put_job_ref(j, 0);
+  }
+
+  EXPECT(ctx, job_queue_empty(&q));
+  EXPECT_NULL(ctx, job_queue_peek(&q));
+  EXPECT_NULL(ctx, job_queue_pop(&q));
+}
+
+static void test_job_queue_remove_by_handle(test_ctx *ctx) {
+  static job_queue q;
+  static task_struct t = {.id = 6};
+  job_struct *jobs[32];
+
+  job_queue_init(&q);
+  for (uint32_t i = 0; i < 32; i++) {
+    jobs[i] = create_job(&t, 0);
+    ASSERT_NOT_NULL(ctx, jobs[i]);
+    jobs[i]->virtual_deadline = (i * 7) % 32;
+    job_queue_push(&q, jobs[i]);
+  }
+
+  for (uint32_t i = 0; i < 32; i += 3) {
+    job_queue_remove(&q, jobs[i]);
+    EXPECT_NULL(ctx, jobs[i]->queue);
+  }
+
+  job_struct *j;
+  uint32_t count = 0;
+  job_queue_for_each(j, &q) {
+    EXPECT_EQ(ctx, j->queue, &q);
+    EXPECT_EQ(ctx, q.slots[j->queue_pos], j);
+    count++;
+  }
+  EXPECT_EQ(ctx, count, 32u - 11u);
+
+  uint32_t last = 0;
+  while ((j = job_queue_pop(&q)) != NULL) {
+    EXPECT(ctx, j->virtual_deadline >= last);
+    last = j->virtual_deadline;
+  }
+
+  for (uint32_t i = 0; i < 32; i++)
+    put_job_ref(jobs[i], 0);
+}
+
+static void test_job_queue_sorted_copy(test_ctx *ctx) {
+  static job_queue q;
+  static task_struct t = {.id = 8};
+  static job_struct *sorted[JOB_QUEUE_CAPACITY];
+  job_struct *jobs[24];
+
+  job_queue_init(&q);
+  for (uint32_t i = 0; i < 24; i++) {
+    jobs[i] = create_job(&t, 0);
+    ASSERT_NOT_NULL(ctx, jobs[i]);
+    jobs[i]->virtual_deadline = (i * 5) % 12;
+    job_queue_push(&q, jobs[i]);
+  }
+
+  // Key order with ties in insertion order, leaving the queue as it was.
+  ASSERT_EQ(ctx, job_queue_sorted(&q, sorted), 24u);
+  for (uint32_t i = 1; i < 24; i++) {
+    EXPECT(ctx, sorted[i - 1]->virtual_deadline <= sorted[i]->virtual_deadline);
+    if (sorted[i - 1]->virtual_deadline == sorted[i]->virtual_deadline) {
+      EXPECT(ctx, sorted[i - 1]->queue_seq < sorted[i]->queue_seq);
+    }
+  }
+  EXPECT_EQ(ctx, q.size, 24u);
+  for (uint32_t i = 0; i < 24; i++) {
+    EXPECT_EQ(ctx, job_queue_pop(&q), sorted[i]);
+  }
+
+  for (uint32_t i = 0; i < 24; i++)
+    put_job_ref(jobs[i], 0);
+}
+
+static uint64_t key_by_task_id(const job_struct *job) {
+  return job->parent_task->id;
+}
+
+static void test_job_queue_custom_key(test_ctx *ctx) {
+  static job_queue q;
+  static task_struct tasks[4] = {{.id = 30}, {.id = 10}, {.id = 20},
+                                 {.id = 10}};
+  job_struct *jobs[4];
+
+  job_queue_init(&q);
+  job_queue_set_key(&q, key_by_task_id);
+  for (uint32_t i = 0; i < 4; i++) {
+    jobs[i] = create_job(&tasks[i], 0);
+    ASSERT_NOT_NULL(ctx, jobs[i]);
+    jobs[i]->virtual_deadline = 100 - i;
+    job_queue_push(&q, jobs[i]);
+    EXPECT_EQ(ctx, jobs[i]->queue_key, (uint64_t)tasks[i].id);
+  }
+
+  // The key, not the virtual deadline, orders the queue.
+  const uint32_t expected[] = {1, 3, 2, 0};
+  for (uint32_t i = 0; i < 4; i++) {
+    job_struct *j = job_queue_pop(&q);
+    ASSERT_NOT_NULL(ctx, j);
+    EXPECT_EQ(ctx, j, jobs[expected[i]]);
+    put_job_ref(j, 0);
+  }
+}
+
+static void test_job_index_tracks_queue(test_ctx *ctx) {
+  static job_queue q;
+  static job_index idx;
+  static task_struct tasks[5] = {{.id = 1}, {.id = 2}, {.id = 3}, {.id = 4},
+                                 {.id = 5}};
+  job_struct *jobs[40];
+  job_struct *found[4];
+
+  job_queue_init(&q);
+  job_index_init(&idx);
+  job_queue_attach_index(&q, &idx);
+
+  // Jobs 4 and 39 share task 5 and arrival 0.
+  for (uint32_t i = 0; i < 40; i++) {
+    jobs[i] = create_job(&tasks[i % 5], 0);
+    ASSERT_NOT_NULL(ctx, jobs[i]);
+    jobs[i]->arrival_time = i == 39 ? 0 : (i / 5) * 10;
+    jobs[i]->virtual_deadline = jobs[i]->arrival_time + 10;
+    job_queue_push(&q, jobs[i]);
+  }
+  EXPECT_EQ(ctx, idx.size, 40u);
+  EXPECT_EQ(ctx, job_index_find(&idx, 5, 0, found, 4), 2u);
+  EXPECT_EQ(ctx, job_index_find(&idx, 3, 20, found, 4), 1u);
+  EXPECT_EQ(ctx, found[0], jobs[12]);
+  EXPECT_EQ(ctx, job_index_find(&idx, 3, 25, found, 4), 0u);
+
+  for (uint32_t i = 0; i < 40; i += 2) {
+    job_queue_remove(&q, jobs[i]);
+  }
+  EXPECT_EQ(ctx, idx.size, 20u);
+  for (uint32_t i = 0; i < 39; i++) {
+    uint32_t n = job_index_find(&idx, tasks[i % 5].id, jobs[i]->arrival_time,
+                                found, 4);
+    if (i % 2 == 0) {
+      EXPECT_EQ(ctx, n, (i == 4 ? 1u : 0u));
+    } else {
+      ASSERT_EQ(ctx, n, 1u);
+      EXPECT_EQ(ctx, found[0], jobs[i]);
+    }
+  }
+
+  while (job_queue_pop(&q) != NULL)
+    ;
+  EXPECT_EQ(ctx, idx.size, 0u);
+  EXPECT_EQ(ctx, job_index_find(&idx, 5, 0, found, 4), 0u);
+
+  for (uint32_t i = 0; i < 40; i++)
+    put_job_ref(jobs[i], 0);
+}
+
 static void *ref_thread_inc(void *arg) {
   job_struct *j = arg;
   for (int i = 0; i < 1000; i++)
@@ -266,6 +445,11 @@ static test_case tm_cases[] = {
     TEST_CASE(test_pool_exhaustion_and_restore),
     TEST_CASE(test_queue_operations_sorted_and_pop),
     TEST_CASE(test_remove_job_with_parent_task_id),
+    TEST_CASE(test_job_queue_order_and_ties),
+    TEST_CASE(test_job_queue_remove_by_handle),
+    TEST_CASE(test_job_queue_sorted_copy),
+    TEST_CASE(test_job_queue_custom_key),
+    TEST_CASE(test_job_index_tracks_queue),
     TEST_CASE(test_refcount_concurrent),
     TEST_CASE(test_release_to_remote_pool),
     {NULL, NULL},
@@ -0,0 +1,121 @@
+# pyright: basic
+# Starts every processor as its own eeft_sched process on localhost, each on
+# its own port, the way they would run on separate hosts.
+# Usage: python3 tools/launch_local.py --num-processors 2 -- -m event -l info
+
+import argparse
+import signal
+import subprocess
+import sys
+import time
+
+DEFAULT_BINARY = "target/release/bin/eeft_sched"
+
+
+def peer_list(num_processors, host, base_port):
+    return ",".join(f"{host}:{base_port + i}" for i in range(num_processors))
+
+
+def stop_all(procs, timeout):
+    for p in procs:
+        if p.poll() is None:
+            p.send_signal(signal.SIGUSR1)
+
+    deadline = time.monotonic() + timeout
+    for p in procs:
+        try:
+            p.wait(timeout=max(0.0, deadline - time.monotonic()))
+        except subprocess.TimeoutExpired:
+            p.kill()
+            p.wait()
+
+
+def launch(binary, num_processors, host, base_port, extra_args, timeout):
+    peers = peer_list(num_processors, host, base_port)
+    procs = []
+
+    for proc_id in range(num_processors):
+        cmd = [binary, "-p", str(proc_id), "-P", peers, *extra_args]
+        print(f"[launch] P{proc_id}: {' '.join(cmd)}")
+        procs.append(subprocess.Popen(cmd))
+
+    exit_code = 0
+    try:
+        while procs and any(p.poll() is None for p in procs):
+            failed = [p for p in procs if p.poll() not in (None, 0)]
+            if failed:
+                print("[launch] a processor failed, stopping the others")
+                exit_code = 1
+                stop_all(procs, timeout)
+                break
+            time.sleep(0.1)
+    except KeyboardInterrupt:
+        print("[launch] interrupted, stopping processors")
+        stop_all(procs, timeout)
+        return 1
+
+    for proc_id, p in enumerate(procs):
+        if p.returncode != 0:
+            print(f"[launch] P{proc_id} exited with {p.returncode}")
+            exit_code = 1
+
+    return exit_code
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Run one eeft_sched process per processor on localhost"
+    )
+    parser.add_argument(
+        "--binary",
+        type=str,
+        default=DEFAULT_BINARY,
+        help="Simulator binary to start",
+    )
+    parser.add_argument(
+        "--num-processors",
+        type=int,
+        required=True,
+        help="Number of processors, must match NUM_PROC of the build",
+    )
+    parser.add_argument(
+        "--host",
+        type=str,
+        default="127.0.0.1",
+        help="Address every processor listens on",
+    )
+    parser.add_argument(
+        "--base-port",
+        type=int,
+        default=13000,
+        help="Port of processor 0; processor i uses base port + i",
+    )
+    parser.add_argument(
+        "--stop-timeout",
+        type=float,
+        default=5.0,
+        help="Seconds to wait for processors to stop before killing them",
+    )
+    parser.add_argument(
+        "args",
+        nargs=argparse.REMAINDER,
+        help="Simulator options passed to every processor, after --",
+    )
+
+    args = parser.parse_args()
+    extra_args = args.args[1:] if args.args[:1] == ["--"] else args.args
+
+    sys.exit(
+        launch(
+            binary=args.binary,
+            num_processors=args.num_processors,
+            host=args.host,
+            base_port=args.base_port,
+            extra_args=extra_args,
+            timeout=args.stop_timeout,
+        )
+    )
+
+
+if __name__ == "__main__":
+    main()
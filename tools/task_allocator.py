@@ -1,7 +1,10 @@
 # pyright: basic
+import argparse
 import copy
 import math
+import struct
 from enum import IntEnum
+from pathlib import Path
 
 import matplotlib.pyplot as plt
 import numpy as np
@@ -13,7 +16,11 @@ SYS_CONFIG_PATH = "config/system_config.yaml"
 TASK_CONFIG_PATH = "config/tasks.yaml"
 
 OUTPUT_H_SYS_CONFIG_PATH = "include/sys_config.h"
-OUTPUT_C_TASK_ALLOC_PATH = "src/task_alloc.c"
+OUTPUT_TASK_ALLOC_PATH = "config/task_alloc.bin"
+
+# Must match include/task_alloc.h.
+TASK_ALLOC_MAGIC = b"EEFTALOC"
+TASK_ALLOC_VERSION = 1
 
 REPORT_PATH = "target/reports"
 
@@ -425,13 +432,12 @@ class Allocator:
             self.allocate_tasks(taskset)
 
 
-# Formats a Python list into a C array string, padding with 0 if needed
-def format_array(arr, max_levels):
+# Pads a per-level list with 0 up to max_levels entries
+def pad_levels(arr, max_levels):
     if len(arr) > max_levels:
         raise ValueError("Task has more WCET entries than MAX_CRITICALITY_LEVELS")
 
-    padded_arr = arr + [0] * (max_levels - len(arr))
-    return f"{{ {', '.join(map(str, padded_arr))} }}"
+    return list(arr) + [0] * (max_levels - len(arr))
 
 
 # --- File Generation Functions ---
@@ -464,71 +470,69 @@ def generate_sys_config_h(sys_config):
         "#endif",
     ]
 
-    with open(OUTPUT_H_SYS_CONFIG_PATH, "w") as f:
-        f.write("\n".join(lines))
+    content = "\n".join(lines)
+    # Left alone when unchanged so that a new taskset does not force a rebuild.
+    path = Path(OUTPUT_H_SYS_CONFIG_PATH)
+    if path.exists() and path.read_text() == content:
+        print(f"{OUTPUT_H_SYS_CONFIG_PATH} is up to date")
+        return
+    path.write_text(content)
     print(f"Successfully generated {OUTPUT_H_SYS_CONFIG_PATH}")
 
 
-def generate_task_config_c(allocator: Allocator):
-    task_definitions = []
+def generate_task_alloc_bin(allocator: Allocator, output: str):
     max_crit_levels = allocator.sys_config["criticality_levels"]["max_levels"]
+    task_record = struct.Struct(f"<{5 + max_crit_levels}I")
+    alloc_record = struct.Struct(f"<{4 + max_crit_levels}I")
+
+    tasks = []
     for t in allocator.tasks:
-        wcet_str = format_array(t.wcet, max_crit_levels)
-        task_def = (
-            f"    {{\n"
-            f"        .id = {t.id},\n"
-            f"        .period = {t.period},\n"
-            f"        .deadline = {t.deadline},\n"
-            f"        .wcet = {wcet_str},\n"
-            f"        .crit_level = {t.criticality_str},\n"
-            f"        .num_replicas = {t.replicas}\n"
-            f"    }}"
+        tasks.append(
+            task_record.pack(
+                t.id,
+                t.period,
+                t.deadline,
+                *pad_levels(t.wcet, max_crit_levels),
+                t.criticality_level,
+                t.replicas,
+            )
         )
-        task_definitions.append(task_def)
 
-    map_entries = []
+    # Task types are the C enum values: Primary = 0, Replica = 1.
+    allocs = []
     for proc in allocator.processors:
         for core in proc.cores:
-            for task in core.assigned_primaries:
-                virtual_deadline_str = format_array(
-                    task.virtual_deadline, max_crit_levels
-                )
-                map_entries.append(
-                    f"    {{ .task_id = {task.id}, .task_type = Primary , .proc_id = {proc.id}, .core_id = {core.id}, .tuned_deadlines = {virtual_deadline_str}}}"
-                )
-            for task in core.assigned_replicas:
-                virtual_deadline_str = format_array(
-                    task.virtual_deadline, max_crit_levels
-                )
-                map_entries.append(
-                    f"    {{ .task_id = {task.id}, .task_type = Replica , .proc_id = {proc.id}, .core_id = {core.id}, .tuned_deadlines = {virtual_deadline_str}}}"
+            instances = [(task, 0) for task in core.assigned_primaries] + [
+                (task, 1) for task in core.assigned_replicas
+            ]
+            for task, task_type in instances:
+                allocs.append(
+                    alloc_record.pack(
+                        task.id,
+                        task_type,
+                        proc.id,
+                        core.id,
+                        *pad_levels(task.virtual_deadline, max_crit_levels),
+                    )
                 )
 
-    task_definitions_str = ",\n".join(task_definitions)
-    map_entries_str = ",\n".join(map_entries)
-    c_content = f"""#include "task_alloc.h"
-#include "sys_config.h"
-#include "task_management.h"
-#include <stdint.h>
-
-// This file is auto-generated by tools/config_generator.py
-// DO NOT EDIT BY HAND
-
-// Definitions for the system's static task set.
-const task_struct system_tasks[] = {{
-{task_definitions_str}
-}};
-const uint32_t SYSTEM_TASKS_SIZE = sizeof(system_tasks) / sizeof(task_struct);
-
-// Definitions for the offline-calculated task allocation map.
-const task_alloc_map allocation_map[] = {{
-{map_entries_str}
-}};
-const uint32_t ALLOCATION_MAP_SIZE = sizeof(allocation_map) / sizeof(task_alloc_map);
-"""
-    with open(OUTPUT_C_TASK_ALLOC_PATH, "w") as f:
-        f.write(c_content)
-    print(f"Successfully generated {OUTPUT_C_TASK_ALLOC_PATH}")
+    header = struct.pack(
+        "<8s6I",
+        TASK_ALLOC_MAGIC,
+        TASK_ALLOC_VERSION,
+        allocator.sys_config["system"]["num_processors"],
+        allocator.sys_config["system"]["num_cores_per_processor"],
+        max_crit_levels,
+        len(tasks),
+        len(allocs),
+    )
+
+    Path(output).parent.mkdir(parents=True, exist_ok=True)
+    with open(output, "wb") as f:
+        f.write(header)
+        f.writelines(tasks)
+        f.writelines(allocs)
+    print(f"Successfully generated {output}")
 
 
 # --- Report and Visualization Generation Functions ---
@@ -745,11 +749,39 @@ def generate_reports(allocator: Allocator):
 # --- Main Execution ---
 def main():
     global sys_config
+    parser = argparse.ArgumentParser(
+        description="Allocate a taskset to processors and cores offline"
+    )
+    parser.add_argument(
+        "--system-config",
+        type=str,
+        default=SYS_CONFIG_PATH,
+        help="System configuration YAML",
+    )
+    parser.add_argument(
+        "--tasks",
+        type=str,
+        default=TASK_CONFIG_PATH,
+        help="Taskset YAML",
+    )
+    parser.add_argument(
+        "--output",
+        type=str,
+        default=OUTPUT_TASK_ALLOC_PATH,
+        help="Allocation file loaded by the simulator with -c",
+    )
+    parser.add_argument(
+        "--no-reports",
+        action="store_true",
+        help="Skip the allocation report and charts",
+    )
+    args = parser.parse_args()
+
     print("--- Task Allocator ---")
 
-    with open(SYS_CONFIG_PATH, "r") as f:
+    with open(args.system_config, "r") as f:
         sys_config = yaml.safe_load(f)
-    with open(TASK_CONFIG_PATH, "r") as f:
+    with open(args.tasks, "r") as f:
         task_config = yaml.safe_load(f)
 
     tasks = task_config.get("tasks", [])
@@ -763,11 +795,11 @@ def main():
     allocator.run()
     print("Allocation complete")
 
-    generate_task_config_c(allocator)
-    print("C source/header files generation complete")
+    generate_task_alloc_bin(allocator, args.output)
 
-    generate_reports(allocator)
-    print("Report generation complete")
+    if not args.no_reports:
+        generate_reports(allocator)
+        print("Report generation complete")
 
 
 if __name__ == "__main__":